@@ -0,0 +1,64 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include "yae.hpp"
+
+// Counts the heap allocations made while generating a large mesh
+// on the CPU side, then the time it takes.
+
+static std::atomic<size_t> allocations(0);
+static std::atomic<size_t> allocated_bytes(0);
+
+void* operator new(size_t size)
+{
+    allocations++;
+    allocated_bytes += size;
+    if (void* p = std::malloc(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+template<class F>
+static void measure(const char* name, F f)
+{
+    size_t count = allocations;
+    size_t bytes = allocated_bytes;
+    yae::timer t;
+    size_t sink = f();
+    double elapsed = t.elapsed();
+    std::cout << name << ": " << allocations - count << " allocations, "
+        << (allocated_bytes - bytes) / (1024 * 1024) << " MB, "
+        << elapsed * 1000 << " ms (" << sink << ")" << std::endl;
+}
+
+int main()
+{
+    // the thread pool allocates once, not per mesh
+    yae::thread_pool::instance();
+    measure("make_box(100, 100, 100)", []() {
+        auto geomb = yae::make_box<float>(100, 100, 100);
+        return geomb.vertex_count();
+    });
+    measure("make_box(100, 100, 100) + vertices", []() {
+        auto geomb = yae::make_box<float>(100, 100, 100);
+        return geomb.vertices(geomb.default_format()).size();
+    });
+    measure("make_octahedron_sphere(7)", []() {
+        auto geomb = yae::make_octahedron_sphere<float>(7);
+        return geomb.vertex_count();
+    });
+    return 0;
+}
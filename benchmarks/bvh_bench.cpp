@@ -0,0 +1,74 @@
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "bvh.hpp"
+#include "yae.hpp"
+
+// Culling 100k boxes through a bvh compared with testing each of them,
+// 4 at a time as group::render does.
+
+static const size_t box_count = 100000;
+static const int rounds = 100;
+
+template<class F>
+static double measure(const char* name, F f)
+{
+    yae::timer t;
+    size_t sink = 0;
+    for (int r = 0; r < rounds; r++) {
+        sink += f();
+    }
+    double elapsed = t.elapsed() / rounds;
+    std::cout << name << ": " << elapsed * 1e3 << " ms (" << sink / rounds << ")" << std::endl;
+    return elapsed;
+}
+
+int main()
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::vector<yae::bounds> boxes;
+    for (size_t i = 0; i < box_count; i++) {
+        float x = position(rng);
+        float y = position(rng) / 10;
+        float z = position(rng);
+        float points[6] = { x - 1.0f, y - 1.0f, z - 1.0f, x + 1.0f, y + 1.0f, z + 1.0f };
+        boxes.push_back(yae::bounds_of(points, 2));
+    }
+    yae::bvh tree;
+    yae::timer t;
+    tree.build(boxes);
+    std::cout << "build: " << t.elapsed() * 1e3 << " ms, sah cost " << tree.sah_cost() << std::endl;
+    t.reset();
+    for (size_t i = 0; i < box_count; i += 10) {
+        yae::bounds b = boxes[i];
+        tree.update(i, b);
+    }
+    std::cout << "update of 10k unmoved items: " << t.elapsed() * 1e3 << " ms" << std::endl;
+
+    auto mvp = yae::multm(yae::frustum(-1.0f, 1.0f, -0.75f, 0.75f, 1.0f, 300.0f), yae::translation(0.0f, 0.0f, -50.0f));
+    auto planes = yae::extract_clip_planes(mvp);
+    double flat = measure("flat, visible", [&]() {
+        size_t visible = 0;
+        for (size_t i = 0; i < boxes.size(); i += 4) {
+            const yae::bounds* batch[4] = { &boxes[i], &boxes[i + 1], &boxes[i + 2], &boxes[i + 3] };
+            unsigned int mask = yae::intersects(planes, batch);
+            visible += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+        }
+        return visible;
+    });
+    double hierarchical = measure("bvh, visible", [&]() {
+        size_t visible = 0;
+        tree.cull(planes, [&](size_t) { visible++; });
+        return visible;
+    });
+    std::cout << "speedup: " << flat / hierarchical << "x" << std::endl;
+    measure("range of 20 units, found", [&]() {
+        std::vector<size_t> items;
+        float points[6] = { -10.0f, -10.0f, -10.0f, 10.0f, 10.0f, 10.0f };
+        tree.range(yae::bounds_of(points, 2), items);
+        return items.size();
+    });
+    return 0;
+}
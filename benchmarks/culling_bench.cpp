@@ -0,0 +1,57 @@
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "culling.hpp"
+#include "yae.hpp"
+
+// Frustum tests of boxes one at a time and 4 at a time (SSE when available).
+
+static const int rounds = 200;
+
+template<class F>
+static double measure(const char* name, size_t count, F f)
+{
+    yae::timer t;
+    size_t sink = 0;
+    for (int r = 0; r < rounds; r++) {
+        sink += f();
+    }
+    double elapsed = t.elapsed();
+    std::cout << name << ": " << elapsed * 1e9 / (rounds * count) << " ns/box (" << sink / rounds << " visible)" << std::endl;
+    return elapsed;
+}
+
+int main()
+{
+    auto mvp = yae::multm(yae::frustum(-1.0f, 1.0f, -0.75f, 0.75f, 1.0f, 200.0f), yae::translation(0.0f, 0.0f, -100.0f));
+    auto planes = yae::extract_clip_planes(mvp);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+    std::vector<yae::bounds> boxes;
+    for (int i = 0; i < 100000; i++) {
+        float x = position(rng);
+        float y = position(rng);
+        float z = position(rng);
+        float points[6] = { x - 1.0f, y - 1.0f, z - 1.0f, x + 1.0f, y + 1.0f, z + 1.0f };
+        boxes.push_back(yae::bounds_of(points, 2));
+    }
+    double single = measure("one at a time", boxes.size(), [&]() {
+        size_t visible = 0;
+        for (auto& b : boxes) {
+            visible += yae::intersects(planes, b) ? 1 : 0;
+        }
+        return visible;
+    });
+    double batch = measure("4 at a time", boxes.size(), [&]() {
+        size_t visible = 0;
+        for (size_t i = 0; i < boxes.size(); i += 4) {
+            const yae::bounds* batch[4] = { &boxes[i], &boxes[i + 1], &boxes[i + 2], &boxes[i + 3] };
+            unsigned int mask = yae::intersects(planes, batch);
+            visible += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+        }
+        return visible;
+    });
+    std::cout << "speedup: " << single / batch << "x" << std::endl;
+    return 0;
+}
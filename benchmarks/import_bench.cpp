@@ -0,0 +1,89 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "yae.hpp"
+#include "mesh_import.hpp"
+
+// Writes a grid of 1000 x 1000 vertices as OBJ, ascii PLY and binary PLY,
+// then measures the import throughput of each file.
+
+static const int n = 1000;
+
+static void write_obj(const char* path)
+{
+    std::ofstream f(path);
+    char line[128];
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", x / (float)n, y / (float)n, (x * y % 7) / 7.0f);
+            f << line;
+        }
+    }
+    for (int y = 0; y + 1 < n; y++) {
+        for (int x = 0; x + 1 < n; x++) {
+            int i = y * n + x + 1;
+            f << "f " << i << ' ' << i + 1 << ' ' << i + n + 1 << ' ' << i + n << '\n';
+        }
+    }
+}
+
+static void write_ply(const char* path, bool binary)
+{
+    std::ofstream f(path, std::ios::binary);
+    f << "ply\nformat " << (binary ? "binary_little_endian" : "ascii") << " 1.0\n"
+        << "element vertex " << n * n << "\nproperty float x\nproperty float y\nproperty float z\n"
+        << "element face " << (n - 1) * (n - 1) << "\nproperty list uchar int vertex_indices\nend_header\n";
+    char line[128];
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            float v[3] = { x / (float)n, y / (float)n, (x * y % 7) / 7.0f };
+            if (binary) {
+                f.write(reinterpret_cast<const char*>(v), sizeof(v));
+            } else {
+                snprintf(line, sizeof(line), "%.6f %.6f %.6f\n", v[0], v[1], v[2]);
+                f << line;
+            }
+        }
+    }
+    for (int y = 0; y + 1 < n; y++) {
+        for (int x = 0; x + 1 < n; x++) {
+            int i = y * n + x;
+            int quad[4] = { i, i + 1, i + n + 1, i + n };
+            if (binary) {
+                f.put(4);
+                f.write(reinterpret_cast<const char*>(quad), sizeof(quad));
+            } else {
+                f << "4 " << quad[0] << ' ' << quad[1] << ' ' << quad[2] << ' ' << quad[3] << '\n';
+            }
+        }
+    }
+}
+
+static void measure(const char* path)
+{
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    double megabytes = f.tellg() / (1024.0 * 1024.0);
+    yae::imported_mesh mesh;
+    yae::timer t;
+    bool imported = yae::import_mesh(path, mesh);
+    double elapsed = t.elapsed();
+    std::cout << path << ": " << megabytes << " MB, " << elapsed * 1000 << " ms, "
+        << megabytes / elapsed << " MB/s (" << (imported ? mesh.indices.size() / 3 : 0) << " triangles)" << std::endl;
+}
+
+int main()
+{
+    // the thread pool starts once, not during the first import
+    yae::thread_pool::instance();
+    const char* paths[] = { "import_bench.obj", "import_bench_ascii.ply", "import_bench_binary.ply" };
+    write_obj(paths[0]);
+    write_ply(paths[1], false);
+    write_ply(paths[2], true);
+    for (const char* path : paths) {
+        measure(path);
+        remove(path);
+    }
+    return 0;
+}
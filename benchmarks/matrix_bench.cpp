@@ -0,0 +1,82 @@
+#include <iostream>
+#include <vector>
+
+#include "yae.hpp"
+
+// Compares the scalar matrix kernels with the ones selected by matrix.hpp
+// for the current target (SSE when available).
+
+static const int iterations = 10000000;
+
+template<class F>
+static double measure(const char* name, F f)
+{
+    yae::timer t;
+    float sink = f();
+    double elapsed = t.elapsed();
+    std::cout << name << ": " << elapsed * 1e9 / iterations << " ns/op (" << sink << ")" << std::endl;
+    return elapsed;
+}
+
+int main()
+{
+    std::vector<yae::matrix44f> matrices;
+    for (int i = 0; i < 64; i++) {
+        matrices.push_back(yae::multm(
+            yae::rotation(i * 5.0f, 1.0f, 0.0f, 0.0f),
+            yae::translation(i * 0.1f, 1.0f, -2.0f)));
+    }
+
+    // independent products, so that the throughput is measured rather
+    // than the latency of a dependency chain
+    std::vector<yae::matrix44f> products(matrices.size());
+    double scalar = measure("multm scalar", [&]() {
+        for (int i = 0; i < iterations; i++) {
+            products[i & 63] = yae::multm_scalar(matrices[i & 63], matrices[(i >> 6) & 63]);
+        }
+        return products[0].m[0];
+    });
+    double simd = measure("multm", [&]() {
+        for (int i = 0; i < iterations; i++) {
+            products[i & 63] = yae::multm(matrices[i & 63], matrices[(i >> 6) & 63]);
+        }
+        return products[0].m[0];
+    });
+    std::cout << "multm speedup: " << scalar / simd << "x" << std::endl;
+
+    std::vector<yae::vector3f> vectors(matrices.size());
+    scalar = measure("matrix * vector scalar", [&]() {
+        yae::vector3f v(1.0f, 2.0f, 3.0f);
+        for (int i = 0; i < iterations; i++) {
+            vectors[i & 63] = yae::operator*<float>(matrices[(i >> 6) & 63], v);
+        }
+        return vectors[0].x();
+    });
+    simd = measure("matrix * vector", [&]() {
+        yae::vector3f v(1.0f, 2.0f, 3.0f);
+        for (int i = 0; i < iterations; i++) {
+            vectors[i & 63] = matrices[(i >> 6) & 63] * v;
+        }
+        return vectors[0].x();
+    });
+    std::cout << "matrix * vector speedup: " << scalar / simd << "x" << std::endl;
+
+    measure("look_at", [&]() {
+        float sum = 0.0f;
+        for (int i = 0; i < iterations; i++) {
+            sum += yae::look_at((float)(i & 63), 1.0f, 10.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f).m[12];
+        }
+        return sum;
+    });
+
+    measure("rendering_context push/pop", [&]() {
+        yae::rendering_context ctx;
+        for (int i = 0; i < iterations; i++) {
+            ctx.push(matrices[i & 63]);
+            ctx.pop();
+        }
+        return ctx.mvp().m[0];
+    });
+
+    return 0;
+}
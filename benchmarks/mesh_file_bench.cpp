@@ -0,0 +1,47 @@
+#include <cstdio>
+#include <iostream>
+
+#include "yae.hpp"
+#include "mesh_file.hpp"
+
+// Compares generating the buffers of a large mesh at startup with reading
+// them from a mapped mesh file, which is what remains before the upload.
+
+template<class F>
+static double measure(const char* name, F f)
+{
+    yae::timer t;
+    size_t sink = f();
+    double elapsed = t.elapsed();
+    std::cout << name << ": " << elapsed * 1000 << " ms (" << sink << ")" << std::endl;
+    return elapsed;
+}
+
+int main()
+{
+    const char* path = "mesh_file_bench.yaem";
+    yae::geometry_data data;
+    double generated = measure("make_box(100, 100, 100) + build_data", [&]() {
+        auto geomb = yae::make_box<float>(100, 100, 100);
+        data = geomb.build_data(geomb.default_format());
+        return data.vertices.size() + data.indices.size();
+    });
+    yae::save_mesh_file(path, data);
+    double mapped = measure("map + read_mesh_file", [&]() {
+        yae::mapped_file file;
+        yae::mesh_file_view view;
+        if (!file.open(path) || !yae::read_mesh_file(file.data(), file.size(), view)) {
+            return (size_t)0;
+        }
+        // touches every page, as glBufferData would
+        size_t sum = 0;
+        size_t size = view.header->vertices_size + view.header->indices_size;
+        for (size_t i = 0; i < size; i += 4096) {
+            sum += view.vertices[i];
+        }
+        return sum + size;
+    });
+    std::cout << "speedup: " << generated / mapped << "x" << std::endl;
+    remove(path);
+    return 0;
+}
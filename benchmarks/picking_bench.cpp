@@ -0,0 +1,112 @@
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "parallel.hpp"
+#include "picking.hpp"
+#include "yae.hpp"
+
+// Rays from a camera through random pixels of a terrain of 2M triangles,
+// against a brute force test of every triangle.
+
+static const GLuint grid_size = 1000;
+static const size_t ray_count = 1000000;
+static const size_t brute_force_ray_count = 20;
+
+static float height(float x, float z)
+{
+    return 10.0f * std::sin(x * 0.05f) * std::cos(z * 0.07f);
+}
+
+int main()
+{
+    std::vector<float> positions;
+    std::vector<GLuint> indices;
+    for (GLuint z = 0; z <= grid_size; z++) {
+        for (GLuint x = 0; x <= grid_size; x++) {
+            float fx = static_cast<float>(x) - grid_size / 2.0f;
+            float fz = static_cast<float>(z) - grid_size / 2.0f;
+            positions.insert(positions.end(), { fx, height(fx, fz), fz });
+        }
+    }
+    for (GLuint z = 0; z < grid_size; z++) {
+        for (GLuint x = 0; x < grid_size; x++) {
+            GLuint i = z * (grid_size + 1) + x;
+            indices.insert(indices.end(), { i, i + 1, i + grid_size + 2, i, i + grid_size + 2, i + grid_size + 1 });
+        }
+    }
+    yae::triangle_bvh triangles;
+    yae::timer t;
+    triangles.build(positions, indices);
+    std::cout << "build " << triangles.size() << " triangles: " << t.elapsed() * 1e3 << " ms" << std::endl;
+
+    yae::perspective_camera cam(yae::clipping_volume{ -0.4f, 0.4f, -0.3f, 0.3f, 1.0f, 2000.0f });
+    cam.move_up(200.0f);
+    cam.move_backward(400.0f);
+    cam.rotate_x(-30.0f);
+    yae::viewport vp{ 0, 0, 800, 600 };
+    std::vector<yae::ray> rays;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> px(0.0f, 800.0f);
+    std::uniform_real_distribution<float> py(0.0f, 600.0f);
+    for (size_t i = 0; i < ray_count; i++) {
+        rays.push_back(cam.ray_through(vp, px(rng), py(rng)));
+    }
+
+    size_t hits = 0;
+    t.reset();
+    for (const yae::ray& r : rays) {
+        size_t triangle;
+        float distance;
+        hits += triangles.intersect(r, std::numeric_limits<float>::max(), triangle, distance) ? 1 : 0;
+    }
+    double elapsed = t.elapsed();
+    std::cout << "bvh, 1 thread: " << ray_count / elapsed / 1e6 << " Mrays/s (" << hits << " hits)" << std::endl;
+
+    std::atomic<size_t> parallel_hits(0);
+    t.reset();
+    yae::parallel_for(0, ray_count, 4096, [&](size_t begin, size_t end) {
+        size_t h = 0;
+        for (size_t i = begin; i < end; i++) {
+            size_t triangle;
+            float distance;
+            h += triangles.intersect(rays[i], std::numeric_limits<float>::max(), triangle, distance) ? 1 : 0;
+        }
+        parallel_hits += h;
+    });
+    elapsed = t.elapsed();
+    std::cout << "bvh, " << yae::thread_pool::instance().size() + 1 << " threads: "
+        << ray_count / elapsed / 1e6 << " Mrays/s (" << parallel_hits << " hits)" << std::endl;
+
+    // every triangle, scalar
+    hits = 0;
+    t.reset();
+    for (size_t i = 0; i < brute_force_ray_count; i++) {
+        const yae::ray& r = rays[i];
+        float nearest = std::numeric_limits<float>::max();
+        for (size_t k = 0; k < indices.size(); k += 3) {
+            yae::vector3f v0(&positions[indices[k] * 3]);
+            yae::vector3f e1 = yae::vector3f(&positions[indices[k + 1] * 3]) - v0;
+            yae::vector3f e2 = yae::vector3f(&positions[indices[k + 2] * 3]) - v0;
+            yae::vector3f p = yae::cross_product(r.direction, e2);
+            float det = yae::dot_product(e1, p);
+            if (std::abs(det) < 1e-12f) {
+                continue;
+            }
+            yae::vector3f s = r.origin - v0;
+            float u = yae::dot_product(s, p) / det;
+            yae::vector3f q = yae::cross_product(s, e1);
+            float v = yae::dot_product(r.direction, q) / det;
+            float d = yae::dot_product(e2, q) / det;
+            if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && d >= 0.0f && d < nearest) {
+                nearest = d;
+            }
+        }
+        hits += nearest < std::numeric_limits<float>::max() ? 1 : 0;
+    }
+    elapsed = t.elapsed();
+    std::cout << "brute force: " << brute_force_ray_count / elapsed << " rays/s (" << hits << " hits)" << std::endl;
+    return 0;
+}
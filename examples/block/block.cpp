@@ -1,4 +1,5 @@
 #include <array>
+#include <iostream>
 
 #include "yae.hpp"
 #include "shader.hpp"
@@ -7,11 +8,11 @@
 int main()
 {
     auto engine = std::make_unique<yae::sdl_engine>();
-    auto window = engine->create_simple_window();
+    auto window = engine->create_simple_window(true);
     auto cv = yae::clipping_volume{ -2.0f, 2.0f, -2.0f, 2.0f, 2.0f, 100.0f };
     window->close_when_keydown();
 
-    auto box = yae::make_box<float>(10, 20, 5).build();
+    auto box = yae::make_box<float>(10, 20, 5).set_quantized(true).set_strips(true).build();
     auto node = std::make_shared<yae::geometry_node<float>>(std::move(box));
     auto root = std::make_shared<yae::group>();
     root->set_transform_callback([](yae::rendering_context& ctx) {
@@ -22,6 +23,21 @@ int main()
             yae::rotation(50.0f*f, 0.0f, 0.0f, 1.0f));
     });
     root->add(node);
+    // a ring of smaller blocks around, alternating a wireframe and a red
+    // program, sorted by the cameras to switch programs only once
+    auto small_box = yae::make_box<float>(2, 2, 2).set_quantized(true).set_strips(true).build();
+    auto small_node = std::make_shared<yae::geometry_node<float>>(std::move(small_box));
+    auto red = yae::monochrome_program::create_3d();
+    red->set_color(yae::color4f(1.0f, 0.0f, 0.0f));
+    for (int i = 0; i < 12; i++) {
+        auto satellite = std::make_shared<yae::group>();
+        satellite->set_transform(yae::multm(yae::rotation(30.0f * i, 0.0f, 0.0f, 1.0f), yae::translation(12.0f, 0.0f, 0.0f)));
+        if (i % 2 == 1) {
+            satellite->set_program(red);
+        }
+        satellite->add(small_node);
+        root->add(satellite);
+    }
 
     std::array<yae::color4f, 4> bg_colors = {
         yae::color4f{ 1.0f, 0.0f, 0.0f, 0.0f },
@@ -61,9 +77,23 @@ int main()
         scene->add_element(cre);
         scene->add_element(nre);
         cam->move_backward(20.0f);
+        cam->set_sorting(true);
         window->add_scene(scene);
     }
 
+    window->set_render_callback([](yae::rendering_context& ctx) {
+        if (ctx.frame_count % 100 == 0) {
+            const yae::sorting_statistics& s = ctx.last_sorting;
+            std::cout << s.draws << " draws, program changes: " << s.unsorted_program_changes << " in traversal order, "
+                << s.program_changes << " sorted" << std::endl;
+            // over the last 100 frames
+            yae::gl_state& state = yae::gl_state::current();
+            std::cout << "GL state changes: " << state.get_statistics().issued << " issued, "
+                << state.get_statistics().elided << " elided" << std::endl;
+            state.reset_statistics();
+        }
+    });
+
     engine->run(window.get());
 
     return 0;
@@ -0,0 +1,57 @@
+#include <iostream>
+#include <vector>
+
+#include "yae.hpp"
+#include "shader.hpp"
+#include "sdl.hpp"
+#include "instancing.hpp"
+
+// 50k boxes in a single draw call
+int main()
+{
+    auto engine = std::make_unique<yae::sdl_engine>();
+    auto window = engine->create_simple_window(true);
+    auto cv = yae::clipping_volume{ -2.0f, 2.0f, -2.0f, 2.0f, 2.0f, 500.0f };
+    window->close_when_keydown();
+
+    auto box = yae::make_box<float>(1, 1, 1).build();
+    auto boxes = std::make_shared<yae::instanced_node>(std::move(box));
+    std::vector<yae::matrix44f> transforms;
+    std::vector<yae::color4f> colors;
+    const int side = 224;
+    for (int i = 0; i < side * side; i++) {
+        float x = static_cast<float>(i % side - side / 2);
+        float z = static_cast<float>(i / side - side / 2);
+        transforms.push_back(yae::multm(yae::translation(x * 2.0f, 0.0f, z * 2.0f), yae::scaling(0.5f, 0.5f, 0.5f)));
+        colors.push_back(yae::color4f(static_cast<float>(i % side) / side, 0.5f, static_cast<float>(i / side) / side));
+    }
+    boxes->set_transforms(transforms);
+    boxes->set_colors(colors);
+    std::cout << boxes->size() << " boxes" << std::endl;
+
+    auto root = std::make_shared<yae::group>();
+    root->set_transform_callback([](yae::rendering_context& ctx) {
+        return yae::rotation(10.0f * (float)ctx.elapsed_time_seconds, 0.0f, 1.0f, 0.0f);
+    });
+    root->add(boxes);
+
+    // tinted by the color of each instance
+    auto prog = yae::monochrome_program::create_3d_instanced();
+    prog->set_color(yae::color4f(1.0f, 1.0f, 1.0f));
+    auto cam = std::make_shared<yae::perspective_camera>(cv);
+    auto scene = std::make_shared<yae::rendering_scene>();
+    scene->associate_camera<yae::rendering_scene::fit_all_adapter>(cam, window.get(), yae::viewport_relative{ 0.0f, 0.0f, 1.0f, 1.0f });
+    auto clear_viewport_cb = yae::clear_viewport_callback(yae::color4f{ 0.0f, 0.0f, 0.0f, 0.0f }, scene->get_viewport());
+    auto cre = std::make_shared<yae::custom_rendering_element>("clear_viewport", clear_viewport_cb);
+    auto nre = std::make_shared<yae::node_rendering_element>("instanced_boxes", root, prog, cam);
+    scene->add_element(cre);
+    scene->add_element(nre);
+    cam->move_up(60.0f);
+    cam->move_backward(150.0f);
+    cam->rotate_x(-20.0f);
+    window->add_scene(scene);
+
+    engine->run(window.get());
+
+    return 0;
+}
@@ -8,21 +8,16 @@ class mandelbrot_program : public yae::shader_program {
 public:
     mandelbrot_program(const std::map<int, std::string>& attribute_indices);
     virtual void render(const yae::geometry<float>& geometry, yae::rendering_context& ctx);
+private:
+    GLint mvp_location;
 };
 
 void mandelbrot_program::render(const yae::geometry<float>& geometry, yae::rendering_context& ctx)
 {
-    glPolygonMode(polygon_face, polygon_mode);
-    glUseProgram(id);
-    GLuint matrix_uniform = glGetUniformLocation(id, "mvp");
-    glUniformMatrix4fv(matrix_uniform, 1, false, ctx.mvp().m);
-    glEnableVertexAttribArray(yae::vertex_attribute::POSITION);
-    glBindBuffer(GL_ARRAY_BUFFER, geometry.get_positions_id());
-    glVertexAttribPointer(yae::vertex_attribute::POSITION, geometry.get_dimensions(), GL_FLOAT, GL_FALSE, 0, 0);
-    glDrawArrays(GL_QUADS, 0, geometry.get_count());
-    glDisableVertexAttribArray(yae::vertex_attribute::POSITION);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glUseProgram(0);
+    yae::gl_state::current().polygon_mode(polygon_face, polygon_mode);
+    yae::gl_state::current().use_program(id);
+    glUniformMatrix4fv(mvp_location, 1, false, ctx.mvp().m);
+    yae::draw_geometry(geometry, attributes);
 }
 
 static const std::string mandelbrot_vert = R"SHADER(
@@ -40,26 +35,26 @@ void main(void)
 static const std::string mandelbrot_frag = R"SHADER(
 #version 330 core
 in vec2 coord;
-out vec4 gl_FragColor;
+out vec4 fColor;
 void main(void)
 {
     vec2 c = coord;
     vec2 z = vec2(0.0f, 0.0f);
     int i = 0;
     const int max_i = 200;
-    gl_FragColor = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    fColor = vec4(0.0f, 0.0f, 0.0f, 1.0f);
     for (; i < max_i; i++) {
         z = vec2(z.x*z.x - z.y*z.y, 2*z.x*z.y) + c;
         if (length(z) > 2.0f) {
             float base = log(float(i))/log(float(max_i));
-            gl_FragColor = vec4(base, 1.0f-base, 1.0f-base, 1.0f);
+            fColor = vec4(base, 1.0f-base, 1.0f-base, 1.0f);
         };
     }
 }
 )SHADER";
 
 mandelbrot_program::mandelbrot_program(const std::map<int, std::string>& attribute_indices)
-: shader_program(mandelbrot_vert, mandelbrot_frag, attribute_indices)
+: shader_program(mandelbrot_vert, mandelbrot_frag, attribute_indices), mvp_location(get_uniform_location("mvp"))
 {
 }
 
@@ -73,12 +68,12 @@ static std::shared_ptr<mandelbrot_program> create_mandelbrot_program()
 int main()
 {
     auto engine = std::make_unique<yae::sdl_engine>();
-    auto window = engine->create_simple_window();
+    auto window = engine->create_simple_window(true);
     auto cv = yae::clipping_volume{ -2.5f, 2.5f, -2.5f, 2.5f, -1.0f, 1.0f };
     window->close_when_keydown();
 
     yae::buffer_object_builder<float> v({ -5.0f, -5.0f, 5.0f, -5.0f, 5.0f, 5.0f, -5.0f, 5.0f });
-    auto canvas = std::make_shared<yae::geometry<float>>(v.get_size() / 2, 2, GL_QUADS);
+    auto canvas = std::make_shared<yae::geometry<float>>(v.get_count() / 2, 2, GL_TRIANGLE_FAN);
     canvas->set_vertex_positions(v.build());
     auto node = std::make_shared<yae::geometry_node<float>>(std::move(canvas));
     auto root = std::make_shared<yae::group>();
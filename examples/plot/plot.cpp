@@ -0,0 +1,53 @@
+#include <cmath>
+#include <iostream>
+
+#include "yae.hpp"
+#include "shader.hpp"
+#include "sdl.hpp"
+#include "dynamic_geometry.hpp"
+
+int main()
+{
+    auto engine = std::make_unique<yae::sdl_engine>();
+    auto window = engine->create_simple_window(true);
+    auto cv = yae::clipping_volume{ -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f };
+    window->close_when_keydown();
+
+    // a curve of 100000 points recomputed every frame
+    const size_t point_count = 100000;
+    auto format = yae::vertex_format().add(yae::vertex_attribute::POSITION, 2);
+    auto curve = std::make_shared<yae::dynamic_geometry<float>>(format, point_count, 2, GL_LINE_STRIP);
+    auto node = std::make_shared<yae::geometry_node<float>>(curve->get_geometry());
+    auto root = std::make_shared<yae::group>();
+    root->add(node);
+
+    auto prog = yae::monochrome_program::create_2d();
+    prog->set_color(yae::color4f(0.2f, 1.0f, 0.2f));
+    auto scene = std::make_shared<yae::rendering_scene>();
+    auto cam = std::make_shared<yae::parallel_camera>(cv);
+    scene->associate_camera<yae::rendering_scene::fit_all_adapter>(cam, window.get(), yae::viewport_relative{ 0.0f, 0.0f, 1.0f, 1.0f });
+    auto clear_viewport_cb = yae::clear_viewport_callback(yae::color4f{ 0.0f, 0.0f, 0.0f, 0.0f }, scene->get_viewport());
+    auto cre = std::make_shared<yae::custom_rendering_element>("clear_viewport", clear_viewport_cb);
+    auto nre = std::make_shared<yae::node_rendering_element>("curve", root, prog, cam);
+    scene->add_element(cre);
+    scene->add_element(nre);
+
+    window->set_render_callback([&](yae::rendering_context& ctx) {
+        float t = (float)ctx.elapsed_time_seconds;
+        float* points = static_cast<float*>(curve->begin_update());
+        for (size_t i = 0; i < point_count; i++) {
+            float x = 2.0f * i / (point_count - 1) - 1.0f;
+            points[i * 2] = x;
+            points[i * 2 + 1] = 0.5f * std::sin(20.0f * x + 3.0f * t) * std::cos(2.0f * x - t);
+        }
+        curve->end_update(point_count);
+    });
+
+    window->add_scene(scene);
+
+    engine->run(window.get());
+
+    std::cout << (curve->is_persistent() ? "persistent" : "unsynchronized") << " mapping, "
+        << curve->get_stalls() << " stalls" << std::endl;
+    return 0;
+}
@@ -1,13 +1,15 @@
 #include <array>
+#include <iostream>
 
 #include "yae.hpp"
 #include "shader.hpp"
 #include "sdl.hpp"
+#include "async_loader.hpp"
 
 int main()
 {
     auto engine = std::make_unique<yae::sdl_engine>();
-    auto window = engine->create_simple_window();
+    auto window = engine->create_simple_window(true);
     auto cv = yae::clipping_volume{ -2.0f, 2.0f, -2.0f, 2.0f, 2.0f, 100.0f };
     window->close_when_keydown();
 
@@ -19,9 +21,16 @@ int main()
             yae::rotation(50.0f*f, 0.0f, 0.0f, 1.0f));
     };
 
-    auto uvsphere = yae::make_uv_sphere<float>(50, 10).build();
-    auto octasphere = yae::make_octahedron_sphere<float>(3).build();
-    auto uvnode = std::make_shared<yae::geometry_node<float>>(std::move(uvsphere));
+    // uploads from a shared context when the platform allows it, within a budget per frame otherwise
+    engine->enable_upload_thread(window.get());
+    // generated in the background, drawn from the first frame it is uploaded
+    auto uvsphere = yae::async_loader::instance().load_builder([]() { return yae::make_uv_sphere<float>(50, 10); });
+    auto octabuilder = yae::make_octahedron_sphere<float>(3);
+    auto octasphere = octabuilder.set_optimized(true).build();
+    auto& stats = octabuilder.get_statistics();
+    std::cout << "octahedron sphere ACMR " << stats.before.acmr << " -> " << stats.after.acmr
+        << ", ATVR " << stats.before.atvr << " -> " << stats.after.atvr << std::endl;
+    auto uvnode = std::make_shared<yae::async_geometry_node>(uvsphere);
     auto octanode = std::make_shared<yae::geometry_node<float>>(std::move(octasphere));
     auto uvgroup = std::make_shared<yae::group>();
     uvgroup->set_transform_callback(transform_fun);
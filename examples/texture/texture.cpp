@@ -5,7 +5,7 @@
 int main()
 {
     auto engine = std::make_unique<yae::sdl_engine>();
-    auto window = engine->create_simple_window();
+    auto window = engine->create_simple_window(true);
     auto cv = yae::clipping_volume{ -8.0f, 8.0f, -6.0f, 6.0f, 1.0f, -1.0f };
     window->close_when_keydown();
 
@@ -17,7 +17,7 @@ int main()
     auto hero_texture = std::make_shared<yae::texture>(pixels, width, height);
 
     yae::buffer_object_builder<float> b({ -50.0f, -50.0f, 50.0f, -50.0f, 50.0f, 50.0f, -50.0f, 50.0f });
-    auto multi_hero = std::make_shared<yae::geometry<float>>(b.get_size() / 2, 2, GL_QUADS);
+    auto multi_hero = std::make_shared<yae::geometry<float>>(b.get_count() / 2, 2, GL_TRIANGLE_FAN);
     multi_hero->set_vertex_positions(b.build());
     multi_hero->set_vertex_tex_coords(b.build());
     auto node = std::make_shared<yae::geometry_node<float>>(multi_hero);
@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "async_loader.hpp"
+#include "mesh_file.hpp"
+#include "mesh_import.hpp"
+#include "shader.hpp"
+#include "upload_thread.hpp"
+
+using namespace yae;
+
+// 4 MB per frame, about a millisecond of transfer on most buses
+static const size_t default_upload_budget = 4 << 20;
+
+async_loader::async_loader(unsigned int thread_count)
+    : _pending(0), _preparing(0), _upload_budget(default_upload_budget), _upload_thread(nullptr), _workers(std::max(1u, thread_count))
+{
+}
+
+async_loader::~async_loader()
+{
+    shutdown();
+}
+
+void async_loader::shutdown()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    // the buffers of the loads half uploaded
+    for (auto& j : _prepared) {
+        if (j->vertices_id != 0) {
+            gl_state::current().delete_buffer(j->vertices_id);
+        }
+        if (j->indices_id != 0) {
+            gl_state::current().delete_buffer(j->indices_id);
+        }
+        j->handle->_failed = true;
+    }
+    _pending -= _prepared.size();
+    _prepared.clear();
+}
+
+std::shared_ptr<geometry_handle> async_loader::submit(std::function<bool(job&)> prepare)
+{
+    auto j = std::make_shared<job>();
+    j->handle = std::make_shared<geometry_handle>();
+    j->vertices = nullptr;
+    j->indices = nullptr;
+    j->vertices_size = 0;
+    j->indices_size = 0;
+    j->uploaded = 0;
+    j->vertices_id = 0;
+    j->indices_id = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending++;
+        _preparing++;
+    }
+    _workers.submit([this, j, prepare]() {
+        bool prepared = prepare(*j);
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (prepared) {
+            _prepared.push_back(j);
+        } else {
+            j->handle->_failed = true;
+            _pending--;
+        }
+        _preparing--;
+        _prepared_cv.notify_all();
+    });
+    return j->handle;
+}
+
+std::shared_ptr<geometry_handle> async_loader::load(prepare_function prepare)
+{
+    return submit([prepare](job& j) {
+        if (!prepare(j.data)) {
+            return false;
+        }
+        j.vertices = j.data.vertices.data();
+        j.vertices_size = j.data.vertices.size();
+        j.indices = j.data.indices.data();
+        j.indices_size = j.data.indices.size();
+        return true;
+    });
+}
+
+std::shared_ptr<geometry_handle> async_loader::load_file(const std::string& path)
+{
+    std::string extension = path.substr(std::min(path.size(), path.rfind('.')));
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower(c); });
+    if (extension == ".obj" || extension == ".ply") {
+        return load([path](geometry_data& data) {
+            imported_mesh mesh;
+            if (!import_mesh(path, mesh)) {
+                return false;
+            }
+            auto geomb = make_builder(std::move(mesh));
+            data = geomb.build_data(geomb.default_format());
+            return true;
+        });
+    }
+    // the buffers are uploaded straight from the mapping, kept until then
+    return submit([path](job& j) {
+        auto file = std::make_shared<mapped_file>();
+        mesh_file_view view;
+        if (!file->open(path)) {
+            printf("Cannot map %s\n", path.c_str());
+            return false;
+        }
+        if (!read_mesh_file(file->data(), file->size(), view)) {
+            return false;
+        }
+        const mesh_file_header& h = *view.header;
+        j.file = file;
+        j.data.format = view.format;
+        j.data.index_type = h.index_type;
+        j.data.primitive_type = h.primitive_type;
+        j.data.dimensions = h.dimensions;
+        j.data.count = h.count;
+        j.data.primitive_restart = h.primitive_restart != 0;
+        memcpy(j.data.position_transform.m, h.position_transform, sizeof(h.position_transform));
+        j.data.model_bounds = view.model_bounds;
+        j.vertices = view.vertices;
+        j.vertices_size = static_cast<size_t>(h.vertices_size);
+        j.indices = view.indices;
+        j.indices_size = static_cast<size_t>(h.indices_size);
+        return true;
+    });
+}
+
+void async_loader::set_upload_budget(size_t bytes)
+{
+    _upload_budget = bytes;
+}
+
+size_t async_loader::get_upload_budget() const
+{
+    return _upload_budget;
+}
+
+void async_loader::set_upload_thread(upload_thread* thread)
+{
+    _upload_thread = thread;
+}
+
+void async_loader::upload_slice(job& j, size_t size)
+{
+    gl_state& state = gl_state::current();
+    if (j.uploaded == 0) {
+        glGenBuffers(1, &j.vertices_id);
+        state.bind_buffer(GL_ARRAY_BUFFER, j.vertices_id);
+        glBufferData(GL_ARRAY_BUFFER, j.vertices_size, nullptr, GL_STATIC_DRAW);
+        if (j.indices_size > 0) {
+            glGenBuffers(1, &j.indices_id);
+            state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, j.indices_id);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, j.indices_size, nullptr, GL_STATIC_DRAW);
+        }
+    }
+    // the vertices, then the indices
+    while (size > 0) {
+        bool vertices = j.uploaded < j.vertices_size;
+        size_t offset = vertices ? j.uploaded : j.uploaded - j.vertices_size;
+        size_t n = std::min(size, (vertices ? j.vertices_size : j.indices_size) - offset);
+        GLenum target = vertices ? GL_ARRAY_BUFFER : GL_ELEMENT_ARRAY_BUFFER;
+        state.bind_buffer(target, vertices ? j.vertices_id : j.indices_id);
+        glBufferSubData(target, offset, n, (vertices ? j.vertices : j.indices) + offset);
+        j.uploaded += n;
+        size -= n;
+    }
+}
+
+void async_loader::finish(job& j)
+{
+    auto g = std::make_shared<geometry<float>>(j.data.count, j.data.dimensions, j.data.primitive_type);
+    g->set_vertex_buffer(j.vertices_id, j.data.format);
+    if (j.indices_id != 0) {
+        g->set_indices(j.indices_id, j.data.index_type);
+    }
+    g->set_primitive_restart(j.data.primitive_restart);
+    g->set_position_transform(j.data.position_transform);
+    g->set_bounds(j.data.model_bounds);
+    j.vertices_id = 0;
+    j.indices_id = 0;
+    j.handle->_geometry = g;
+    // the bounds of the nodes of the handle, empty until then
+    node::bounds_changed();
+}
+
+void async_loader::hand_over(std::shared_ptr<job> j)
+{
+    _upload_thread->submit([j]() {
+        j->vertices_id = upload_buffer(j->vertices, j->vertices_size);
+        if (j->indices_size > 0) {
+            j->indices_id = upload_buffer(j->indices, j->indices_size);
+        }
+        j->uploaded = j->vertices_size + j->indices_size;
+    }, [this, j]() {
+        finish(*j);
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending--;
+    });
+}
+
+size_t async_loader::upload()
+{
+    while (_upload_thread != nullptr) {
+        std::shared_ptr<job> j;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            // one half uploaded before the thread was set ends here
+            if (_prepared.empty() || _prepared.front()->uploaded > 0) {
+                break;
+            }
+            j = _prepared.front();
+            _prepared.pop_front();
+        }
+        hand_over(j);
+    }
+    size_t budget = _upload_budget > 0 ? _upload_budget : ~(size_t)0;
+    size_t uploaded = 0;
+    while (uploaded < budget) {
+        std::shared_ptr<job> j;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_prepared.empty()) {
+                break;
+            }
+            j = _prepared.front();
+        }
+        size_t total = j->vertices_size + j->indices_size;
+        size_t size = std::min(budget - uploaded, total - j->uploaded);
+        upload_slice(*j, size);
+        uploaded += size;
+        if (j->uploaded < total) {
+            break;
+        }
+        finish(*j);
+        std::lock_guard<std::mutex> lock(_mutex);
+        _prepared.pop_front();
+        _pending--;
+    }
+    return uploaded;
+}
+
+size_t async_loader::pending() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _pending;
+}
+
+void async_loader::wait_prepared()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _prepared_cv.wait(lock, [this]() { return _preparing == 0; });
+}
+
+async_loader& async_loader::instance()
+{
+    // leaves the other cores to parallel_for
+    static async_loader loader(std::max(1u, std::thread::hardware_concurrency() / 4));
+    return loader;
+}
+
+void async_geometry_node::render(rendering_context& ctx)
+{
+    if (auto g = _handle->get()) {
+        ctx.draw(*g);
+    }
+}
+
+bounds async_geometry_node::get_bounds() const
+{
+    if (auto g = _handle->get()) {
+        return g->get_bounds();
+    }
+    return bounds_of(nullptr, 0);
+}
@@ -0,0 +1,122 @@
+#ifndef _async_loader_hpp_
+#define _async_loader_hpp_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <GL/glew.h>
+
+#include "geometry.hpp"
+#include "parallel.hpp"
+#include "yae.hpp"
+
+namespace yae {
+
+class mapped_file;
+class upload_thread;
+
+// The geometry of an asynchronous load, available once uploaded.
+class geometry_handle {
+public:
+    geometry_handle() : _failed(false) {}
+    // nullptr until ready, to be called from the rendering thread
+    inline std::shared_ptr<geometry<float>> get() const { return _geometry; }
+    inline bool is_ready() const { return _geometry != nullptr; }
+    inline bool has_failed() const { return _failed; }
+private:
+    friend class async_loader;
+    std::shared_ptr<geometry<float>> _geometry;
+    std::atomic<bool> _failed;
+};
+
+// Generates or parses meshes on worker threads, then uploads their buffers
+// from the rendering thread a slice at a time, so that a frame never uploads
+// much more than the budget. engine::run calls upload() after each frame.
+// With an upload thread the whole buffers are uploaded there instead.
+class async_loader {
+public:
+    typedef std::function<bool(geometry_data&)> prepare_function;
+
+    explicit async_loader(unsigned int thread_count = 1);
+    ~async_loader();
+    // runs prepare on a worker thread, the load fails when it returns false
+    std::shared_ptr<geometry_handle> load(prepare_function prepare);
+    // a mesh file, or an OBJ or PLY file according to the extension
+    std::shared_ptr<geometry_handle> load_file(const std::string& path);
+    // e.g. load_builder([]() { return make_uv_sphere<float>(50, 10); })
+    template<class F>
+    std::shared_ptr<geometry_handle> load_builder(F make_builder)
+    {
+        return load([make_builder](geometry_data& data) {
+            auto geomb = make_builder();
+            data = geomb.build_data(geomb.default_format());
+            return true;
+        });
+    }
+    // bytes uploaded per call of upload(), 0 for no limit
+    void set_upload_budget(size_t bytes);
+    size_t get_upload_budget() const;
+    // not owned, nullptr to upload from the rendering thread again
+    void set_upload_thread(upload_thread* thread);
+    // Uploads the prepared buffers in order until the budget is spent,
+    // returns the number of bytes uploaded. Needs a current GL context.
+    // Hands them to the upload thread if any, and returns 0.
+    size_t upload();
+    // loads not ready yet, prepared or not
+    size_t pending() const;
+    // blocks until every load is prepared, e.g. behind a loading screen
+    void wait_prepared();
+    // Fails the loads prepared but not uploaded, freeing their buffers while
+    // the context is current. Called by engine::run before it returns, as
+    // the instance outlives the context.
+    void shutdown();
+    static async_loader& instance();
+private:
+    struct job {
+        geometry_data data;
+        std::shared_ptr<mapped_file> file; // the source of the buffers when mapped
+        const unsigned char* vertices;
+        const unsigned char* indices;
+        size_t vertices_size;
+        size_t indices_size;
+        size_t uploaded;
+        GLuint vertices_id;
+        GLuint indices_id;
+        std::shared_ptr<geometry_handle> handle;
+    };
+    std::shared_ptr<geometry_handle> submit(std::function<bool(job&)> prepare);
+    void upload_slice(job& j, size_t size);
+    void finish(job& j);
+    void hand_over(std::shared_ptr<job> j);
+    std::deque<std::shared_ptr<job>> _prepared;
+    size_t _pending;
+    size_t _preparing;
+    size_t _upload_budget;
+    upload_thread* _upload_thread;
+    mutable std::mutex _mutex;
+    std::condition_variable _prepared_cv;
+    // last, so that the workers are joined before the rest is destroyed
+    thread_pool _workers;
+    async_loader(const async_loader&);
+};
+
+// renders the geometry of a handle once it is ready, nothing until then
+class async_geometry_node : public node {
+public:
+    async_geometry_node(std::shared_ptr<geometry_handle> handle) : _handle(handle) {}
+    virtual void render(rendering_context& ctx);
+    // empty until ready, then those of the geometry
+    virtual bounds get_bounds() const;
+private:
+    std::shared_ptr<geometry_handle> _handle;
+};
+
+}
+
+#endif
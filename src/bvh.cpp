@@ -0,0 +1,648 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <queue>
+
+#include "bvh.hpp"
+#include "parallel.hpp"
+
+using namespace yae;
+
+namespace {
+
+const GLuint no_parent = ~0u;
+const int bin_count = 16;
+// the cost of visiting a node relative to that of testing an item
+const float traversal_cost = 1.0f;
+// leaves are not split further below this many items unless it pays off
+const size_t max_leaf_size = 8;
+// subtrees smaller than this are built by a single thread
+const size_t parallel_grain = 4096;
+
+inline void grow(float lo[3], float hi[3], const float plo[3], const float phi[3])
+{
+    for (int c = 0; c < 3; c++) {
+        lo[c] = std::min(lo[c], plo[c]);
+        hi[c] = std::max(hi[c], phi[c]);
+    }
+}
+
+inline void clear(float lo[3], float hi[3])
+{
+    for (int c = 0; c < 3; c++) {
+        lo[c] = std::numeric_limits<float>::max();
+        hi[c] = std::numeric_limits<float>::lowest();
+    }
+}
+
+// half the surface, 0 when empty
+inline float half_area(const float lo[3], const float hi[3])
+{
+    float d[3];
+    for (int c = 0; c < 3; c++) {
+        d[c] = std::max(0.0f, hi[c] - lo[c]);
+    }
+    return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+}
+
+// the distance at which the ray enters the box, or infinity when it misses it
+// before max_distance, inverse being 1 / direction
+inline float entry_distance(const float lo[3], const float hi[3], const float origin[3], const float inverse[3],
+    float max_distance)
+{
+    float near = 0.0f;
+    float far = max_distance;
+    for (int c = 0; c < 3; c++) {
+        float t0 = (lo[c] - origin[c]) * inverse[c];
+        float t1 = (hi[c] - origin[c]) * inverse[c];
+        // NaN, from a direction parallel to a face of the box, is ignored by min and max
+        near = std::max(near, std::min(t0, t1));
+        far = std::min(far, std::max(t0, t1));
+    }
+    return near <= far ? near : std::numeric_limits<float>::infinity();
+}
+
+inline float squared_distance(const float lo[3], const float hi[3], const float p[3])
+{
+    float d2 = 0.0f;
+    for (int c = 0; c < 3; c++) {
+        float d = std::max(0.0f, std::max(lo[c] - p[c], p[c] - hi[c]));
+        d2 += d * d;
+    }
+    return d2;
+}
+
+inline bool overlaps(const float lo[3], const float hi[3], const float qlo[3], const float qhi[3])
+{
+    return lo[0] <= qhi[0] && qlo[0] <= hi[0] && lo[1] <= qhi[1] && qlo[1] <= hi[1] && lo[2] <= qhi[2] && qlo[2] <= hi[2];
+}
+
+}
+
+bvh::bvh() : _allocated(new std::atomic<GLuint>(0))
+{
+}
+
+bool bvh::split(const range_task& t, range_task& left, range_task& right)
+{
+    node& n = _nodes[t.node];
+    size_t count = t.end - t.begin;
+    float clo[3];
+    float chi[3];
+    clear(n.b.lo, n.b.hi);
+    clear(clo, chi);
+    for (size_t i = t.begin; i < t.end; i++) {
+        const build_item& bi = _work[i];
+        grow(n.b.lo, n.b.hi, bi.b.lo, bi.b.hi);
+        grow(clo, chi, bi.centroid, bi.centroid);
+    }
+    n.items = static_cast<GLuint>(count);
+    n.first = static_cast<GLuint>(t.begin);
+    n.count = static_cast<GLuint>(count);
+    if (count <= 1) {
+        return false;
+    }
+    // the cheapest split between bins of centroids along any axis,
+    // the bins of the 3 axes filled in a single pass over the items
+    float scale[3];
+    for (int axis = 0; axis < 3; axis++) {
+        float extent = chi[axis] - clo[axis];
+        scale[axis] = extent > 0.0f ? bin_count / extent : 0.0f;
+    }
+    size_t counts[3][bin_count] = {};
+    float lo[3][bin_count][3];
+    float hi[3][bin_count][3];
+    for (int axis = 0; axis < 3; axis++) {
+        for (int b = 0; b < bin_count; b++) {
+            clear(lo[axis][b], hi[axis][b]);
+        }
+    }
+    for (size_t i = t.begin; i < t.end; i++) {
+        const build_item& bi = _work[i];
+        for (int axis = 0; axis < 3; axis++) {
+            int b = std::min(bin_count - 1, static_cast<int>((bi.centroid[axis] - clo[axis]) * scale[axis]));
+            counts[axis][b]++;
+            grow(lo[axis][b], hi[axis][b], bi.b.lo, bi.b.hi);
+        }
+    }
+    float best_cost = std::numeric_limits<float>::max();
+    int best_axis = -1;
+    int best_bin = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        if (scale[axis] == 0.0f) {
+            continue;
+        }
+        // the cost of the left side of each split, then the right side added
+        float left_cost[bin_count - 1];
+        float slo[3];
+        float shi[3];
+        clear(slo, shi);
+        size_t seen = 0;
+        for (int b = 0; b < bin_count - 1; b++) {
+            grow(slo, shi, lo[axis][b], hi[axis][b]);
+            seen += counts[axis][b];
+            left_cost[b] = half_area(slo, shi) * seen;
+        }
+        clear(slo, shi);
+        seen = 0;
+        for (int b = bin_count - 1; b > 0; b--) {
+            grow(slo, shi, lo[axis][b], hi[axis][b]);
+            seen += counts[axis][b];
+            float cost = left_cost[b - 1] + half_area(slo, shi) * seen;
+            if (cost < best_cost && seen < count && seen > 0) {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = b - 1;
+            }
+        }
+    }
+    float area = half_area(n.b.lo, n.b.hi);
+    size_t mid;
+    if (best_axis < 0) {
+        // the centroids are all the same, any split is as good
+        if (count <= max_leaf_size) {
+            return false;
+        }
+        mid = t.begin + count / 2;
+    } else {
+        if (count <= max_leaf_size && (area <= 0.0f || traversal_cost + best_cost / area >= count)) {
+            return false;
+        }
+        auto first_right = std::partition(_work.begin() + t.begin, _work.begin() + t.end, [&](const build_item& bi) {
+            float c = bi.centroid[best_axis];
+            return std::min(bin_count - 1, static_cast<int>((c - clo[best_axis]) * scale[best_axis])) <= best_bin;
+        });
+        mid = first_right - _work.begin();
+    }
+    GLuint children = _allocated->fetch_add(2);
+    n.first = children;
+    n.count = 0;
+    _nodes[children].parent = t.node;
+    _nodes[children + 1].parent = t.node;
+    left = range_task{ children, t.begin, mid };
+    right = range_task{ children + 1, mid, t.end };
+    return true;
+}
+
+void bvh::build_subtree(const range_task& t)
+{
+    std::vector<range_task> stack(1, t);
+    while (!stack.empty()) {
+        range_task top = stack.back();
+        stack.pop_back();
+        range_task left;
+        range_task right;
+        if (split(top, left, right)) {
+            stack.push_back(right);
+            stack.push_back(left);
+        }
+    }
+}
+
+void bvh::build(const std::vector<bounds>& boxes)
+{
+    size_t count = boxes.size();
+    _boxes.resize(count);
+    _items.resize(count);
+    _leaf_of.resize(count);
+    // the items are partitioned with their box and centroid, which are then
+    // read in order rather than through the item indices
+    _work.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        box& b = _boxes[i];
+        b.lo[0] = boxes[i].lo.x();
+        b.lo[1] = boxes[i].lo.y();
+        b.lo[2] = boxes[i].lo.z();
+        b.hi[0] = boxes[i].hi.x();
+        b.hi[1] = boxes[i].hi.y();
+        b.hi[2] = boxes[i].hi.z();
+        build_item& bi = _work[i];
+        bi.b = b;
+        for (int c = 0; c < 3; c++) {
+            bi.centroid[c] = (b.lo[c] + b.hi[c]) / 2;
+        }
+        bi.item = static_cast<GLuint>(i);
+    }
+    _nodes.clear();
+    if (count == 0) {
+        _work.clear();
+        return;
+    }
+    // a binary tree of count leaves at most
+    _nodes.resize(2 * count - 1);
+    _nodes[0].parent = no_parent;
+    _allocated->store(1);
+    // the top of the tree breadth first, until there are subtrees for every thread
+    size_t wanted = 4 * (thread_pool::instance().size() + 1);
+    std::deque<range_task> tasks(1, range_task{ 0, 0, count });
+    std::vector<range_task> subtrees;
+    while (!tasks.empty() && tasks.size() + subtrees.size() < wanted) {
+        range_task t = tasks.front();
+        tasks.pop_front();
+        range_task left;
+        range_task right;
+        if (t.end - t.begin < parallel_grain) {
+            subtrees.push_back(t);
+        } else if (split(t, left, right)) {
+            tasks.push_back(left);
+            tasks.push_back(right);
+        }
+    }
+    subtrees.insert(subtrees.end(), tasks.begin(), tasks.end());
+    parallel_for(0, subtrees.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            build_subtree(subtrees[i]);
+        }
+    });
+    _nodes.resize(_allocated->load());
+    for (size_t i = 0; i < count; i++) {
+        _items[i] = _work[i].item;
+    }
+    std::vector<build_item>().swap(_work);
+    for (size_t i = 0; i < _nodes.size(); i++) {
+        const node& n = _nodes[i];
+        for (GLuint k = 0; k < n.count; k++) {
+            _leaf_of[_items[n.first + k]] = static_cast<GLuint>(i);
+        }
+    }
+}
+
+bvh::box bvh::leaf_box(const node& n) const
+{
+    box b;
+    clear(b.lo, b.hi);
+    for (GLuint k = 0; k < n.count; k++) {
+        const box& item = _boxes[_items[n.first + k]];
+        grow(b.lo, b.hi, item.lo, item.hi);
+    }
+    return b;
+}
+
+void bvh::update(size_t item, const bounds& b)
+{
+    box& ib = _boxes[item];
+    ib.lo[0] = b.lo.x();
+    ib.lo[1] = b.lo.y();
+    ib.lo[2] = b.lo.z();
+    ib.hi[0] = b.hi.x();
+    ib.hi[1] = b.hi.y();
+    ib.hi[2] = b.hi.z();
+    GLuint i = _leaf_of[item];
+    box nb = leaf_box(_nodes[i]);
+    for (;;) {
+        node& n = _nodes[i];
+        if (memcmp(&n.b, &nb, sizeof(box)) == 0) {
+            // the ancestors do not change either
+            break;
+        }
+        n.b = nb;
+        if (n.parent == no_parent) {
+            break;
+        }
+        i = n.parent;
+        const node& parent = _nodes[i];
+        nb = _nodes[parent.first].b;
+        grow(nb.lo, nb.hi, _nodes[parent.first + 1].b.lo, _nodes[parent.first + 1].b.hi);
+    }
+}
+
+void bvh::refit()
+{
+    // the children of a node are allocated after it
+    for (size_t i = _nodes.size(); i-- > 0;) {
+        node& n = _nodes[i];
+        if (n.count > 0) {
+            n.b = leaf_box(n);
+        } else {
+            n.b = _nodes[n.first].b;
+            grow(n.b.lo, n.b.hi, _nodes[n.first + 1].b.lo, _nodes[n.first + 1].b.hi);
+        }
+    }
+}
+
+bounds bvh::get_bounds() const
+{
+    if (_nodes.empty()) {
+        return bounds_of(nullptr, 0);
+    }
+    const box& b = _nodes[0].b;
+    float corners[6] = { b.lo[0], b.lo[1], b.lo[2], b.hi[0], b.hi[1], b.hi[2] };
+    return bounds_of(corners, 2);
+}
+
+size_t bvh::cull(const clip_planes& planes, const std::function<void(size_t)>& visit) const
+{
+    if (_nodes.empty()) {
+        return 0;
+    }
+    // the planes still to test, a subtree inside a plane is inside for its descendants
+    const unsigned int all_planes = 0x3f;
+    auto outside = [&planes](const box& b, unsigned int& mask) {
+        for (int p = 0; p < 6; p++) {
+            if ((mask & (1u << p)) == 0) {
+                continue;
+            }
+            const float* pl = planes.planes[p];
+            float distance = pl[3];
+            float radius = 0.0f;
+            for (int c = 0; c < 3; c++) {
+                distance += pl[c] * (b.lo[c] + b.hi[c]) / 2;
+                radius += std::abs(pl[c]) * (b.hi[c] - b.lo[c]) / 2;
+            }
+            if (distance + radius < 0.0f) {
+                return true;
+            }
+            if (distance - radius >= 0.0f) {
+                mask &= ~(1u << p);
+            }
+        }
+        return false;
+    };
+    size_t culled = 0;
+    std::vector<std::pair<GLuint, unsigned int>> stack(1, std::make_pair(0u, all_planes));
+    while (!stack.empty()) {
+        GLuint i = stack.back().first;
+        unsigned int mask = stack.back().second;
+        stack.pop_back();
+        const node& n = _nodes[i];
+        if (mask != 0 && outside(n.b, mask)) {
+            culled += n.items;
+            continue;
+        }
+        if (n.count == 0) {
+            stack.push_back(std::make_pair(n.first + 1, mask));
+            stack.push_back(std::make_pair(n.first, mask));
+            continue;
+        }
+        for (GLuint k = 0; k < n.count; k++) {
+            GLuint item = _items[n.first + k];
+            unsigned int item_mask = mask;
+            if (n.count > 1 && item_mask != 0 && outside(_boxes[item], item_mask)) {
+                culled++;
+            } else {
+                visit(item);
+            }
+        }
+    }
+    return culled;
+}
+
+void bvh::range(const bounds& query, std::vector<size_t>& items) const
+{
+    if (_nodes.empty()) {
+        return;
+    }
+    float qlo[3] = { query.lo.x(), query.lo.y(), query.lo.z() };
+    float qhi[3] = { query.hi.x(), query.hi.y(), query.hi.z() };
+    std::vector<GLuint> stack(1, 0);
+    while (!stack.empty()) {
+        const node& n = _nodes[stack.back()];
+        stack.pop_back();
+        if (!overlaps(n.b.lo, n.b.hi, qlo, qhi)) {
+            continue;
+        }
+        if (n.count == 0) {
+            stack.push_back(n.first + 1);
+            stack.push_back(n.first);
+            continue;
+        }
+        for (GLuint k = 0; k < n.count; k++) {
+            GLuint item = _items[n.first + k];
+            if (overlaps(_boxes[item].lo, _boxes[item].hi, qlo, qhi)) {
+                items.push_back(item);
+            }
+        }
+    }
+}
+
+void bvh::raycast(const ray& r, float max_distance,
+    const std::function<float(size_t first, size_t count, float max_distance)>& leaf) const
+{
+    if (_nodes.empty()) {
+        return;
+    }
+    float origin[3] = { r.origin.x(), r.origin.y(), r.origin.z() };
+    float inverse[3] = { 1.0f / r.direction.x(), 1.0f / r.direction.y(), 1.0f / r.direction.z() };
+    typedef std::pair<float, GLuint> entry;
+    std::vector<entry> stack;
+    float d = entry_distance(_nodes[0].b.lo, _nodes[0].b.hi, origin, inverse, max_distance);
+    if (d <= max_distance) {
+        stack.push_back(entry(d, 0));
+    }
+    while (!stack.empty()) {
+        entry e = stack.back();
+        stack.pop_back();
+        if (e.first > max_distance) {
+            continue;
+        }
+        const node& n = _nodes[e.second];
+        if (n.count > 0) {
+            max_distance = std::min(max_distance, leaf(n.first, n.count, max_distance));
+            continue;
+        }
+        float d0 = entry_distance(_nodes[n.first].b.lo, _nodes[n.first].b.hi, origin, inverse, max_distance);
+        float d1 = entry_distance(_nodes[n.first + 1].b.lo, _nodes[n.first + 1].b.hi, origin, inverse, max_distance);
+        // the nearer child on top
+        entry children[2] = { entry(d0, n.first), entry(d1, n.first + 1) };
+        if (d0 < d1) {
+            std::swap(children[0], children[1]);
+        }
+        for (const entry& c : children) {
+            if (c.first <= max_distance) {
+                stack.push_back(c);
+            }
+        }
+    }
+}
+
+bool bvh::nearest(const vector3f& point, size_t& item, float& distance) const
+{
+    if (_nodes.empty()) {
+        return false;
+    }
+    float p[3] = { point.x(), point.y(), point.z() };
+    // the nodes by increasing distance, until the next is farther than the best item
+    typedef std::pair<float, GLuint> entry;
+    std::priority_queue<entry, std::vector<entry>, std::greater<entry>> queue;
+    queue.push(entry(squared_distance(_nodes[0].b.lo, _nodes[0].b.hi, p), 0));
+    distance = std::numeric_limits<float>::max();
+    while (!queue.empty() && queue.top().first < distance) {
+        const node& n = _nodes[queue.top().second];
+        queue.pop();
+        if (n.count == 0) {
+            for (GLuint c = n.first; c < n.first + 2; c++) {
+                float d = squared_distance(_nodes[c].b.lo, _nodes[c].b.hi, p);
+                if (d < distance) {
+                    queue.push(entry(d, c));
+                }
+            }
+            continue;
+        }
+        for (GLuint k = 0; k < n.count; k++) {
+            GLuint i = _items[n.first + k];
+            float d = squared_distance(_boxes[i].lo, _boxes[i].hi, p);
+            if (d < distance) {
+                distance = d;
+                item = i;
+            }
+        }
+    }
+    return true;
+}
+
+float bvh::sah_cost() const
+{
+    if (_nodes.empty()) {
+        return 0.0f;
+    }
+    float root = half_area(_nodes[0].b.lo, _nodes[0].b.hi);
+    if (root <= 0.0f) {
+        return static_cast<float>(_boxes.size());
+    }
+    float cost = 0.0f;
+    for (auto& n : _nodes) {
+        float p = half_area(n.b.lo, n.b.hi) / root;
+        cost += n.count == 0 ? traversal_cost * p : n.count * p;
+    }
+    return cost;
+}
+
+const size_t bvh_group::not_indexed;
+
+bvh_group::bvh_group() : _built_children(0)
+{
+}
+
+void bvh_group::invalidate(size_t child)
+{
+    _invalidated.push_back(child);
+}
+
+void bvh_group::rebuild()
+{
+    size_t count = children.size();
+    std::vector<bounds> all(count);
+    parallel_for(0, count, 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            all[i] = children[i]->get_bounds();
+        }
+    });
+    std::vector<bounds> boxes;
+    _child_of_item.clear();
+    _item_of_child.assign(count, not_indexed);
+    _unindexed.clear();
+    for (size_t i = 0; i < count; i++) {
+        if (all[i].known && !is_empty(all[i])) {
+            _item_of_child[i] = boxes.size();
+            _child_of_item.push_back(i);
+            boxes.push_back(all[i]);
+        } else {
+            _unindexed.push_back(i);
+        }
+    }
+    _bvh.build(boxes);
+    _built_children = count;
+    _invalidated.clear();
+}
+
+void bvh_group::update()
+{
+    if (children.size() != _built_children) {
+        rebuild();
+        return;
+    }
+    for (size_t child : _invalidated) {
+        bounds b = children[child]->get_bounds();
+        size_t item = _item_of_child[child];
+        // a child indexed or not from now on is only placed by a build
+        if ((item != not_indexed) != (b.known && !is_empty(b))) {
+            rebuild();
+            return;
+        }
+        if (item != not_indexed) {
+            _bvh.update(item, b);
+        }
+    }
+    _invalidated.clear();
+}
+
+void bvh_group::render(rendering_context& ctx)
+{
+    update();
+    std::shared_ptr<program> parent_prog = ctx.prog;
+    if (prog) {
+        ctx.prog = prog;
+    }
+    ctx.push(transform_callback(ctx));
+    clip_planes planes = extract_clip_planes(ctx.mvp());
+    ctx.culling.culled += _bvh.cull(planes, [&](size_t item) {
+        ctx.culling.visited++;
+        children[_child_of_item[item]]->render(ctx);
+    });
+    for (size_t child : _unindexed) {
+        ctx.culling.visited++;
+        children[child]->render(ctx);
+    }
+    ctx.pop();
+    ctx.prog = parent_prog;
+}
+
+bounds bvh_group::get_bounds() const
+{
+    if (!fixed_transform) {
+        return bounds();
+    }
+    if (children.size() != _built_children || !_invalidated.empty()) {
+        return group::get_bounds();
+    }
+    bounds b = _bvh.get_bounds();
+    for (size_t child : _unindexed) {
+        b = merge_bounds(b, children[child]->get_bounds());
+    }
+    return transform_bounds(transform, b);
+}
+
+void bvh_group::range(const bounds& box, std::vector<std::shared_ptr<node>>& nodes)
+{
+    update();
+    std::vector<size_t> items;
+    _bvh.range(box, items);
+    for (size_t item : items) {
+        nodes.push_back(children[_child_of_item[item]]);
+    }
+}
+
+bool bvh_group::intersect(const ray& r, ray_hit& hit)
+{
+    ray local;
+    if (!local_ray(r, local)) {
+        return false;
+    }
+    update();
+    bool found = false;
+    const std::vector<GLuint>& order = _bvh.order();
+    _bvh.raycast(local, hit.distance, [&](size_t first, size_t count, float /* max_distance */) {
+        for (size_t k = first; k < first + count; k++) {
+            found |= intersect_child(_child_of_item[order[k]], local, hit);
+        }
+        return hit.distance;
+    });
+    for (size_t child : _unindexed) {
+        found |= intersect_child(child, local, hit);
+    }
+    return found;
+}
+
+std::shared_ptr<node> bvh_group::nearest(const vector3f& point)
+{
+    update();
+    size_t item;
+    float distance;
+    if (!_bvh.nearest(point, item, distance)) {
+        return nullptr;
+    }
+    return children[_child_of_item[item]];
+}
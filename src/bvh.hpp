@@ -0,0 +1,121 @@
+#ifndef _bvh_hpp_
+#define _bvh_hpp_
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "culling.hpp"
+#include "geometry.hpp"
+#include "yae.hpp"
+
+namespace yae {
+
+// A bounding volume hierarchy of boxes, the items, identified by their index.
+// Built top down with the surface area heuristic over binned centroids, the
+// subtrees in parallel. Moving an item refits the boxes of its ancestors only.
+class bvh {
+public:
+    bvh();
+    // the boxes must be known and not empty
+    void build(const std::vector<bounds>& boxes);
+    inline size_t size() const { return _boxes.size(); }
+    // the box of item changed, grows or shrinks its ancestors up to the root
+    void update(size_t item, const bounds& box);
+    // recomputes the boxes of every node from those of the items
+    void refit();
+    // the union of the boxes, empty when there is none
+    bounds get_bounds() const;
+    // Calls visit with the items which may be inside the planes, skipping the
+    // subtrees entirely outside one and testing no more the planes a subtree
+    // is entirely inside of. Returns the number of items skipped.
+    size_t cull(const clip_planes& planes, const std::function<void(size_t)>& visit) const;
+    // appends the items whose box intersects box
+    void range(const bounds& box, std::vector<size_t>& items) const;
+    // The item whose box is the nearest to point, and the squared distance
+    // to that box, 0 inside it. False when empty.
+    bool nearest(const vector3f& point, size_t& item, float& distance) const;
+    // Calls leaf with the leaves whose box the ray crosses before max_distance,
+    // nearer boxes first. A leaf holds the items order()[first, first + count),
+    // leaf returns the distance the ray is then cut at, e.g. that of its
+    // nearest hit.
+    void raycast(const ray& r, float max_distance,
+        const std::function<float(size_t first, size_t count, float max_distance)>& leaf) const;
+    // the items in the order of the leaves
+    inline const std::vector<GLuint>& order() const { return _items; }
+    // the expected cost of a random ray through the tree, cf the heuristic
+    float sah_cost() const;
+private:
+    struct box {
+        float lo[3];
+        float hi[3];
+    };
+    // a leaf holds count items from _items[first], an inner node its
+    // children at first and first + 1
+    struct node {
+        box b;
+        GLuint first;
+        GLuint count;
+        GLuint parent;
+        GLuint items; // in the subtree
+    };
+    struct build_item {
+        box b;
+        float centroid[3];
+        GLuint item;
+    };
+    struct range_task {
+        GLuint node;
+        size_t begin;
+        size_t end;
+    };
+    bool split(const range_task& t, range_task& left, range_task& right);
+    void build_subtree(const range_task& t);
+    box leaf_box(const node& n) const;
+    std::vector<box> _boxes;
+    std::vector<node> _nodes;
+    std::vector<GLuint> _items;
+    std::vector<GLuint> _leaf_of;
+    std::vector<build_item> _work; // while building
+    std::unique_ptr<std::atomic<GLuint>> _allocated;
+};
+
+// A group whose children are culled through a bvh of their bounds, for
+// scenes of many nodes. The bvh is built on the first render after children
+// are added. A child whose bounds change afterwards, e.g. a group moved with
+// set_transform, must be invalidated to refit the tree. Children of unknown
+// or empty bounds are not indexed, they are rendered every frame.
+class bvh_group : public group {
+public:
+    bvh_group();
+    // the bounds of a child changed
+    void invalidate(size_t child);
+    // rebuilds the tree from the bounds of every child
+    void rebuild();
+    virtual void render(rendering_context& ctx);
+    virtual bounds get_bounds() const;
+    // the indexed children whose bounds intersect box, in the coordinates of the group
+    void range(const bounds& box, std::vector<std::shared_ptr<node>>& nodes);
+    // the indexed child whose bounds are the nearest to point, nullptr if none
+    std::shared_ptr<node> nearest(const vector3f& point);
+    // the indexed children whose bounds the ray crosses, nearer first
+    virtual bool intersect(const ray& r, ray_hit& hit);
+    inline const bvh& get_bvh() const { return _bvh; }
+private:
+    void update();
+    bvh _bvh;
+    std::vector<size_t> _child_of_item;
+    std::vector<size_t> _item_of_child; // not_indexed when rendered every frame
+    std::vector<size_t> _unindexed;
+    std::vector<size_t> _invalidated;
+    size_t _built_children;
+    static const size_t not_indexed = ~(size_t)0;
+};
+
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include <cmath>
+
+#include "culling.hpp"
+
+using namespace yae;
+
+clip_planes yae::extract_clip_planes(const matrix44f& mvp)
+{
+    // row i of the column major matrix is m[i], m[4 + i], m[8 + i], m[12 + i]
+    const float* m = mvp.m;
+    clip_planes p;
+    for (int c = 0; c < 4; c++) {
+        float x = m[c * 4];
+        float y = m[c * 4 + 1];
+        float z = m[c * 4 + 2];
+        float w = m[c * 4 + 3];
+        p.planes[0][c] = w + x; // left
+        p.planes[1][c] = w - x; // right
+        p.planes[2][c] = w + y; // bottom
+        p.planes[3][c] = w - y; // top
+        p.planes[4][c] = w + z; // near
+        p.planes[5][c] = w - z; // far
+    }
+    return p;
+}
+
+bool yae::intersects(const clip_planes& planes, const bounds& b)
+{
+    if (!b.known) {
+        return true;
+    }
+    if (is_empty(b)) {
+        return false;
+    }
+    vector3f c = midpoint(b.lo, b.hi);
+    vector3f e = (b.hi - b.lo) / 2.0f;
+    for (auto& p : planes.planes) {
+        // the distance of the center against the projected radius of the box
+        float distance = p[0] * c.x() + p[1] * c.y() + p[2] * c.z() + p[3];
+        float radius = std::abs(p[0]) * e.x() + std::abs(p[1]) * e.y() + std::abs(p[2]) * e.z();
+        if (distance + radius < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+unsigned int yae::intersects(const clip_planes& planes, const bounds* const boxes[4])
+{
+    // the boxes transposed, one component of the 4 per register
+    alignas(16) float c[3][4];
+    alignas(16) float e[3][4];
+    unsigned int tested = 0;
+    unsigned int visible = 0;
+    for (int i = 0; i < 4; i++) {
+        const bounds* b = boxes[i];
+        bool known = b != nullptr && b->known && !is_empty(*b);
+        vector3f center = known ? midpoint(b->lo, b->hi) : vector3f();
+        vector3f extent = known ? (b->hi - b->lo) / 2.0f : vector3f();
+        c[0][i] = center.x();
+        c[1][i] = center.y();
+        c[2][i] = center.z();
+        e[0][i] = extent.x();
+        e[1][i] = extent.y();
+        e[2][i] = extent.z();
+        if (known) {
+            tested |= 1u << i;
+        } else if (b != nullptr && !b->known) {
+            visible |= 1u << i;
+        }
+    }
+#ifdef YAE_SSE
+    __m128 cx = _mm_load_ps(c[0]);
+    __m128 cy = _mm_load_ps(c[1]);
+    __m128 cz = _mm_load_ps(c[2]);
+    __m128 ex = _mm_load_ps(e[0]);
+    __m128 ey = _mm_load_ps(e[1]);
+    __m128 ez = _mm_load_ps(e[2]);
+    __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 inside = _mm_cmpeq_ps(cx, cx);
+    for (auto& p : planes.planes) {
+        __m128 a = _mm_set1_ps(p[0]);
+        __m128 b = _mm_set1_ps(p[1]);
+        __m128 d = _mm_set1_ps(p[2]);
+        // in the order of the scalar version, for the same results
+        __m128 distance = _mm_add_ps(_mm_mul_ps(a, cx), _mm_mul_ps(b, cy));
+        distance = _mm_add_ps(_mm_add_ps(distance, _mm_mul_ps(d, cz)), _mm_set1_ps(p[3]));
+        __m128 radius = _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign, a), ex), _mm_mul_ps(_mm_andnot_ps(sign, b), ey));
+        radius = _mm_add_ps(radius, _mm_mul_ps(_mm_andnot_ps(sign, d), ez));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+    }
+    visible |= static_cast<unsigned int>(_mm_movemask_ps(inside)) & tested;
+#else
+    for (int i = 0; i < 4; i++) {
+        if (tested & (1u << i)) {
+            visible |= intersects(planes, *boxes[i]) ? 1u << i : 0u;
+        }
+    }
+#endif
+    return visible;
+}
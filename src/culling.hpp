@@ -0,0 +1,31 @@
+#ifndef _culling_hpp_
+#define _culling_hpp_
+
+#include <cstddef>
+
+#include "geometry.hpp"
+#include "matrix.hpp"
+
+namespace yae {
+
+// The 6 planes of the clip volume of a model view projection, in model
+// coordinates: a point is inside when a * x + b * y + c * z + d >= 0 for all.
+// Extracted from the rows of the matrix, cf Gribb and Hartmann "Fast
+// Extraction of Viewing Frustum Planes from the World-View-Projection
+// Matrix", hence valid for perspective and parallel projections alike.
+struct clip_planes {
+    float planes[6][4];
+};
+
+clip_planes extract_clip_planes(const matrix44f& mvp);
+
+// false when the box of b is entirely outside a plane, true when unknown
+bool intersects(const clip_planes& planes, const bounds& b);
+
+// Tests 4 boxes at once, boxes[i] may be nullptr. Bit i of the result is set
+// when boxes[i] may be visible, with the same results as intersects.
+unsigned int intersects(const clip_planes& planes, const bounds* const boxes[4]);
+
+}
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef _dynamic_geometry_hpp_
+#define _dynamic_geometry_hpp_
+
+#include <array>
+#include <memory>
+
+#include <GL/glew.h>
+
+#include "geometry.hpp"
+
+namespace yae {
+
+// A geometry whose vertices are rewritten every frame, e.g. simulations or plots.
+// The vertex buffer is a ring of ring_size regions of capacity vertices: while
+// the GPU reads the region of frame N the CPU writes the one of frame N + 1 or
+// N + 2. A fence per region tells when it can be reused, so that writes only
+// wait when the GPU is more than ring_size - 1 frames behind.
+// The buffer is persistently mapped when ARB_buffer_storage is available,
+// otherwise each region is mapped unsynchronized, which the fences make safe.
+template<class T>
+class dynamic_geometry {
+public:
+    static const size_t ring_size = 3;
+
+    dynamic_geometry(const vertex_format& format, size_t capacity, GLint dimensions, GLenum primitive_type)
+        : _format(format), _capacity(capacity), _region(0), _updates(0), _stalls(0), _mapped(nullptr), _region_data(nullptr),
+          _geometry(std::make_shared<geometry<T>>(0, dimensions, primitive_type))
+    {
+        _fences.fill(nullptr);
+        GLsizeiptr size = region_size() * ring_size;
+        glGenBuffers(1, &_buffer_id);
+        gl_state::current().bind_buffer(GL_ARRAY_BUFFER, _buffer_id);
+        _persistent = GLEW_ARB_buffer_storage != 0;
+        if (_persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+            _mapped = static_cast<unsigned char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+            // the storage is writable, regions can still be mapped one at a time
+            _persistent = _mapped != nullptr;
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        }
+        _geometry->set_vertex_buffer(_buffer_id, format);
+    }
+
+    ~dynamic_geometry()
+    {
+        if (_persistent) {
+            gl_state::current().bind_buffer(GL_ARRAY_BUFFER, _buffer_id);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        for (GLsync fence : _fences) {
+            glDeleteSync(fence);
+        }
+    }
+
+    // Returns where to write the vertices of the next frame, room for
+    // capacity vertices laid out according to the format.
+    void* begin_update()
+    {
+        // the commands issued so far include the draws of the previous region
+        size_t previous = (_region + ring_size - 1) % ring_size;
+        if (_updates > 0) {
+            glDeleteSync(_fences[previous]);
+            _fences[previous] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        wait(_fences[_region]);
+        GLintptr offset = region_size() * _region;
+        if (_persistent) {
+            _region_data = _mapped + offset;
+        } else {
+            gl_state::current().bind_buffer(GL_ARRAY_BUFFER, _buffer_id);
+            _region_data = glMapBufferRange(GL_ARRAY_BUFFER, offset, region_size(),
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        }
+        return _region_data;
+    }
+
+    // count vertices were written, the geometry draws them until the next update
+    void end_update(size_t count)
+    {
+        if (!_persistent) {
+            gl_state::current().bind_buffer(GL_ARRAY_BUFFER, _buffer_id);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        _geometry->set_first(static_cast<GLint>(_capacity * _region));
+        _geometry->set_count(static_cast<GLsizei>(std::min(count, _capacity)));
+        _region_data = nullptr;
+        _region = (_region + 1) % ring_size;
+        _updates++;
+    }
+
+    // to share with geometry nodes, valid as long as the dynamic geometry
+    inline std::shared_ptr<geometry<T>> get_geometry() const
+    {
+        return _geometry;
+    }
+
+    inline size_t get_capacity() const
+    {
+        return _capacity;
+    }
+
+    inline bool is_persistent() const
+    {
+        return _persistent;
+    }
+
+    // how many updates had to wait for the GPU
+    inline size_t get_stalls() const
+    {
+        return _stalls;
+    }
+
+private:
+    inline GLsizeiptr region_size() const
+    {
+        return static_cast<GLsizeiptr>(_capacity * _format.stride);
+    }
+
+    void wait(GLsync fence)
+    {
+        if (fence == nullptr) {
+            return;
+        }
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_ALREADY_SIGNALED || status == GL_WAIT_FAILED) {
+            return;
+        }
+        _stalls++;
+        while (status == GL_TIMEOUT_EXPIRED) {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+    }
+
+    vertex_format _format;
+    size_t _capacity;
+    size_t _region;
+    size_t _updates;
+    size_t _stalls;
+    bool _persistent;
+    GLuint _buffer_id;
+    unsigned char* _mapped;
+    void* _region_data;
+    std::array<GLsync, ring_size> _fences;
+    std::shared_ptr<geometry<T>> _geometry;
+    dynamic_geometry(const dynamic_geometry<T>&);
+};
+
+template<class T>
+const size_t dynamic_geometry<T>::ring_size;
+
+}
+
+#endif
@@ -0,0 +1,158 @@
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+#include "geometry.hpp"
+
+using namespace yae;
+
+static inline uint32_t hash_bytes(const unsigned char* p, size_t n)
+{
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+void yae::weld_vertices(const void* vertices, size_t count, size_t stride, std::vector<GLuint>& remap, std::vector<GLuint>& first)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(vertices);
+    const GLuint empty = ~0u;
+    size_t table_size = 1;
+    while (table_size < count * 2) {
+        table_size <<= 1;
+    }
+    // open addressing with linear probing, each slot holds a distinct vertex number
+    std::vector<GLuint> table(table_size, empty);
+    remap.resize(count);
+    first.clear();
+    for (size_t i = 0; i < count; i++) {
+        const unsigned char* v = bytes + i * stride;
+        size_t slot = hash_bytes(v, stride) & (table_size - 1);
+        for (;;) {
+            GLuint u = table[slot];
+            if (u == empty) {
+                u = static_cast<GLuint>(first.size());
+                table[slot] = u;
+                first.push_back(static_cast<GLuint>(i));
+                remap[i] = u;
+                break;
+            }
+            if (memcmp(bytes + first[u] * stride, v, stride) == 0) {
+                remap[i] = u;
+                break;
+            }
+            slot = (slot + 1) & (table_size - 1);
+        }
+    }
+}
+
+GLushort yae::float_to_half(float f)
+{
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    GLushort sign = static_cast<GLushort>((x >> 16) & 0x8000);
+    uint32_t a = x & 0x7fffffff;
+    if (a >= 0x7f800000) {
+        // infinity or NaN
+        return sign | 0x7c00 | (a > 0x7f800000 ? 0x200 : 0);
+    }
+    if (a >= 0x477ff000) {
+        // rounds to a value beyond 65504
+        return sign | 0x7c00;
+    }
+    if (a < 0x38800000) {
+        // subnormal, in units of 2^-24
+        float abs_f;
+        memcpy(&abs_f, &a, sizeof(abs_f));
+        return sign | static_cast<GLushort>(std::nearbyint(abs_f * 16777216.0f));
+    }
+    // rebias the exponent from 127 to 15 and round the 13 dropped bits to nearest even
+    a += 0xc8000fff + ((a >> 13) & 1);
+    return sign | static_cast<GLushort>(a >> 13);
+}
+
+bounds yae::bounds_of(const float* points, size_t count)
+{
+    bounds b;
+    b.known = true;
+    float lo[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+    float hi[3] = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+    for (size_t i = 0; i < count; i++) {
+        for (int c = 0; c < 3; c++) {
+            lo[c] = std::min(lo[c], points[i * 3 + c]);
+            hi[c] = std::max(hi[c], points[i * 3 + c]);
+        }
+    }
+    b.lo = vector3f(lo[0], lo[1], lo[2]);
+    b.hi = vector3f(hi[0], hi[1], hi[2]);
+    if (count == 0) {
+        return b;
+    }
+    // the center of the box, a sphere a little larger than the smallest one
+    b.center = midpoint(b.lo, b.hi);
+    float r2 = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        vector3f d = vector3f(&points[i * 3]) - b.center;
+        r2 = std::max(r2, dot_product(d, d));
+    }
+    b.radius = std::sqrt(r2);
+    return b;
+}
+
+bounds yae::merge_bounds(const bounds& a, const bounds& b)
+{
+    if (!a.known || !b.known) {
+        return bounds();
+    }
+    if (is_empty(a)) {
+        return b;
+    }
+    if (is_empty(b)) {
+        return a;
+    }
+    bounds m;
+    m.known = true;
+    m.lo = vector3f(std::min(a.lo.x(), b.lo.x()), std::min(a.lo.y(), b.lo.y()), std::min(a.lo.z(), b.lo.z()));
+    m.hi = vector3f(std::max(a.hi.x(), b.hi.x()), std::max(a.hi.y(), b.hi.y()), std::max(a.hi.z(), b.hi.z()));
+    // the smallest sphere around both
+    vector3f d = b.center - a.center;
+    float distance = length(d);
+    if (distance + b.radius <= a.radius) {
+        m.center = a.center;
+        m.radius = a.radius;
+    } else if (distance + a.radius <= b.radius) {
+        m.center = b.center;
+        m.radius = b.radius;
+    } else {
+        m.radius = (distance + a.radius + b.radius) / 2;
+        m.center = a.center + d * ((m.radius - a.radius) / distance);
+    }
+    return m;
+}
+
+bounds yae::transform_bounds(const matrix44f& m, const bounds& b)
+{
+    if (!b.known || is_empty(b)) {
+        return b;
+    }
+    // the extent along each axis is the sum of the absolute contributions
+    // of the extents of the box, cf Arvo "Transforming Axis-Aligned Bounding Boxes"
+    vector3f center = m * midpoint(b.lo, b.hi);
+    vector3f extent = (b.hi - b.lo) / 2.0f;
+    float e[3];
+    for (int r = 0; r < 3; r++) {
+        e[r] = std::abs(m.m[r]) * extent.x() + std::abs(m.m[4 + r]) * extent.y() + std::abs(m.m[8 + r]) * extent.z();
+    }
+    bounds t;
+    t.known = true;
+    t.lo = vector3f(center.x() - e[0], center.y() - e[1], center.z() - e[2]);
+    t.hi = vector3f(center.x() + e[0], center.y() + e[1], center.z() + e[2]);
+    t.center = m * b.center;
+    float scale = std::max(length(vector3f(m.m[0], m.m[1], m.m[2])),
+        std::max(length(vector3f(m.m[4], m.m[5], m.m[6])), length(vector3f(m.m[8], m.m[9], m.m[10]))));
+    t.radius = b.radius * scale;
+    return t;
+}
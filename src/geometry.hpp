@@ -3,82 +3,445 @@
 
 #include <vector>
 #include <stack>
+#include <map>
 #include <memory>
+#include <functional>
+#include <limits>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
 
 #include <GL/glew.h>
 
+#include "gl_state.hpp"
+#include "matrix.hpp"
+#include "parallel.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
+
 namespace yae {
 
 enum vertex_attribute : GLuint {
     POSITION,
     TEXCOORD,
-    NORMAL
+    NORMAL,
+    INSTANCE_COLOR,
+    INSTANCE_TRANSFORM, // a matrix, its columns at this location and the 3 next
+    // applied before the instance transform, e.g. the position transform of each draw of a geometry_batch
+    INSTANCE_POSITION_TRANSFORM = INSTANCE_TRANSFORM + 4
+};
+
+// a set of vertex attributes, as expected by a program
+inline GLuint attribute_bit(GLuint attribute)
+{
+    return 1u << attribute;
+}
+
+// the locations taken by an attribute declared in a shader, 4 for a matrix
+inline GLuint attribute_bits(GLuint attribute)
+{
+    return attribute == vertex_attribute::INSTANCE_TRANSFORM || attribute == vertex_attribute::INSTANCE_POSITION_TRANSFORM
+        ? 0xfu << attribute : attribute_bit(attribute);
+}
+
+// size in bytes of a component of the given type
+constexpr GLsizei component_bytes(GLenum type)
+{
+    return type == GL_BYTE || type == GL_UNSIGNED_BYTE ? 1
+        : type == GL_SHORT || type == GL_UNSIGNED_SHORT || type == GL_HALF_FLOAT ? 2
+        : type == GL_DOUBLE ? 8
+        : 4;
+}
+
+// whether all the components of an attribute are packed in 4 bytes
+constexpr bool is_packed(GLenum type)
+{
+    return type == GL_INT_2_10_10_10_REV || type == GL_UNSIGNED_INT_2_10_10_10_REV;
+}
+
+// size in bytes of an attribute, padded so that the next one is 4 bytes aligned
+constexpr GLsizei attribute_bytes(GLenum type, GLint size)
+{
+    return is_packed(type) ? 4 : (size * component_bytes(type) + 3) / 4 * 4;
+}
+
+// where and how an attribute is stored in a vertex
+struct vertex_element {
+    GLuint attribute;
+    GLint size; // number of components
+    GLenum type;
+    GLboolean normalized;
+    GLsizei offset; // in bytes from the start of the vertex
+};
+
+// the runtime description of the attributes interleaved in a vertex buffer
+struct vertex_format {
+
+    vertex_format() : stride(0), divisor(0) {}
+
+    // appends an attribute after the ones already in the format
+    vertex_format& add(GLuint attribute, GLint size, GLenum type = GL_FLOAT, GLboolean normalized = GL_FALSE)
+    {
+        elements.push_back(vertex_element{ attribute, size, type, normalized, stride });
+        stride += attribute_bytes(type, size);
+        return *this;
+    }
+
+    const vertex_element* find(GLuint attribute) const
+    {
+        for (auto& e : elements) {
+            if (e.attribute == attribute) {
+                return &e;
+            }
+        }
+        return nullptr;
+    }
+
+    // the set of attributes provided, cf attribute_bit
+    GLuint attributes() const
+    {
+        GLuint bits = 0;
+        for (auto& e : elements) {
+            bits |= attribute_bit(e.attribute);
+        }
+        return bits;
+    }
+
+    std::vector<vertex_element> elements;
+    GLsizei stride;
+    GLuint divisor; // 0 for vertices, 1 for attributes advancing once per instance
+};
+
+template<class C> struct gl_type;
+template<> struct gl_type<GLfloat> { static const GLenum value = GL_FLOAT; };
+template<> struct gl_type<GLbyte> { static const GLenum value = GL_BYTE; };
+template<> struct gl_type<GLubyte> { static const GLenum value = GL_UNSIGNED_BYTE; };
+template<> struct gl_type<GLshort> { static const GLenum value = GL_SHORT; };
+template<> struct gl_type<GLushort> { static const GLenum value = GL_UNSIGNED_SHORT; };
+template<> struct gl_type<GLint> { static const GLenum value = GL_INT; };
+template<> struct gl_type<GLuint> { static const GLenum value = GL_UNSIGNED_INT; };
+
+// components without a C++ type of their own
+struct half_float {};
+struct int_2_10_10_10_rev {};
+template<> struct gl_type<half_float> { static const GLenum value = GL_HALF_FLOAT; };
+template<> struct gl_type<int_2_10_10_10_rev> { static const GLenum value = GL_INT_2_10_10_10_REV; };
+
+// compile time description of an attribute of a vertex_layout
+template<GLuint Attribute, GLint Size, class Component = GLfloat, bool Normalized = false>
+struct attribute {
+    static const GLuint index = Attribute;
+    static const GLint size = Size;
+    static const GLenum type = gl_type<Component>::value;
+    static const bool normalized = Normalized;
+    static const GLsizei bytes = attribute_bytes(gl_type<Component>::value, Size);
 };
 
+template<class... Attributes>
+struct layout_stride;
+
+template<>
+struct layout_stride<> {
+    static const GLsizei value = 0;
+};
+
+template<class Attribute, class... Attributes>
+struct layout_stride<Attribute, Attributes...> {
+    static const GLsizei value = Attribute::bytes + layout_stride<Attributes...>::value;
+};
+
+// Compile time description of an interleaved vertex, the attributes
+// are stored in the order of the template arguments, e.g.
+// vertex_layout<attribute<POSITION, 3>, attribute<NORMAL, 3>>
+template<class... Attributes>
+struct vertex_layout {
+
+    static const GLsizei stride = layout_stride<Attributes...>::value;
+
+    static vertex_format format()
+    {
+        vertex_format f;
+        int expand[] = { 0, (f.add(Attributes::index, Attributes::size, Attributes::type, Attributes::normalized), 0)... };
+        (void)expand;
+        return f;
+    }
+};
+
+template<class... Attributes>
+const GLsizei vertex_layout<Attributes...>::stride;
+
+typedef vertex_layout<attribute<vertex_attribute::POSITION, 3>> position_layout;
+typedef vertex_layout<attribute<vertex_attribute::POSITION, 3>, attribute<vertex_attribute::NORMAL, 3>> position_normal_layout;
+typedef vertex_layout<attribute<vertex_attribute::POSITION, 3>, attribute<vertex_attribute::TEXCOORD, 2>, attribute<vertex_attribute::NORMAL, 3>> position_tex_coord_normal_layout;
+
+// 12 bytes instead of 24, the positions are snorm16 relative to the bounds of the mesh
+typedef vertex_layout<attribute<vertex_attribute::POSITION, 3, GLshort, true>,
+    attribute<vertex_attribute::NORMAL, 4, int_2_10_10_10_rev, true>> quantized_position_normal_layout;
+
+// a vertex buffer and the format of its vertices
+struct vertex_stream {
+    GLuint buffer_id;
+    vertex_format format;
+};
+
+// a draw of glMultiDrawElementsIndirect, cf geometry::set_draws
+struct draw_elements_command {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+};
+
+// An axis aligned box and a sphere around the same positions. Unknown
+// bounds, the default, are never culled; empty ones have lo > hi.
+struct bounds {
+    vector3f lo;
+    vector3f hi;
+    vector3f center;
+    float radius = -1.0f;
+    bool known = false;
+};
+
+inline bool is_empty(const bounds& b)
+{
+    return b.known && (b.lo.x() > b.hi.x() || b.lo.y() > b.hi.y() || b.lo.z() > b.hi.z());
+}
+
+// the bounds of count points of 3 coordinates, empty when count is 0
+bounds bounds_of(const float* points, size_t count);
+
+// the bounds of both, unknown when either is
+bounds merge_bounds(const bounds& a, const bounds& b);
+
+// the box around the transformed box and the transformed sphere
+bounds transform_bounds(const matrix44f& m, const bounds& b);
+
 template<class T>
 struct geometry {
 
+    // count is the number of vertices to draw, that is the number
+    // of indices when the geometry has an index buffer
 	geometry(GLsizei count, GLint dimensions, GLenum primitive_type)
-    : count(count), _positions_id(0), _tex_coords_id(0),
-      _normals_id(0), dimensions(dimensions), primitive_type(primitive_type)
+    : _indices_id(0), _index_type(GL_NONE), count(count),
+      dimensions(dimensions), primitive_type(primitive_type), _position_transform(identity<float>()),
+      _primitive_restart(false), _first(0), _instance_count(0), _draws_id(0), _draws_changed(false)
     {}
 
     ~geometry()
     {
-        glDeleteBuffers(1, &_positions_id);
-        glDeleteBuffers(1, &_tex_coords_id);
-        glDeleteBuffers(1, &_normals_id);
+        while (!_streams.empty()) {
+            GLuint id = _streams.back().buffer_id;
+            _streams.pop_back();
+            release_buffer(id);
+        }
+        if (_indices_id != 0) {
+            gl_state::current().delete_buffer(_indices_id);
+        }
+        if (_draws_id != 0) {
+            gl_state::current().delete_buffer(_draws_id);
+        }
+        reset_vertex_arrays();
+    }
+
+    // Reads the attributes of format from a buffer owned by the geometry,
+    // the buffers which were providing some of these attributes are released.
+    void set_vertex_buffer(GLuint buffer_id, const vertex_format& format)
+    {
+        for (auto it = _streams.begin(); it != _streams.end();) {
+            if (it->format.attributes() & format.attributes()) {
+                GLuint old_id = it->buffer_id;
+                it = _streams.erase(it);
+                if (old_id != buffer_id) {
+                    release_buffer(old_id);
+                }
+            } else {
+                ++it;
+            }
+        }
+        _streams.push_back(vertex_stream{ buffer_id, format });
+        reset_vertex_arrays();
+    }
+
+    void set_vertex_buffer(const void* data, long size, const vertex_format& format)
+    {
+        GLuint id;
+        glGenBuffers(1, &id);
+        gl_state::current().bind_buffer(GL_ARRAY_BUFFER, id);
+        glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+        set_vertex_buffer(id, format);
     }
 
     inline void set_vertex_positions(GLuint positions_id)
     {
-        _positions_id = positions_id;
+        set_vertex_buffer(positions_id, vertex_format().add(vertex_attribute::POSITION, dimensions));
     }
 
     inline void set_vertex_tex_coords(GLuint tex_coords_id)
     {
-        _tex_coords_id = tex_coords_id;
+        set_vertex_buffer(tex_coords_id, vertex_format().add(vertex_attribute::TEXCOORD, dimensions));
     }
 
     inline void set_vertex_normals(GLuint normals_id)
     {
-        _normals_id = normals_id;
+        set_vertex_buffer(normals_id, vertex_format().add(vertex_attribute::NORMAL, 3));
+    }
+
+    // index_type is GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    inline void set_indices(GLuint indices_id, GLenum index_type)
+    {
+        _indices_id = indices_id;
+        _index_type = index_type;
+        reset_vertex_arrays();
     }
 
     void set_vertex_positions(void* data, long size)
     {
-        glGenBuffers(1, &_positions_id);
-        glBindBuffer(GL_ARRAY_BUFFER, _positions_id);
-        glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+        set_vertex_buffer(data, size, vertex_format().add(vertex_attribute::POSITION, dimensions));
     }
 
 	void set_vertex_tex_coords(void* data, long size)
     {
-        glGenBuffers(1, &_tex_coords_id);
-        glBindBuffer(GL_ARRAY_BUFFER, _tex_coords_id);
-        glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+        set_vertex_buffer(data, size, vertex_format().add(vertex_attribute::TEXCOORD, dimensions));
     }
 
     void set_vertex_normals(void* data, long size)
     {
-        glGenBuffers(1, &_normals_id);
-        glBindBuffer(GL_ARRAY_BUFFER, _normals_id);
-        glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+        set_vertex_buffer(data, size, vertex_format().add(vertex_attribute::NORMAL, 3));
+    }
+
+    void set_indices(const void* data, long size, GLenum index_type)
+    {
+        reset_vertex_arrays();
+        glGenBuffers(1, &_indices_id);
+        gl_state::current().bind_buffer(GL_ELEMENT_ARRAY_BUFFER, _indices_id);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+        _index_type = index_type;
+    }
+
+    // Returns the vertex array object feeding the given set of attributes
+    // (see attribute_bit), it is created on first use and then reused.
+    // The attribute pointers are derived from the formats of the buffers.
+    // A vertex array created is left bound.
+    GLuint get_vertex_array(GLuint attributes) const
+    {
+        auto it = _vertex_arrays.find(attributes);
+        if (it != _vertex_arrays.end()) {
+            return it->second;
+        }
+        gl_state& state = gl_state::current();
+        GLuint id;
+        glGenVertexArrays(1, &id);
+        state.bind_vertex_array(id);
+        for (auto& stream : _streams) {
+            if ((stream.format.attributes() & attributes) == 0) {
+                continue;
+            }
+            state.bind_buffer(GL_ARRAY_BUFFER, stream.buffer_id);
+            for (auto& e : stream.format.elements) {
+                if (attributes & attribute_bit(e.attribute)) {
+                    glEnableVertexAttribArray(e.attribute);
+                    glVertexAttribPointer(e.attribute, e.size, e.type, e.normalized, stream.format.stride,
+                        reinterpret_cast<const void*>(static_cast<size_t>(e.offset)));
+                    if (stream.format.divisor != 0) {
+                        glVertexAttribDivisor(e.attribute, stream.format.divisor);
+                    }
+                }
+            }
+        }
+        if (_indices_id != 0) {
+            // to the vertex array, not through gl_state which would unbind it
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indices_id);
+        }
+        _vertex_arrays[attributes] = id;
+        return id;
+    }
+
+    // the buffer providing an attribute, 0 if none
+    GLuint get_vertex_buffer(GLuint attribute) const
+    {
+        for (auto& stream : _streams) {
+            if (stream.format.find(attribute)) {
+                return stream.buffer_id;
+            }
+        }
+        return 0;
+    }
+
+    inline const std::vector<vertex_stream>& get_streams() const
+    {
+        return _streams;
+    }
+
+    // Drawn as these ranges of the indices in a single multi draw call
+    // rather than as count indices from the first one, when not empty.
+    void set_draws(std::vector<draw_elements_command> draws)
+    {
+        _draws = std::move(draws);
+        _draws_changed = true;
+    }
+
+    inline const std::vector<draw_elements_command>& get_draws() const
+    {
+        return _draws;
+    }
+
+    // the draws in a GL_DRAW_INDIRECT_BUFFER, uploaded on first use after they change
+    GLuint get_draws_buffer() const
+    {
+        if (_draws_changed) {
+            if (_draws_id == 0) {
+                glGenBuffers(1, &_draws_id);
+            }
+            gl_state::current().bind_buffer(GL_DRAW_INDIRECT_BUFFER, _draws_id);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, _draws.size() * sizeof(draw_elements_command), _draws.data(), GL_STATIC_DRAW);
+            _draws_changed = false;
+        }
+        return _draws_id;
     }
 
     inline GLuint get_positions_id() const
     {
-        return _positions_id;
+        return get_vertex_buffer(vertex_attribute::POSITION);
     }
 
     inline GLuint get_tex_coords_id() const
     {
-        return _tex_coords_id;
+        return get_vertex_buffer(vertex_attribute::TEXCOORD);
     }
 
     inline GLuint get_normals_id() const
     {
-        return _normals_id;
+        return get_vertex_buffer(vertex_attribute::NORMAL);
+    }
+
+    inline GLuint get_indices_id() const
+    {
+        return _indices_id;
+    }
+
+    inline GLenum get_index_type() const
+    {
+        return _index_type;
+    }
+
+    inline bool is_indexed() const
+    {
+        return _indices_id != 0;
+    }
+
+    // When set, the largest value of the index type restarts the primitive,
+    // e.g. to draw several triangle strips at once.
+    inline void set_primitive_restart(bool primitive_restart)
+    {
+        _primitive_restart = primitive_restart;
+    }
+
+    inline bool has_primitive_restart() const
+    {
+        return _primitive_restart;
     }
 
     inline GLsizei get_count() const
@@ -86,6 +449,34 @@ struct geometry {
         return count;
     }
 
+    inline void set_count(GLsizei count)
+    {
+        this->count = count;
+    }
+
+    // the first vertex drawn, added to the indices when indexed
+    inline GLint get_first() const
+    {
+        return _first;
+    }
+
+    inline void set_first(GLint first)
+    {
+        _first = first;
+    }
+
+    // Drawn this many times in a draw call when not 0, the attributes of
+    // the streams of divisor 1 advancing once per instance.
+    inline GLsizei get_instance_count() const
+    {
+        return _instance_count;
+    }
+
+    inline void set_instance_count(GLsizei instance_count)
+    {
+        _instance_count = instance_count;
+    }
+
     inline GLint get_dimensions() const
     {
         return dimensions;
@@ -96,20 +487,161 @@ struct geometry {
         return primitive_type;
     }
 
+    // Maps the positions stored in the buffers to model coordinates, programs
+    // apply it before the model view projection, e.g. to dequantize positions.
+    inline void set_position_transform(const matrix44f& position_transform)
+    {
+        _position_transform = position_transform;
+    }
+
+    inline const matrix44f& get_position_transform() const
+    {
+        return _position_transform;
+    }
+
+    // in model coordinates, cf geometry_builder::compute_bounds
+    inline void set_bounds(const bounds& b)
+    {
+        _bounds = b;
+    }
+
+    inline const bounds& get_bounds() const
+    {
+        return _bounds;
+    }
+
 private:
-	GLuint _positions_id;
-	GLuint _tex_coords_id;
-	GLuint _normals_id;
+    // the vertex arrays refer to the buffers, they are rebuilt when one changes
+    void reset_vertex_arrays()
+    {
+        for (auto& va : _vertex_arrays) {
+            gl_state::current().delete_vertex_array(va.second);
+        }
+        _vertex_arrays.clear();
+    }
+
+    // several streams may share an interleaved buffer
+    void release_buffer(GLuint buffer_id)
+    {
+        for (auto& stream : _streams) {
+            if (stream.buffer_id == buffer_id) {
+                return;
+            }
+        }
+        gl_state::current().delete_buffer(buffer_id);
+    }
+
+    mutable std::map<GLuint, GLuint> _vertex_arrays;
+    std::vector<vertex_stream> _streams;
+    GLuint _indices_id;
+    GLenum _index_type;
     GLsizei count;
     GLint dimensions;
     GLuint primitive_type;
+    matrix44f _position_transform;
+    bool _primitive_restart;
+    GLint _first;
+    GLsizei _instance_count;
+    std::vector<draw_elements_command> _draws;
+    mutable GLuint _draws_id;
+    mutable bool _draws_changed;
+    bounds _bounds;
 };
 
+// Finds the vertices of stride bytes which are identical bit for bit,
+// using a hash table. Fills remap with the new index of each of the count
+// input vertices, and first with the input index of each distinct vertex.
+void weld_vertices(const void* vertices, size_t count, size_t stride, std::vector<GLuint>& remap, std::vector<GLuint>& first);
+
+// IEEE 754 binary16, rounded to nearest even
+GLushort float_to_half(float f);
+
+template<class C, class T>
+inline C to_component(T v, GLboolean normalized)
+{
+    if (!std::numeric_limits<C>::is_integer) {
+        // -0 is written as +0 so that both weld together
+        return v == (T)0 ? (C)0 : (C)v;
+    }
+    if (!normalized) {
+        return (C)v;
+    }
+    double lowest = std::numeric_limits<C>::is_signed ? -1.0 : 0.0;
+    double d = std::min(std::max((double)v, lowest), 1.0);
+    return (C)std::floor(d * std::numeric_limits<C>::max() + 0.5);
+}
+
+template<class C, class T>
+void encode_components(const vertex_element& e, GLsizei stride, const T* src, GLint src_size, size_t count, unsigned char* dest)
+{
+    for (size_t i = 0; i < count; i++) {
+        unsigned char* out = dest + i * stride + e.offset;
+        for (GLint c = 0; c < e.size; c++) {
+            C value = to_component<C>(c < src_size ? src[i * src_size + c] : (T)0, e.normalized);
+            memcpy(out + c * sizeof(C), &value, sizeof(C));
+        }
+    }
+}
+
+template<class T>
+void encode_half(const vertex_element& e, GLsizei stride, const T* src, GLint src_size, size_t count, unsigned char* dest)
+{
+    for (size_t i = 0; i < count; i++) {
+        unsigned char* out = dest + i * stride + e.offset;
+        for (GLint c = 0; c < e.size; c++) {
+            GLushort value = float_to_half(c < src_size ? (float)src[i * src_size + c] : 0.0f);
+            memcpy(out + c * sizeof(GLushort), &value, sizeof(GLushort));
+        }
+    }
+}
+
+// x, y, z in the lower 30 bits, w in the upper 2
+template<class T>
+void encode_2_10_10_10(const vertex_element& e, GLsizei stride, const T* src, GLint src_size, size_t count, unsigned char* dest)
+{
+    bool is_signed = e.type == GL_INT_2_10_10_10_REV;
+    for (size_t i = 0; i < count; i++) {
+        GLuint packed = 0;
+        for (GLint c = 0; c < std::min(e.size, 4); c++) {
+            int bits = c < 3 ? 10 : 2;
+            double v = c < src_size ? (double)src[i * src_size + c] : 0.0;
+            double max = is_signed ? (1 << (bits - 1)) - 1 : (1 << bits) - 1;
+            double min = is_signed ? -max - (e.normalized ? 0 : 1) : 0.0;
+            if (e.normalized) {
+                v *= max;
+            }
+            int value = (int)std::floor(std::min(std::max(v, min), max) + 0.5);
+            packed |= (GLuint)(value & ((1 << bits) - 1)) << (c * 10);
+        }
+        memcpy(dest + i * stride + e.offset, &packed, sizeof(packed));
+    }
+}
+
+// Writes count attribute values of src_size components each into the
+// vertices at dest, converting them to the type of the element.
+// Missing components are set to 0.
+template<class T>
+void encode_attribute(const vertex_element& e, GLsizei stride, const T* src, GLint src_size, size_t count, unsigned char* dest)
+{
+    switch (e.type) {
+    case GL_FLOAT: encode_components<GLfloat>(e, stride, src, src_size, count, dest); break;
+    case GL_BYTE: encode_components<GLbyte>(e, stride, src, src_size, count, dest); break;
+    case GL_UNSIGNED_BYTE: encode_components<GLubyte>(e, stride, src, src_size, count, dest); break;
+    case GL_SHORT: encode_components<GLshort>(e, stride, src, src_size, count, dest); break;
+    case GL_UNSIGNED_SHORT: encode_components<GLushort>(e, stride, src, src_size, count, dest); break;
+    case GL_INT: encode_components<GLint>(e, stride, src, src_size, count, dest); break;
+    case GL_UNSIGNED_INT: encode_components<GLuint>(e, stride, src, src_size, count, dest); break;
+    case GL_HALF_FLOAT: encode_half(e, stride, src, src_size, count, dest); break;
+    case GL_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_2_10_10_10_REV: encode_2_10_10_10(e, stride, src, src_size, count, dest); break;
+    }
+}
+
 template<class T>
 struct buffer_object_builder {
 
     inline buffer_object_builder(std::vector<T> data)
-        : _data(data)
+        : _data(std::move(data))
     {}
 
     inline void* get_data()
@@ -127,12 +659,12 @@ struct buffer_object_builder {
         return _data.size();
     }
 
-    GLuint build()
+    GLuint build(GLenum target = GL_ARRAY_BUFFER)
     {
         GLuint id;
         glGenBuffers(1, &id);
-        glBindBuffer(GL_ARRAY_BUFFER, id);
-        glBufferData(GL_ARRAY_BUFFER, _data.size() * sizeof(T), &_data[0], GL_STATIC_DRAW);
+        gl_state::current().bind_buffer(target, id);
+        glBufferData(target, _data.size() * sizeof(T), &_data[0], GL_STATIC_DRAW);
         return id;
     }
 
@@ -140,102 +672,831 @@ private:
     std::vector<T> _data;
 };
 
+// Creates a buffer of size bytes filled in place by write(void* dest)
+// through glMapBufferRange, sparing the copy of a staging array.
+template<class F>
+GLuint build_mapped_buffer(GLenum target, GLsizeiptr size, F write)
+{
+    GLuint id;
+    glGenBuffers(1, &id);
+    gl_state::current().bind_buffer(target, id);
+    glBufferData(target, size, nullptr, GL_STATIC_DRAW);
+    while (size > 0) {
+        void* dest = glMapBufferRange(target, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (dest == nullptr) {
+            std::vector<unsigned char> staging(size);
+            write(static_cast<void*>(staging.data()));
+            glBufferSubData(target, 0, size, staging.data());
+            break;
+        }
+        write(dest);
+        // the contents are lost when unmapping fails, e.g. on a display mode change
+        if (glUnmapBuffer(target) == GL_TRUE) {
+            break;
+        }
+    }
+    return id;
+}
+
+// appends nx * ny unit quads in the z = 0 plane, from (0, 0) to (nx, ny)
+template <class T>
+void append_grid_data(std::vector<T>& data, int nx, int ny)
+{
+    data.reserve(data.size() + (size_t)nx * ny * 12);
+    for (int y = 0; y < ny; y++) {
+        for (int x = 0; x < nx; x++) {
+            T quad[12] = {
+                (T)x, (T)y, (T)0,
+                (T)(x + 1), (T)y, (T)0,
+                (T)(x + 1), (T)(y + 1), (T)0,
+                (T)x, (T)(y + 1), (T)0
+            };
+            data.insert(data.end(), quad, quad + 12);
+        }
+    }
+}
+
+// the buffers of a geometry in memory, cf geometry_builder::build_data
+struct geometry_data {
+    vertex_format format;
+    std::vector<unsigned char> vertices;
+    std::vector<unsigned char> indices; // empty when not indexed
+    GLenum index_type; // GL_NONE when not indexed
+    GLenum primitive_type;
+    GLint dimensions;
+    GLsizei count;
+    bool primitive_restart;
+    matrix44f position_transform;
+    bounds model_bounds;
+};
+
+enum class normal_generation {
+    none,
+    flat, // the normal of the face, vertices of different faces are not welded
+    smooth // the faces around a position weighted by their angle at that vertex
+};
+
 template<class T>
 struct geometry_builder {
 
     geometry_builder(GLint dim, GLenum primitive_type)
-    : _dim(dim), primitive_type(primitive_type)
+    : _dim(dim), primitive_type(primitive_type), _indexed(true), _optimized(false), _quantized(false), _strips(false),
+      _normal_generation(normal_generation::none), _tex_coords_dim(0),
+      _statistics{ { 0.0f, 0.0f }, { 0.0f, 0.0f } }
+    {
+    }
+
+    // builders own large arrays, they can be moved but not copied
+    geometry_builder(geometry_builder<T>&&) = default;
+    geometry_builder<T>& operator=(geometry_builder<T>&&) = default;
+
+    // reserves the storage of vertex_count vertices
+    geometry_builder<T>& reserve(size_t vertex_count)
+    {
+        _data.reserve(vertex_count * _dim);
+        return *this;
+    }
+
+    // one normal of 3 components per vertex
+    geometry_builder<T>& set_normals(std::vector<T> normals)
+    {
+        _normals = std::move(normals);
+        return *this;
+    }
+
+    // Generates the normals of 3D triangles or quads at build time,
+    // in place of the ones given to set_normals.
+    geometry_builder<T>& set_normal_generation(normal_generation generation)
+    {
+        _normal_generation = generation;
+        return *this;
+    }
+
+    // One normal per vertex, computed in parallel chunks of faces and vertices.
+    // Flat normals need a face per vertex, hence vertices which are not indexed.
+    std::vector<T> generate_normals(normal_generation generation) const
+    {
+        const T* data = group_data();
+        size_t count = vertex_count();
+        size_t n = primitive_type == GL_QUADS ? 4 : primitive_type == GL_TRIANGLES ? 3 : 0;
+        bool indexed = !_indices.empty();
+        if (generation == normal_generation::none || _dim != 3 || n == 0
+            || (indexed && generation == normal_generation::flat)) {
+            return std::vector<T>();
+        }
+        size_t corner_count = indexed ? _indices.size() : count;
+        size_t face_count = corner_count / n;
+        // the vertex of each corner of the faces
+        auto vertex = [&](size_t corner) { return indexed ? static_cast<size_t>(_indices[corner]) : corner; };
+        // the contribution of each face to each of its vertices
+        std::vector<T> corners(corner_count * 3, (T)0);
+        parallel_for(0, face_count, normal_grain, [&](size_t begin, size_t end) {
+            for (size_t f = begin; f < end; f++) {
+                vector3<T> p[4];
+                for (size_t k = 0; k < n; k++) {
+                    p[k] = vector3<T>(&data[vertex(f * n + k) * 3]);
+                }
+                vector3<T> normal = n == 3
+                    ? cross_product(p[1] - p[0], p[2] - p[0])
+                    : cross_product(p[2] - p[0], p[3] - p[1]);
+                T norm = length(normal);
+                if (norm == (T)0) {
+                    continue;
+                }
+                normal = normal / norm;
+                for (size_t k = 0; k < n; k++) {
+                    T weight = (T)1;
+                    if (generation == normal_generation::smooth) {
+                        vector3<T> e1 = p[(k + 1) % n] - p[k];
+                        vector3<T> e2 = p[(k + n - 1) % n] - p[k];
+                        T d = length(e1) * length(e2);
+                        weight = d > (T)0 ? std::acos(std::min((T)1, std::max((T)-1, dot_product(e1, e2) / d))) : (T)0;
+                    }
+                    (normal * weight).append_to(&corners[(f * n + k) * 3]);
+                }
+            }
+        });
+        if (generation == normal_generation::flat) {
+            return corners;
+        }
+        // sums the corners sharing a position, grouped with a counting sort,
+        // the positions welded by their bits with -0 written as +0
+        std::vector<T> positions(data, data + count * 3);
+        for (T& c : positions) {
+            c = c == (T)0 ? (T)0 : c;
+        }
+        std::vector<GLuint> remap;
+        std::vector<GLuint> first;
+        weld_vertices(positions.data(), count, 3 * sizeof(T), remap, first);
+        std::vector<size_t> offsets(first.size() + 1, 0);
+        for (size_t c = 0; c < corner_count; c++) {
+            offsets[remap[vertex(c)] + 1]++;
+        }
+        for (size_t i = 0; i < first.size(); i++) {
+            offsets[i + 1] += offsets[i];
+        }
+        std::vector<GLuint> grouped(corner_count);
+        {
+            std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t c = 0; c < corner_count; c++) {
+                grouped[fill[remap[vertex(c)]]++] = static_cast<GLuint>(c);
+            }
+        }
+        std::vector<T> normals(count * 3, (T)0);
+        parallel_for(0, first.size(), normal_grain, [&](size_t begin, size_t end) {
+            for (size_t u = begin; u < end; u++) {
+                vector3<T> sum;
+                for (size_t g = offsets[u]; g < offsets[u + 1]; g++) {
+                    sum = sum + vector3<T>(&corners[grouped[g] * 3]);
+                }
+                T norm = length(sum);
+                if (norm > (T)0) {
+                    sum = sum / norm;
+                }
+                for (size_t g = offsets[u]; g < offsets[u + 1]; g++) {
+                    sum.append_to(&normals[vertex(grouped[g]) * 3]);
+                }
+            }
+        });
+        return normals;
+    }
+
+    // one texture coordinate of dim components per vertex
+    geometry_builder<T>& set_tex_coords(std::vector<T> tex_coords, GLint dim)
+    {
+        _tex_coords = std::move(tex_coords);
+        _tex_coords_dim = dim;
+        return *this;
+    }
+
+    // When indexed (the default), identical vertices are welded
+    // and the geometry is drawn with an index buffer.
+    geometry_builder<T>& set_indexed(bool indexed)
+    {
+        _indexed = indexed;
+        return *this;
+    }
+
+    // Draws the vertices of the current group through indices, e.g. those of an
+    // imported mesh, instead of welding them. The geometry is then indexed.
+    geometry_builder<T>& set_indices(std::vector<GLuint> indices)
     {
-        _data.push(std::vector<T>());
+        _indices = std::move(indices);
+        _indexed = true;
+        return *this;
+    }
+
+    // When optimized, indexed triangle lists are reordered for the vertex cache,
+    // overdraw and vertex fetch, see mesh_optimizer.hpp.
+    geometry_builder<T>& set_optimized(bool optimized)
+    {
+        _optimized = optimized;
+        return *this;
+    }
+
+    // When set, indexed triangles are drawn as triangle strips separated
+    // by primitive restart indices instead of a triangle list.
+    geometry_builder<T>& set_strips(bool strips)
+    {
+        _strips = strips;
+        return *this;
+    }
+
+    // When quantized, the default format stores the positions as snorm16
+    // relative to the bounds of the mesh, the tex coords as unorm16 (hence
+    // clamped to [0, 1]) and the normals as 10 bits snorm.
+    geometry_builder<T>& set_quantized(bool quantized)
+    {
+        _quantized = quantized;
+        return *this;
+    }
+
+    // the vertex cache statistics before and after the last optimized build
+    struct statistics {
+        vertex_cache_statistics before;
+        vertex_cache_statistics after;
+    };
+
+    inline const statistics& get_statistics() const
+    {
+        return _statistics;
+    }
+
+    // the positions followed by the tex coords and normals when present,
+    // as floats unless quantized
+    vertex_format default_format() const
+    {
+        vertex_format format;
+        if (_quantized) {
+            format.add(vertex_attribute::POSITION, _dim, GL_SHORT, GL_TRUE);
+        } else {
+            format.add(vertex_attribute::POSITION, _dim);
+        }
+        if (!_tex_coords.empty()) {
+            if (_quantized) {
+                format.add(vertex_attribute::TEXCOORD, _tex_coords_dim, GL_UNSIGNED_SHORT, GL_TRUE);
+            } else {
+                format.add(vertex_attribute::TEXCOORD, _tex_coords_dim);
+            }
+        }
+        if (!_normals.empty() || _normal_generation != normal_generation::none) {
+            if (_quantized) {
+                format.add(vertex_attribute::NORMAL, 4, GL_INT_2_10_10_10_REV, GL_TRUE);
+            } else {
+                format.add(vertex_attribute::NORMAL, 3);
+            }
+        }
+        return format;
+    }
+
+    // Positions stored as half floats or normalized integers are stored relative
+    // to the bounds of the mesh, in [-1, 1]. Returns the transform back to the
+    // model coordinates, cf geometry::set_position_transform.
+    matrix44f position_transform(const vertex_format& format) const
+    {
+        float center[3];
+        float extent[3];
+        if (!position_bounds(format, center, extent)) {
+            return identity<float>();
+        }
+        return multm(translation(center[0], center[1], center[2]), scaling(extent[0], extent[1], extent[2]));
+    }
+
+    inline size_t vertex_count() const
+    {
+        return group_size() / _dim;
+    }
+
+    // the vertices interleaved according to format, with the normals generated if any
+    std::vector<unsigned char> vertices(const vertex_format& format) const
+    {
+        std::vector<T> generated;
+        return vertices(format, written_normals(generated));
+    }
+
+    // writes the vertices interleaved according to format at bytes
+    void write_vertices(const vertex_format& format, unsigned char* bytes) const
+    {
+        std::vector<T> generated;
+        write_vertices(format, written_normals(generated), bytes);
     }
 
     std::unique_ptr<geometry<T>> build()
     {
-        auto b = buffer_object_builder<T> { _data.top() };
-        auto g = std::make_unique<geometry<T>>(_data.top().size() / _dim, _dim, primitive_type);
-        g->set_vertex_positions(b.build());
+        return build(default_format());
+    }
+
+    template<class Layout>
+    std::unique_ptr<geometry<T>> build()
+    {
+        return build(Layout::format());
+    }
+
+    // builds a geometry with a single buffer of vertices interleaved according to format
+    std::unique_ptr<geometry<T>> build(const vertex_format& format)
+    {
+        std::vector<T> generated;
+        const std::vector<T>& normals = written_normals(generated);
+        size_t count = vertex_count();
+        if (!_indexed && primitive_type != GL_QUADS) {
+            // nothing to weld or reorder, the vertices are encoded straight into the buffer
+            GLuint id = build_mapped_buffer(GL_ARRAY_BUFFER, count * format.stride, [&](void* dest) {
+                write_vertices(format, normals, static_cast<unsigned char*>(dest));
+            });
+            auto g = std::make_unique<geometry<T>>(static_cast<GLsizei>(count), _dim, primitive_type);
+            g->set_vertex_buffer(id, format);
+            g->set_position_transform(position_transform(format));
+            g->set_bounds(compute_bounds());
+            return g;
+        }
+        std::vector<unsigned char> bytes;
+        std::vector<GLuint> indices;
+        GLenum type = prepare(format, normals, bytes, indices);
+        count = _indexed ? indices.size() : bytes.size() / format.stride;
+        auto g = std::make_unique<geometry<T>>(static_cast<GLsizei>(count), _dim, type);
+        g->set_vertex_buffer(bytes.data(), static_cast<long>(bytes.size()), format);
+        g->set_position_transform(position_transform(format));
+        g->set_bounds(compute_bounds());
+        if (!_indexed) {
+            return g;
+        }
+        g->set_primitive_restart(uses_strips());
+        GLenum index_type = index_type_of(bytes.size() / format.stride);
+        GLuint id = build_mapped_buffer(GL_ELEMENT_ARRAY_BUFFER, indices.size() * component_bytes(index_type), [&](void* dest) {
+            write_indices(indices, index_type, dest);
+        });
+        g->set_indices(id, index_type);
         return g;
     }
 
+    // The buffers build(format) would create, kept in memory, e.g. to be saved.
+    geometry_data build_data(const vertex_format& format)
+    {
+        std::vector<T> generated;
+        const std::vector<T>& normals = written_normals(generated);
+        geometry_data d;
+        std::vector<GLuint> indices;
+        d.format = format;
+        d.dimensions = _dim;
+        d.primitive_type = prepare(format, normals, d.vertices, indices);
+        d.primitive_restart = _indexed && uses_strips();
+        d.position_transform = position_transform(format);
+        d.model_bounds = compute_bounds();
+        if (_indexed) {
+            d.index_type = index_type_of(d.vertices.size() / format.stride);
+            d.indices.resize(indices.size() * component_bytes(d.index_type));
+            write_indices(indices, d.index_type, d.indices.data());
+            d.count = static_cast<GLsizei>(indices.size());
+        } else {
+            d.index_type = GL_NONE;
+            d.count = static_cast<GLsizei>(d.vertices.size() / format.stride);
+        }
+        return d;
+    }
+
+    // A builder of the vertices of the current group drawn through about ratio
+    // of its triangles, cf simplify. Vertices are welded with their normals and
+    // tex coords, seams are then borders and stay in place. Only 3D triangles
+    // and quads are simplified, other primitives are copied.
+    geometry_builder<T> simplified(float ratio)
+    {
+        std::vector<T> generated;
+        const std::vector<T>& normals = written_normals(generated);
+        geometry_builder<T> b(_dim, primitive_type);
+        b._indexed = _indexed;
+        b._optimized = _optimized;
+        b._quantized = _quantized;
+        b._strips = _strips;
+        b._tex_coords_dim = _tex_coords_dim;
+        const T* data = group_data();
+        size_t count = vertex_count();
+        bool has_normals = normals.size() == count * 3;
+        bool has_tex_coords = !_tex_coords.empty() && _tex_coords.size() == count * _tex_coords_dim;
+        if (_dim != 3 || (primitive_type != GL_TRIANGLES && primitive_type != GL_QUADS)) {
+            b._data.assign(data, data + group_size());
+            b._normals = normals;
+            b._tex_coords = _tex_coords;
+            b._indices = _indices;
+            return b;
+        }
+        vertex_format format;
+        format.add(vertex_attribute::POSITION, 3);
+        if (has_tex_coords) {
+            format.add(vertex_attribute::TEXCOORD, _tex_coords_dim);
+        }
+        if (has_normals) {
+            format.add(vertex_attribute::NORMAL, 3);
+        }
+        std::vector<unsigned char> bytes = vertices(format, normals);
+        std::vector<GLuint> indices;
+        std::vector<GLuint> first;
+        if (!_indices.empty()) {
+            indices = _indices;
+            first.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                first[i] = static_cast<GLuint>(i);
+            }
+        } else {
+            weld_vertices(bytes.data(), count, format.stride, indices, first);
+        }
+        if (primitive_type == GL_QUADS) {
+            quads_to_triangles(indices);
+        }
+        std::vector<float> positions(first.size() * 3);
+        for (size_t i = 0; i < first.size(); i++) {
+            memcpy(&positions[i * 3], &bytes[first[i] * format.stride], 3 * sizeof(float));
+        }
+        size_t target = static_cast<size_t>(indices.size() / 3 * std::max(0.0f, ratio)) * 3;
+        simplify(indices, positions, first.size(), target);
+        // the vertices still referenced come first, in order
+        std::vector<GLuint> order;
+        optimize_vertex_fetch(indices, first.size(), order);
+        size_t kept = indices.empty() ? 0 : *std::max_element(indices.begin(), indices.end()) + 1;
+        b.primitive_type = GL_TRIANGLES;
+        b._data.resize(kept * 3);
+        b._normals.resize(has_normals ? kept * 3 : 0);
+        b._tex_coords.resize(has_tex_coords ? kept * _tex_coords_dim : 0);
+        for (size_t i = 0; i < kept; i++) {
+            size_t v = first[order[i]];
+            std::copy(data + v * 3, data + v * 3 + 3, b._data.data() + i * 3);
+            if (has_normals) {
+                std::copy(normals.data() + v * 3, normals.data() + v * 3 + 3, b._normals.data() + i * 3);
+            }
+            if (has_tex_coords) {
+                size_t n = _tex_coords_dim;
+                std::copy(_tex_coords.data() + v * n, _tex_coords.data() + (v + 1) * n, b._tex_coords.data() + i * n);
+            }
+        }
+        b.set_indices(std::move(indices));
+        return b;
+    }
+
+    // the bounds of the vertices of the current group, z is 0 in 2D
+    bounds compute_bounds() const
+    {
+        const T* data = group_data();
+        size_t count = vertex_count();
+        if (std::is_same<T, float>::value && _dim == 3) {
+            return bounds_of(reinterpret_cast<const float*>(data), count);
+        }
+        std::vector<float> points(count * 3, 0.0f);
+        for (size_t i = 0; i < count; i++) {
+            for (GLint c = 0; c < std::min(_dim, 3); c++) {
+                points[i * 3 + c] = static_cast<float>(data[i * _dim + c]);
+            }
+        }
+        return bounds_of(points.data(), count);
+    }
+
+    // The positions and the triangles of the current group, quad i split in
+    // the triangles 2i and 2i + 1. Empty unless 3D triangles or quads.
+    void triangles(std::vector<float>& positions, std::vector<GLuint>& indices) const
+    {
+        positions.clear();
+        indices.clear();
+        if (_dim != 3 || (primitive_type != GL_TRIANGLES && primitive_type != GL_QUADS)) {
+            return;
+        }
+        const T* data = group_data();
+        positions.assign(data, data + group_size());
+        if (!_indices.empty()) {
+            indices = _indices;
+        } else {
+            indices.resize(vertex_count());
+            for (size_t i = 0; i < indices.size(); i++) {
+                indices[i] = static_cast<GLuint>(i);
+            }
+        }
+        if (primitive_type == GL_QUADS) {
+            quads_to_triangles(indices);
+        }
+    }
+
+    // the vertices of the current group
     std::vector<T> data() const
     {
-        return std::vector<T>(_data.top());
+        return std::vector<T>(group_data(), group_data() + group_size());
     }
 
     geometry_builder<T>& append(const vector3<T>& v)
     {
-        _data.top().push_back(v.x());
-        _data.top().push_back(v.y());
-        _data.top().push_back(v.z());
+        _data.push_back(v.x());
+        _data.push_back(v.y());
+        _data.push_back(v.z());
         return *this;
     }
 
     geometry_builder<T>& append(const triangle<T>& tr)
     {
-        tr.append_to(_data.top());
+        tr.append_to(_data);
         return *this;
     }
 
     geometry_builder<T>& append(const std::vector<T>& v)
     {
-        _data.top().insert(_data.top().end(), v.begin(), v.end());
+        _data.insert(_data.end(), v.begin(), v.end());
         return *this;
     }
 
+    // the quads of make_grid_data, written in place
+    geometry_builder<T>& append_grid(int nx, int ny)
+    {
+        append_grid_data(_data, nx, ny);
+        return *this;
+    }
+
+    // transforms the vertices of the current group
     geometry_builder<T>& transform(const matrix44f& tr)
     {
-        for (typename std::vector<T>::size_type i = 0; i < _data.top().size(); i += _dim) {
-            vector3f v3 = tr * vector3f(&_data.top()[i]);
-            v3.append_to(&_data.top()[i]);
+        T* top = _data.data() + group_begin();
+        size_t size = group_size();
+        if (_dim == 3) {
+            parallel_for(0, size / 3, transform_grain, [&](size_t begin, size_t end) {
+                transform_points(tr, top + begin * 3, end - begin);
+            });
+        } else {
+            for (size_t i = 0; i < size; i += _dim) {
+                vector3f v3 = tr * vector3f(top[i], top[i + 1], (T)0);
+                top[i] = v3.x();
+                top[i + 1] = v3.y();
+            }
         }
         return *this;
     }
 
+    // Starts a group of vertices, transform only applies to the vertices
+    // of the current group. Groups are ranges of a single array, ending
+    // one moves nothing.
     geometry_builder<T>& begin()
     {
-        _data.push(std::vector<T>());
+        _groups.push_back(_data.size());
         return *this;
     }
 
     geometry_builder<T>& end()
     {
-        std::vector<T> oldtop = std::move(_data.top());
-        _data.pop();
-        _data.top().insert(_data.top().end(), oldtop.begin(), oldtop.end());
+        _groups.pop_back();
         return *this;
     }
 
 private:
-    std::stack<std::vector<T>> _data;
+    geometry_builder(const geometry_builder<T>&);
+
+    // one value per vertex, zeros when values is empty
+    static void write_attribute(GLsizei stride, const vertex_element& e, const std::vector<T>& values, GLint size,
+        size_t count, unsigned char* bytes)
+    {
+        if (values.empty()) {
+            for (size_t i = 0; i < count; i++) {
+                memset(bytes + i * stride + e.offset, 0, attribute_bytes(e.type, e.size));
+            }
+            return;
+        }
+        // otherwise the vertices would be read past the values or mixed up with others
+        assert(values.size() == count * size);
+        encode_attribute(e, stride, values.data(), size, std::min(count, values.size() / size), bytes);
+    }
+
+    // Those generated, in generated, when a generation is set, otherwise the
+    // ones set: the builder keeps its normals whatever it builds.
+    const std::vector<T>& written_normals(std::vector<T>& generated) const
+    {
+        if (_normal_generation == normal_generation::none) {
+            return _normals;
+        }
+        generated = generate_normals(_normal_generation);
+        return generated;
+    }
+
+    std::vector<unsigned char> vertices(const vertex_format& format, const std::vector<T>& normals) const
+    {
+        std::vector<unsigned char> bytes(vertex_count() * format.stride);
+        write_vertices(format, normals, bytes.data());
+        return bytes;
+    }
+
+    void write_vertices(const vertex_format& format, const std::vector<T>& normals, unsigned char* bytes) const
+    {
+        size_t count = vertex_count();
+        for (auto& e : format.elements) {
+            switch (e.attribute) {
+            case vertex_attribute::POSITION:
+                encode_positions(format, e, count, bytes);
+                break;
+            case vertex_attribute::TEXCOORD:
+                write_attribute(format.stride, e, _tex_coords, _tex_coords_dim, count, bytes);
+                break;
+            case vertex_attribute::NORMAL:
+                write_attribute(format.stride, e, normals, 3, count, bytes);
+                break;
+            }
+        }
+    }
+
+    inline size_t group_begin() const
+    {
+        return _groups.empty() ? 0 : _groups.back();
+    }
+
+    inline const T* group_data() const
+    {
+        return _data.data() + group_begin();
+    }
+
+    inline size_t group_size() const
+    {
+        return _data.size() - group_begin();
+    }
+
+    inline bool uses_strips() const
+    {
+        return _strips && (primitive_type == GL_TRIANGLES || primitive_type == GL_QUADS);
+    }
+
+    // 0xffff is the restart index of short indices
+    inline GLenum index_type_of(size_t vertex_count) const
+    {
+        return vertex_count <= (uses_strips() ? 65535u : 65536u) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
+
+    static void write_indices(const std::vector<GLuint>& indices, GLenum index_type, void* dest)
+    {
+        if (index_type == GL_UNSIGNED_INT) {
+            memcpy(dest, indices.data(), indices.size() * sizeof(GLuint));
+            return;
+        }
+        GLushort* out = static_cast<GLushort*>(dest);
+        for (size_t i = 0; i < indices.size(); i++) {
+            out[i] = static_cast<GLushort>(indices[i]);
+        }
+    }
+
+    // Encodes the vertices into bytes, then when indexed welds them, converts
+    // quads, optimizes and stripifies the indices. Returns the primitive type.
+    GLenum prepare(const vertex_format& format, const std::vector<T>& normals, std::vector<unsigned char>& bytes,
+        std::vector<GLuint>& indices)
+    {
+        size_t count = vertex_count();
+        // quads are removed from core profiles, they are drawn as pairs of triangles
+        GLenum type = primitive_type == GL_QUADS ? GL_TRIANGLES : primitive_type;
+        bytes = vertices(format, normals);
+        indices.clear();
+        if (!_indexed) {
+            if (primitive_type == GL_QUADS) {
+                std::vector<GLuint> quads(count);
+                for (size_t i = 0; i < count; i++) {
+                    quads[i] = static_cast<GLuint>(i);
+                }
+                quads_to_triangles(quads);
+                std::vector<unsigned char> triangles(quads.size() * format.stride);
+                for (size_t i = 0; i < quads.size(); i++) {
+                    memcpy(&triangles[i * format.stride], &bytes[quads[i] * format.stride], format.stride);
+                }
+                bytes.swap(triangles);
+            }
+            return type;
+        }
+        std::vector<GLuint> first;
+        if (!_indices.empty()) {
+            indices = _indices;
+            first.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                first[i] = static_cast<GLuint>(i);
+            }
+        } else {
+            weld_vertices(bytes.data(), count, format.stride, indices, first);
+            // first is increasing and first[i] >= i, the distinct vertices can be packed in place
+            for (size_t i = 0; i < first.size(); i++) {
+                memmove(&bytes[i * format.stride], &bytes[first[i] * format.stride], format.stride);
+            }
+            bytes.resize(first.size() * format.stride);
+        }
+        if (primitive_type == GL_QUADS) {
+            quads_to_triangles(indices);
+        }
+        if (_optimized && type == GL_TRIANGLES) {
+            optimize(indices, first, bytes, format.stride);
+        }
+        if (uses_strips()) {
+            std::vector<GLuint> strip;
+            stripify(indices, ~0u, strip);
+            indices.swap(strip);
+            type = GL_TRIANGLE_STRIP;
+        }
+        return type;
+    }
+
+    // each quad a, b, c, d becomes the triangles a, b, c and a, c, d
+    static void quads_to_triangles(std::vector<GLuint>& indices)
+    {
+        std::vector<GLuint> triangles;
+        triangles.reserve(indices.size() / 4 * 6);
+        for (size_t i = 0; i + 3 < indices.size(); i += 4) {
+            const GLuint* q = &indices[i];
+            triangles.insert(triangles.end(), { q[0], q[1], q[2], q[0], q[2], q[3] });
+        }
+        indices.swap(triangles);
+    }
+
+    // center and half size of the bounds along each axis, false when
+    // the positions of format are stored as is
+    bool position_bounds(const vertex_format& format, float center[3], float extent[3]) const
+    {
+        const vertex_element* e = format.find(vertex_attribute::POSITION);
+        if (e == nullptr || !(e->type == GL_HALF_FLOAT || (e->normalized && e->type != GL_FLOAT))) {
+            return false;
+        }
+        const T* data = group_data();
+        size_t size = group_size();
+        for (int c = 0; c < 3; c++) {
+            float lo = std::numeric_limits<float>::max();
+            float hi = std::numeric_limits<float>::lowest();
+            for (size_t i = c; c < _dim && i < size; i += _dim) {
+                lo = std::min(lo, (float)data[i]);
+                hi = std::max(hi, (float)data[i]);
+            }
+            center[c] = lo <= hi ? (lo + hi) / 2 : 0.0f;
+            extent[c] = lo < hi ? (hi - lo) / 2 : 1.0f;
+        }
+        return true;
+    }
+
+    void encode_positions(const vertex_format& format, const vertex_element& e, size_t count, unsigned char* dest) const
+    {
+        float center[3];
+        float extent[3];
+        if (!position_bounds(format, center, extent)) {
+            encode_attribute(e, format.stride, group_data(), _dim, count, dest);
+            return;
+        }
+        std::vector<float> normalized(group_data(), group_data() + group_size());
+        for (size_t i = 0; i < normalized.size(); i++) {
+            size_t c = i % _dim;
+            if (c < 3) {
+                normalized[i] = (normalized[i] - center[c]) / extent[c];
+            }
+        }
+        encode_attribute(e, format.stride, normalized.data(), _dim, count, dest);
+    }
+
+    void optimize(std::vector<GLuint>& indices, const std::vector<GLuint>& first, std::vector<unsigned char>& bytes, size_t stride)
+    {
+        size_t count = first.size();
+        std::vector<float> positions(count * 3, 0.0f);
+        const T* data = group_data();
+        for (size_t i = 0; i < count; i++) {
+            for (GLint c = 0; c < std::min(_dim, 3); c++) {
+                positions[i * 3 + c] = static_cast<float>(data[first[i] * _dim + c]);
+            }
+        }
+        _statistics.before = analyze_vertex_cache(indices, count);
+        optimize_vertex_cache(indices, count);
+        optimize_overdraw(indices, positions, count);
+        std::vector<GLuint> order;
+        optimize_vertex_fetch(indices, count, order);
+        std::vector<unsigned char> reordered(bytes.size());
+        for (size_t i = 0; i < count; i++) {
+            memcpy(&reordered[i * stride], &bytes[order[i] * stride], stride);
+        }
+        bytes.swap(reordered);
+        _statistics.after = analyze_vertex_cache(indices, count);
+    }
+
+    // number of vertices below which a transform is not worth splitting across threads
+    static const size_t transform_grain = 65536;
+    // faces or vertices per chunk when generating normals
+    static const size_t normal_grain = 16384;
+    std::vector<T> _data;
+    std::vector<size_t> _groups; // where the groups opened by begin start in _data
     GLint _dim;
     GLenum primitive_type;
+    bool _indexed;
+    bool _optimized;
+    bool _quantized;
+    bool _strips;
+    normal_generation _normal_generation;
+    std::vector<GLuint> _indices;
+    std::vector<T> _normals;
+    std::vector<T> _tex_coords;
+    GLint _tex_coords_dim;
+    statistics _statistics;
 };
 
 template <class T>
 std::vector<T> make_grid_data(int nx, int ny)
 {
     std::vector<T> data;
-    for (int y = 0; y < ny; y++) {
-        for (int x = 0; x < nx; x++) {
-            auto v = std::vector<T> {
-                (T)x, (T)y, (T)0,
-                    (T)(x + 1), (T)y, (T)0,
-                    (T)(x + 1), (T)(y + 1), (T)0,
-                    (T)x, (T)(y + 1), (T)0
-            };
-            data.insert(data.end(), v.begin(), v.end());
-        }
-    }
+    append_grid_data(data, nx, ny);
     return data;
 }
 
-
 template <class T>
 geometry_builder<T> make_grid(int nx, int ny)
 {
-    auto geomb = geometry_builder<T>{3};
+    auto geomb = geometry_builder<T>{3, GL_QUADS};
+    geomb.reserve((size_t)nx * ny * 4);
     geomb.begin();
-    geomb.begin().append(make_grid_data<T>(nx, ny).data()).end();
+    geomb.begin().append_grid(nx, ny).end();
     geomb.transform(translation((T)-nx / (T)2, (T)-ny / (T)2, (T)0));
     geomb.end();
     return geomb;
@@ -245,13 +1506,15 @@ template <class T>
 geometry_builder<T> make_box(int nx, int ny, int nz)
 {
     auto geomb = geometry_builder<T>{3, GL_QUADS};
+    geomb.reserve(((size_t)nx * ny + (size_t)nz * ny + (size_t)nx * nz) * 2 * 4);
     geomb.begin();
-    geomb.begin().append(make_grid_data<T>(nx, ny)).end();
-    geomb.begin().append(make_grid_data<T>(nz, ny)).transform(rotation(90.0f, 0.0f, 1.0f, 0.0f)).end();
-    geomb.begin().append(make_grid_data<T>(nz, ny)).transform(rotation(90.0f, 0.0f, 1.0f, 0.0f)).transform(translation((T)nx, 0.0f, 0.0f)).end();
-    geomb.begin().append(make_grid_data<T>(nx, ny)).transform(translation(0.0f, 0.0f, (T)-nz)).end();
-    geomb.begin().append(make_grid_data<T>(nx, nz)).transform(rotation(-90.0f, 1.0f, 0.0f, 0.0f)).end();
-    geomb.begin().append(make_grid_data<T>(nx, nz)).transform(rotation(-90.0f, 1.0f, 0.0f, 0.0f)).transform(translation(0.0f, (T)ny, 0.0f)).end();
+    geomb.begin().append_grid(nx, ny).end();
+    // the faces are wound counterclockwise seen from outside, the opposite ones mirrored
+    geomb.begin().append_grid(nz, ny).transform(rotation(-90.0f, 0.0f, 1.0f, 0.0f)).transform(translation(0.0f, 0.0f, (T)-nz)).end();
+    geomb.begin().append_grid(nz, ny).transform(rotation(90.0f, 0.0f, 1.0f, 0.0f)).transform(translation((T)nx, 0.0f, 0.0f)).end();
+    geomb.begin().append_grid(nx, ny).transform(rotation(180.0f, 0.0f, 1.0f, 0.0f)).transform(translation((T)nx, 0.0f, (T)-nz)).end();
+    geomb.begin().append_grid(nx, nz).transform(rotation(90.0f, 1.0f, 0.0f, 0.0f)).transform(translation(0.0f, 0.0f, (T)-nz)).end();
+    geomb.begin().append_grid(nx, nz).transform(rotation(-90.0f, 1.0f, 0.0f, 0.0f)).transform(translation(0.0f, (T)ny, 0.0f)).end();
     geomb.transform(translation((T)-nx / (T)2, (T)-ny / (T)2, (T)nz / (T)2));
     geomb.end();
     return geomb;
@@ -268,6 +1531,7 @@ geometry_builder<T> make_uv_sphere(int nlong, int nlat)
         return vector3<T>(x, y, z);
     };
     auto geomb = geometry_builder<T>{3, GL_QUADS};
+    geomb.reserve((size_t)nlong * nlat * 4);
     geomb.begin();
     const T pi = static_cast<T>(3.14159265359);
     T step_long = 2 * pi / nlong;
@@ -290,7 +1554,8 @@ template<class T>
 geometry_builder<T> make_octahedron_sphere(int n)
 {
     auto geomb = geometry_builder<T>{3, GL_TRIANGLES};
-    std::function<void(int, triangle<T>&)> refine = [&](int depth, triangle<T>& tr)
+    geomb.reserve((size_t)8 * 3 << (2 * n));
+    std::function<void(int, const triangle<T>&)> refine = [&](int depth, const triangle<T>& tr)
     {
         if (depth == n)
             geomb.append(tr);
@@ -313,7 +1578,7 @@ geometry_builder<T> make_octahedron_sphere(int n)
     refine(0, triangle<T>(v1, v2, v3));
     refine(0, triangle<T>(v1, v3, v4));
     refine(0, triangle<T>(v1, v4, v5));
-    refine(0, triangle<T>(v1, v2, v5));
+    refine(0, triangle<T>(v1, v5, v2));
     refine(0, triangle<T>(v6, v3, v2));
     refine(0, triangle<T>(v6, v2, v5));
     refine(0, triangle<T>(v6, v5, v4));
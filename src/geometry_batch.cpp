@@ -0,0 +1,155 @@
+#include <cstring>
+
+#include "geometry_batch.hpp"
+
+using namespace yae;
+
+namespace {
+
+bool same_format(const vertex_format& a, const vertex_format& b)
+{
+    if (a.stride != b.stride || a.elements.size() != b.elements.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.elements.size(); i++) {
+        const vertex_element& e = a.elements[i];
+        const vertex_element& f = b.elements[i];
+        if (e.attribute != f.attribute || e.size != f.size || e.type != f.type || e.normalized != f.normalized
+            || e.offset != f.offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+const size_t geometry_batch::not_added = ~(size_t)0;
+
+geometry_batch::geometry_batch(const vertex_format& format)
+    : _format(format), _bounds_changed(true), _buffers_changed(false), _instances_changed(false),
+      _uploaded_draws(0)
+{
+}
+
+size_t geometry_batch::add(const geometry_data& data, const matrix44f& transform, const color4f& color)
+{
+    if (!same_format(data.format, _format) || data.primitive_type != GL_TRIANGLES || data.primitive_restart) {
+        return not_added;
+    }
+    draw_elements_command d;
+    d.count = static_cast<GLuint>(data.count);
+    d.instance_count = 1;
+    d.first_index = static_cast<GLuint>(_indices.size());
+    d.base_vertex = static_cast<GLint>(_vertices.size() / _format.stride);
+    _vertices.insert(_vertices.end(), data.vertices.begin(), data.vertices.end());
+    if (data.index_type == GL_UNSIGNED_INT) {
+        const GLuint* indices = reinterpret_cast<const GLuint*>(data.indices.data());
+        _indices.insert(_indices.end(), indices, indices + data.count);
+    } else if (data.index_type == GL_UNSIGNED_SHORT) {
+        const GLushort* indices = reinterpret_cast<const GLushort*>(data.indices.data());
+        _indices.insert(_indices.end(), indices, indices + data.count);
+    } else if (data.index_type == GL_UNSIGNED_BYTE) {
+        _indices.insert(_indices.end(), data.indices.begin(), data.indices.begin() + data.count);
+    } else {
+        for (GLsizei i = 0; i < data.count; i++) {
+            _indices.push_back(static_cast<GLuint>(i));
+        }
+    }
+    _buffers_changed = true;
+    return add_draw(d, data.position_transform, data.model_bounds, transform, color);
+}
+
+size_t geometry_batch::add_copy(size_t draw, const matrix44f& transform, const color4f& color)
+{
+    return add_draw(_draws[draw], _position_transforms[draw], _model_bounds[draw], transform, color);
+}
+
+size_t geometry_batch::add_draw(const draw_elements_command& d, const matrix44f& position_transform,
+    const bounds& model_bounds, const matrix44f& transform, const color4f& color)
+{
+    size_t draw = _draws.size();
+    _draws.push_back(d);
+    _draws.back().base_instance = static_cast<GLuint>(draw);
+    _position_transforms.push_back(position_transform);
+    _model_bounds.push_back(model_bounds);
+    _transforms.push_back(transform);
+    _colors.resize(_colors.size() + 4);
+    color.append_to(&_colors[draw * 4]);
+    _instances_changed = true;
+    _bounds_changed = true;
+    bounds_changed();
+    return draw;
+}
+
+void geometry_batch::set_transform(size_t draw, const matrix44f& transform)
+{
+    _transforms[draw] = transform;
+    _instances_changed = true;
+    _bounds_changed = true;
+    bounds_changed();
+}
+
+void geometry_batch::upload()
+{
+    if (_buffers_changed) {
+        // a new geometry rather than buffers replaced one by one, its vertex arrays go with the old one
+        const vertex_element* position = _format.find(vertex_attribute::POSITION);
+        _geom = std::make_shared<geometry<float>>(0, position ? position->size : 3, GL_TRIANGLES);
+        _geom->set_vertex_buffer(_vertices.data(), static_cast<long>(_vertices.size()), _format);
+        _geom->set_indices(_indices.data(), static_cast<long>(_indices.size() * sizeof(GLuint)), GL_UNSIGNED_INT);
+        _buffers_changed = false;
+        _uploaded_draws = 0;
+    }
+    bool resized = _uploaded_draws != _draws.size();
+    long size = static_cast<long>(_transforms.size() * sizeof(matrix44f));
+    if (resized) {
+        // The position transform of each geometry, e.g. of quantized positions, is kept
+        // apart from the transform the normals go through. It, the colors and the draws
+        // only change as draws are added.
+        vertex_format transform_format;
+        vertex_format position_format;
+        for (GLuint c = 0; c < 4; c++) {
+            transform_format.add(vertex_attribute::INSTANCE_TRANSFORM + c, 4);
+            position_format.add(vertex_attribute::INSTANCE_POSITION_TRANSFORM + c, 4);
+        }
+        transform_format.divisor = 1;
+        position_format.divisor = 1;
+        _geom->set_vertex_buffer(_transforms.data(), size, transform_format);
+        _geom->set_vertex_buffer(_position_transforms.data(), size, position_format);
+        vertex_format color_format;
+        color_format.add(vertex_attribute::INSTANCE_COLOR, 4);
+        color_format.divisor = 1;
+        _geom->set_vertex_buffer(_colors.data(), static_cast<long>(_colors.size() * sizeof(float)), color_format);
+        _geom->set_draws(_draws);
+        _uploaded_draws = _draws.size();
+    } else if (_instances_changed) {
+        gl_state::current().bind_buffer(GL_ARRAY_BUFFER, _geom->get_vertex_buffer(vertex_attribute::INSTANCE_TRANSFORM));
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, _transforms.data());
+    }
+    _instances_changed = false;
+}
+
+void geometry_batch::render(rendering_context& ctx)
+{
+    if (_draws.empty()) {
+        return;
+    }
+    upload();
+    ctx.draw(*_geom);
+}
+
+bounds geometry_batch::get_bounds() const
+{
+    if (_bounds_changed) {
+        _bounds.known = true;
+        _bounds.lo = vector3f(1.0f, 1.0f, 1.0f);
+        _bounds.hi = vector3f(-1.0f, -1.0f, -1.0f);
+        _bounds.radius = -1.0f;
+        for (size_t i = 0; i < _draws.size() && _bounds.known; i++) {
+            _bounds = merge_bounds(_bounds, transform_bounds(_transforms[i], _model_bounds[i]));
+        }
+        _bounds_changed = false;
+    }
+    return _bounds;
+}
@@ -0,0 +1,59 @@
+#ifndef _geometry_batch_hpp_
+#define _geometry_batch_hpp_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "geometry.hpp"
+#include "yae.hpp"
+
+namespace yae {
+
+// Static triangle geometries of one vertex format merged in an arena of
+// shared vertex and index buffers, all drawn by a single multi draw indirect
+// call. Draw i is instance i, reading its transform, the position transform
+// of its geometry and its color as instance attributes: the program must be
+// an instanced one, cf instanced_node.
+// The buffers are kept in memory, and uploaded again by the first render
+// after geometries are added; changed transforms are overwritten in place.
+class geometry_batch : public node {
+public:
+    explicit geometry_batch(const vertex_format& format);
+    // Appends the vertices and indices of data, drawn with transform in the
+    // coordinates the batch is rendered in. Returns the index of the draw,
+    // not_added when data is not made of triangles of the format of the batch.
+    size_t add(const geometry_data& data, const matrix44f& transform, const color4f& color = color4f());
+    // a new draw of the geometry of draw, sharing its vertices and indices
+    size_t add_copy(size_t draw, const matrix44f& transform, const color4f& color = color4f());
+    void set_transform(size_t draw, const matrix44f& transform);
+    inline size_t size() const { return _draws.size(); }
+    inline const std::vector<draw_elements_command>& draws() const { return _draws; }
+    virtual void render(rendering_context& ctx);
+    virtual bounds get_bounds() const;
+    static const size_t not_added;
+private:
+    size_t add_draw(const draw_elements_command& d, const matrix44f& position_transform, const bounds& model_bounds,
+        const matrix44f& transform, const color4f& color);
+    void upload();
+    vertex_format _format;
+    std::shared_ptr<geometry<float>> _geom;
+    std::vector<unsigned char> _vertices;
+    std::vector<GLuint> _indices;
+    std::vector<draw_elements_command> _draws;
+    std::vector<matrix44f> _position_transforms;
+    std::vector<bounds> _model_bounds;
+    std::vector<matrix44f> _transforms;
+    std::vector<float> _colors;
+    mutable bounds _bounds; // merged again after a transform changes
+    mutable bool _bounds_changed;
+    bool _buffers_changed;
+    bool _instances_changed;
+    size_t _uploaded_draws; // those the instance buffers are sized for
+};
+
+}
+
+#endif
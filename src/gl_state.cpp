@@ -0,0 +1,202 @@
+#include <cmath>
+
+#include "gl_state.hpp"
+
+using namespace yae;
+
+namespace {
+
+const GLuint unknown = ~0u;
+
+}
+
+gl_state& gl_state::current()
+{
+    static thread_local gl_state state;
+    return state;
+}
+
+gl_state::gl_state()
+{
+    invalidate();
+    reset_statistics();
+}
+
+void gl_state::invalidate()
+{
+    _program = unknown;
+    _vertex_array = unknown;
+    _buffers.clear();
+    _indexed_buffers.clear();
+    _active_texture = unknown;
+    for (GLuint& t : _textures) {
+        t = unknown;
+    }
+    _polygon_mode = unknown;
+    _polygon_offset[0] = _polygon_offset[1] = NAN;
+    _capabilities.clear();
+    _viewport[2] = _viewport[3] = -1;
+    _scissor[2] = _scissor[3] = -1;
+}
+
+bool gl_state::change(bool changed)
+{
+    (changed ? _statistics.issued : _statistics.elided)++;
+    return changed;
+}
+
+void gl_state::use_program(GLuint id)
+{
+    if (change(_program != id)) {
+        glUseProgram(id);
+        _program = id;
+    }
+}
+
+void gl_state::bind_vertex_array(GLuint id)
+{
+    if (change(_vertex_array != id)) {
+        glBindVertexArray(id);
+        _vertex_array = id;
+    }
+}
+
+void gl_state::bind_buffer(GLenum target, GLuint id)
+{
+    if (target == GL_ELEMENT_ARRAY_BUFFER) {
+        // not to change the indices of the vertex array bound
+        bind_vertex_array(0);
+        change(true);
+        glBindBuffer(target, id);
+        return;
+    }
+    auto it = _buffers.find(target);
+    if (change(it == _buffers.end() || it->second != id)) {
+        glBindBuffer(target, id);
+        _buffers[target] = id;
+    }
+}
+
+void gl_state::bind_buffer_base(GLenum target, GLuint index, GLuint id)
+{
+    auto it = _indexed_buffers.find(std::make_pair(target, index));
+    if (change(it == _indexed_buffers.end() || it->second != id)) {
+        glBindBufferBase(target, index, id);
+        _indexed_buffers[std::make_pair(target, index)] = id;
+        _buffers[target] = id;
+    }
+}
+
+void gl_state::bind_texture(GLuint unit, GLuint id)
+{
+    if (change(_active_texture != unit)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        _active_texture = unit;
+    }
+    if (change(unit >= texture_units || _textures[unit] != id)) {
+        glBindTexture(GL_TEXTURE_2D, id);
+        if (unit < texture_units) {
+            _textures[unit] = id;
+        }
+    }
+}
+
+void gl_state::polygon_mode(GLenum face, GLenum mode)
+{
+    if (change(face != GL_FRONT_AND_BACK || _polygon_mode != mode)) {
+        glPolygonMode(face, mode);
+        // the modes of the faces differ when set apart
+        _polygon_mode = face == GL_FRONT_AND_BACK ? mode : unknown;
+    }
+}
+
+void gl_state::polygon_offset(GLfloat factor, GLfloat units)
+{
+    // always issued while unknown, as NaN compares unequal
+    if (change(!(_polygon_offset[0] == factor && _polygon_offset[1] == units))) {
+        glPolygonOffset(factor, units);
+        _polygon_offset[0] = factor;
+        _polygon_offset[1] = units;
+    }
+}
+
+void gl_state::enable(GLenum capability)
+{
+    auto it = _capabilities.find(capability);
+    if (change(it == _capabilities.end() || !it->second)) {
+        glEnable(capability);
+        _capabilities[capability] = true;
+    }
+}
+
+void gl_state::disable(GLenum capability)
+{
+    auto it = _capabilities.find(capability);
+    if (change(it == _capabilities.end() || it->second)) {
+        glDisable(capability);
+        _capabilities[capability] = false;
+    }
+}
+
+void gl_state::viewport(GLint x, GLint y, GLsizei w, GLsizei h)
+{
+    if (change(_viewport[0] != x || _viewport[1] != y || _viewport[2] != w || _viewport[3] != h)) {
+        glViewport(x, y, w, h);
+        _viewport[0] = x;
+        _viewport[1] = y;
+        _viewport[2] = w;
+        _viewport[3] = h;
+    }
+}
+
+void gl_state::scissor(GLint x, GLint y, GLsizei w, GLsizei h)
+{
+    if (change(_scissor[0] != x || _scissor[1] != y || _scissor[2] != w || _scissor[3] != h)) {
+        glScissor(x, y, w, h);
+        _scissor[0] = x;
+        _scissor[1] = y;
+        _scissor[2] = w;
+        _scissor[3] = h;
+    }
+}
+
+void gl_state::delete_program(GLuint id)
+{
+    glDeleteProgram(id);
+    if (_program == id) {
+        _program = unknown;
+    }
+}
+
+void gl_state::delete_vertex_array(GLuint id)
+{
+    glDeleteVertexArrays(1, &id);
+    if (_vertex_array == id) {
+        _vertex_array = 0;
+    }
+}
+
+void gl_state::delete_buffer(GLuint id)
+{
+    glDeleteBuffers(1, &id);
+    for (auto& b : _buffers) {
+        if (b.second == id) {
+            b.second = 0;
+        }
+    }
+    for (auto& b : _indexed_buffers) {
+        if (b.second == id) {
+            b.second = 0;
+        }
+    }
+}
+
+void gl_state::delete_texture(GLuint id)
+{
+    glDeleteTextures(1, &id);
+    for (GLuint& t : _textures) {
+        if (t == id) {
+            t = 0;
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef _gl_state_hpp_
+#define _gl_state_hpp_
+
+#include <cstddef>
+#include <map>
+#include <utility>
+
+#include <GL/glew.h>
+
+namespace yae {
+
+// the state changes asked to a gl_state, issued to GL or skipped as redundant
+struct gl_state_statistics {
+    size_t issued;
+    size_t elided;
+};
+
+// The state of the GL context current on the calling thread, as set through
+// it: a call leaving the state unchanged is not issued. The state is unknown
+// until first set, then only valid as long as it is changed through here.
+// Element array buffers are state of the vertex array, their binds are always
+// issued, and those outside of vertex array setup unbind the vertex array.
+class gl_state {
+public:
+    // one per thread, as contexts are
+    static gl_state& current();
+    void use_program(GLuint id);
+    void bind_vertex_array(GLuint id);
+    void bind_buffer(GLenum target, GLuint id);
+    // to the indexed binding point and the generic one, e.g. of GL_UNIFORM_BUFFER
+    void bind_buffer_base(GLenum target, GLuint index, GLuint id);
+    // GL_TEXTURE_2D, made active on the unit
+    void bind_texture(GLuint unit, GLuint id);
+    void polygon_mode(GLenum face, GLenum mode);
+    void polygon_offset(GLfloat factor, GLfloat units);
+    void enable(GLenum capability);
+    void disable(GLenum capability);
+    void viewport(GLint x, GLint y, GLsizei w, GLsizei h);
+    void scissor(GLint x, GLint y, GLsizei w, GLsizei h);
+    // the names are freed, the bindings to them reverted to 0
+    void delete_program(GLuint id);
+    void delete_vertex_array(GLuint id);
+    void delete_buffer(GLuint id);
+    void delete_texture(GLuint id);
+    inline const gl_state_statistics& get_statistics() const { return _statistics; }
+    inline void reset_statistics() { _statistics = gl_state_statistics{ 0, 0 }; }
+    // forgets the state, e.g. after GL calls not made through here
+    void invalidate();
+private:
+    gl_state();
+    gl_state(const gl_state&);
+    // whether the call is to be issued, counted
+    bool change(bool changed);
+    static const size_t texture_units = 16;
+    GLuint _program;
+    GLuint _vertex_array;
+    std::map<GLenum, GLuint> _buffers;
+    std::map<std::pair<GLenum, GLuint>, GLuint> _indexed_buffers;
+    GLuint _active_texture;
+    GLuint _textures[texture_units];
+    GLenum _polygon_mode;
+    GLfloat _polygon_offset[2];
+    std::map<GLenum, bool> _capabilities;
+    GLint _viewport[4];
+    GLint _scissor[4];
+    gl_state_statistics _statistics;
+};
+
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include "instancing.hpp"
+
+using namespace yae;
+
+bounds yae::instances_bounds(const bounds& b, const std::vector<matrix44f>& transforms)
+{
+    bounds merged;
+    merged.known = true;
+    merged.lo = vector3f(1.0f, 1.0f, 1.0f);
+    merged.hi = vector3f(-1.0f, -1.0f, -1.0f);
+    for (const matrix44f& m : transforms) {
+        merged = merge_bounds(merged, transform_bounds(m, b));
+        if (!merged.known) {
+            break;
+        }
+    }
+    return merged;
+}
+
+instanced_node::instanced_node(std::shared_ptr<geometry<float>> geom)
+    : _geom(geom), _count(0), _transforms_size(0), _colors_size(0)
+{
+    _bounds.known = true;
+    _bounds.lo = vector3f(1.0f, 1.0f, 1.0f);
+    _bounds.hi = vector3f(-1.0f, -1.0f, -1.0f);
+}
+
+void instanced_node::upload(GLuint attribute, const vertex_format& format, const void* data, long size)
+{
+    long& current = attribute == vertex_attribute::INSTANCE_COLOR ? _colors_size : _transforms_size;
+    if (current == size && size > 0) {
+        gl_state::current().bind_buffer(GL_ARRAY_BUFFER, _geom->get_vertex_buffer(attribute));
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
+        return;
+    }
+    _geom->set_vertex_buffer(data, size, format);
+    current = size;
+}
+
+void instanced_node::set_transforms(const std::vector<matrix44f>& transforms)
+{
+    vertex_format format;
+    for (GLuint c = 0; c < 4; c++) {
+        format.add(vertex_attribute::INSTANCE_TRANSFORM + c, 4);
+    }
+    format.divisor = 1;
+    upload(vertex_attribute::INSTANCE_TRANSFORM, format, transforms.data(), static_cast<long>(transforms.size() * sizeof(matrix44f)));
+    bool resized = _count != transforms.size();
+    _count = transforms.size();
+    _geom->set_instance_count(static_cast<GLsizei>(_count));
+    _bounds = instances_bounds(_geom->get_bounds(), transforms);
+    bounds_changed();
+    if (resized && !_colors.empty()) {
+        upload_colors();
+    }
+}
+
+void instanced_node::set_colors(const std::vector<color4f>& colors)
+{
+    _colors = colors;
+    upload_colors();
+}
+
+void instanced_node::upload_colors()
+{
+    // one per instance, not to read past the buffer: the missing ones white, those in excess ignored
+    std::vector<float> packed(_count * 4);
+    for (size_t i = 0; i < _count; i++) {
+        (i < _colors.size() ? _colors[i] : color4f()).append_to(&packed[i * 4]);
+    }
+    vertex_format format;
+    format.add(vertex_attribute::INSTANCE_COLOR, 4);
+    format.divisor = 1;
+    upload(vertex_attribute::INSTANCE_COLOR, format, packed.data(), static_cast<long>(packed.size() * sizeof(float)));
+}
+
+void instanced_node::render(rendering_context& ctx)
+{
+    if (_count > 0) {
+        ctx.draw(*_geom);
+    }
+}
+
+bounds instanced_node::get_bounds() const
+{
+    return _bounds;
+}
@@ -0,0 +1,46 @@
+#ifndef _instancing_hpp_
+#define _instancing_hpp_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "geometry.hpp"
+#include "yae.hpp"
+
+namespace yae {
+
+// the bounds of b transformed by each of the transforms, empty when there is none
+bounds instances_bounds(const bounds& b, const std::vector<matrix44f>& transforms);
+
+// Draws a geometry once per instance in a single draw call, each instance
+// transformed by its matrix and tinted by its color. The program must read
+// the instance attributes, e.g. monochrome_program::create_3d_instanced or
+// flat_shading_program::create_instanced.
+class instanced_node : public node {
+public:
+    // the geometry is drawn instanced from then on, it is not to be shared
+    explicit instanced_node(std::shared_ptr<geometry<float>> geom);
+    // In the coordinates the node is rendered in, one per instance. The
+    // buffer is overwritten in place when the count does not change.
+    void set_transforms(const std::vector<matrix44f>& transforms);
+    // one per instance, white when not set, kept to follow the instance count
+    void set_colors(const std::vector<color4f>& colors);
+    inline size_t size() const { return _count; }
+    virtual void render(rendering_context& ctx);
+    virtual bounds get_bounds() const;
+private:
+    // in place when the buffer of attribute is already of size bytes
+    void upload(GLuint attribute, const vertex_format& format, const void* data, long size);
+    void upload_colors();
+    std::shared_ptr<geometry<float>> _geom;
+    size_t _count;
+    long _transforms_size;
+    long _colors_size;
+    std::vector<color4f> _colors;
+    bounds _bounds;
+};
+
+}
+
+#endif
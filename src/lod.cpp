@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "lod.hpp"
+
+using namespace yae;
+
+float yae::projected_diameter(const matrix44f& mvp, const viewport& vp, const vector3f& center, float radius)
+{
+    const float* m = mvp.m;
+    // the scale of the model along the rows of x, y and w in clip coordinates
+    float sx = length(vector3f(m[0], m[4], m[8]));
+    float sy = length(vector3f(m[1], m[5], m[9]));
+    float sw = length(vector3f(m[3], m[7], m[11]));
+    float w = m[3] * center.x() + m[7] * center.y() + m[11] * center.z() + m[15];
+    if (w <= radius * sw) {
+        return std::numeric_limits<float>::max();
+    }
+    // the radius in normalized device coordinates times half the viewport
+    float rx = radius * sx / w * vp.w / 2;
+    float ry = radius * sy / w * vp.h / 2;
+    return 2 * std::max(rx, ry);
+}
+
+lod_selector::lod_selector(size_t level_count)
+    : _hysteresis(0.1f), _current(0)
+{
+    for (size_t i = 0; i < level_count; i++) {
+        _thresholds.push_back(i + 1 < level_count ? std::ldexp(256.0f, -static_cast<int>(i)) : 0.0f);
+    }
+}
+
+void lod_selector::set_thresholds(std::vector<float> pixels)
+{
+    _thresholds = std::move(pixels);
+    _current = std::min(_current, _thresholds.empty() ? 0 : _thresholds.size() - 1);
+}
+
+void lod_selector::set_hysteresis(float ratio)
+{
+    _hysteresis = std::min(0.9f, std::max(0.0f, ratio));
+}
+
+size_t lod_selector::level_for(float diameter) const
+{
+    for (size_t i = 0; i + 1 < _thresholds.size(); i++) {
+        if (diameter >= _thresholds[i]) {
+            return i;
+        }
+    }
+    return _thresholds.empty() ? 0 : _thresholds.size() - 1;
+}
+
+size_t lod_selector::select(float diameter)
+{
+    // finer once the size is past the threshold grown by the hysteresis,
+    // coarser once below the threshold shrunk by it
+    size_t finer = level_for(diameter / (1.0f + _hysteresis));
+    size_t coarser = level_for(diameter / (1.0f - _hysteresis));
+    if (finer < _current) {
+        _current = finer;
+    } else if (coarser > _current) {
+        _current = coarser;
+    }
+    return _current;
+}
@@ -0,0 +1,97 @@
+#ifndef _lod_hpp_
+#define _lod_hpp_
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "geometry.hpp"
+#include "yae.hpp"
+
+namespace yae {
+
+// The diameter in pixels of a sphere of model coordinates drawn with mvp
+// in vp, the largest float when the sphere reaches the eye.
+float projected_diameter(const matrix44f& mvp, const viewport& vp, const vector3f& center, float radius);
+
+// Picks a level of detail from a projected diameter. Level i is drawn down to
+// its threshold, the last one at any size. A level is only left once the size
+// is past the threshold by the hysteresis ratio, so that a size wavering
+// around a threshold does not switch levels every frame.
+class lod_selector {
+public:
+    // thresholds halving from 256 pixels, for levels of about a quarter of
+    // the triangles of the previous one
+    explicit lod_selector(size_t level_count);
+    // in pixels, from the most detailed level
+    void set_thresholds(std::vector<float> pixels);
+    // 0.1 by default
+    void set_hysteresis(float ratio);
+    size_t select(float diameter);
+    inline size_t current() const { return _current; }
+private:
+    size_t level_for(float diameter) const;
+    std::vector<float> _thresholds;
+    float _hysteresis;
+    size_t _current;
+};
+
+// Draws one of several geometries of decreasing detail according to the size
+// of their bounding sphere in the viewport of the scene, the most detailed
+// outside scenes.
+template<class T>
+class lod_node : public node {
+public:
+    // levels from the most detailed, the sphere in model coordinates
+    lod_node(std::vector<std::shared_ptr<geometry<T>>> levels, const vector3f& center, float radius)
+        : _levels(std::move(levels)), _center(center), _radius(radius), _selector(_levels.size()) {}
+    inline lod_selector& selector() { return _selector; }
+    inline size_t level_count() const { return _levels.size(); }
+    virtual void render(rendering_context& ctx)
+    {
+        if (_levels.empty()) {
+            return;
+        }
+        float diameter = ctx.vp.w > 0 && ctx.vp.h > 0
+            ? projected_diameter(ctx.mvp(), ctx.vp, _center, _radius)
+            : std::numeric_limits<float>::max();
+        // the selector may be given more thresholds than there are levels
+        ctx.draw(*_levels[std::min(_selector.select(diameter), _levels.size() - 1)]);
+    }
+    virtual bounds get_bounds() const
+    {
+        return _levels.empty() ? bounds() : _levels[0]->get_bounds();
+    }
+private:
+    std::vector<std::shared_ptr<geometry<T>>> _levels;
+    vector3f _center;
+    float _radius;
+    lod_selector _selector;
+};
+
+// A node of level_count levels of a 3D mesh, each simplified to about ratio
+// of the triangles of the previous one, cf geometry_builder::simplified.
+template<class T>
+std::shared_ptr<lod_node<T>> make_lod_node(geometry_builder<T>& geomb, size_t level_count, float ratio = 0.25f)
+{
+    bounds b = geomb.compute_bounds();
+    std::vector<std::shared_ptr<geometry<T>>> levels;
+    if (level_count > 1) {
+        geometry_builder<T> level = geomb.simplified(ratio);
+        levels.push_back(geomb.build());
+        for (size_t i = 1; i < level_count; i++) {
+            levels.push_back(level.build());
+            if (i + 1 < level_count) {
+                level = level.simplified(ratio);
+            }
+        }
+    } else if (level_count == 1) {
+        levels.push_back(geomb.build());
+    }
+    return std::make_shared<lod_node<T>>(std::move(levels), b.center, std::max(0.0f, b.radius));
+}
+
+}
+
+#endif
@@ -3,8 +3,17 @@
 
 #include <iostream>
 #include <array>
+#include <vector>
+#include <cmath>
 #include <cstring>
 
+// SSE kernels are used for float matrices whenever the target has SSE,
+// define YAE_NO_SIMD to force the portable scalar code.
+#if !defined(YAE_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define YAE_SSE 1
+#include <xmmintrin.h>
+#endif
+
 namespace yae {
     
 template<class T>
@@ -13,7 +22,7 @@ struct vector3 {
     inline vector3() : v({ (T)0, (T)0, (T)0 }) {}
     inline vector3(T x, T y, T z) : v({ x, y, z }) {}
     inline vector3(const T* tp) { memcpy(v.data(), tp, 3 * sizeof(T)); }
-    inline vector3(const vector3<T>& vec3) { vec3.copy(v.data()); }
+    inline vector3(const vector3<T>& vec3) : v(vec3.v) {}
 
     inline T x() const { return v[0]; }
     inline T y() const { return v[1]; }
@@ -52,15 +61,16 @@ struct triangle {
     inline vector3<T> v2() const { return vector3<T>(&v[3]); }
     inline vector3<T> v3() const { return vector3<T>(&v[6]); }
 
-    inline void append_to(T* dest) const { memcpy(dest, &t[0], 9*sizeof(T)); }
+    inline void append_to(T* dest) const { memcpy(dest, &v[0], 9*sizeof(T)); }
     inline void append_to(std::vector<T>& vec) const { vec.insert(vec.end(), v.data(), v.data() + 9); }
 
 private:
     std::array<T, 9> v;
 };
 
+// column major, aligned so that each column fits a SIMD register
 template<class T>
-struct matrix44 {
+struct alignas(16) matrix44 {
     T m[16];
 };
 
@@ -71,9 +81,9 @@ struct color3 : vector3<T> {
 
     inline color3(T r, T g, T b) : vector3<T>(r, g, b) {}
 
-    inline T r() const { return x(); }
-    inline T g() const { return y(); }
-    inline T b() const { return z(); }
+    inline T r() const { return this->x(); }
+    inline T g() const { return this->y(); }
+    inline T b() const { return this->z(); }
 };
 
 template<class T>
@@ -83,10 +93,10 @@ struct color4 : vector4<T> {
 
     inline color4(T r, T g, T b, T a = 1) : vector4<T>(r, g, b, a) {}
 
-    inline T r() const { return x(); }
-    inline T g() const { return y(); }
-    inline T b() const { return z(); }
-    inline T a() const { return w(); }
+    inline T r() const { return this->x(); }
+    inline T g() const { return this->y(); }
+    inline T b() const { return this->z(); }
+    inline T a() const { return this->w(); }
 };
 
 template<class T>
@@ -137,6 +147,65 @@ inline vector3<T> operator*(const matrix44<T>& m, const vector3<T>& v)
     return vector3<T>(x, y, z);
 }
 
+#ifdef YAE_SSE
+inline vector3<float> operator*(const matrix44<float>& m, const vector3<float>& v)
+{
+    // the operations are done in the same order as the scalar version,
+    // so both give bit identical results
+    __m128 r = _mm_mul_ps(_mm_loadu_ps(&m.m[0]), _mm_set1_ps(v.x()));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&m.m[4]), _mm_set1_ps(v.y())));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&m.m[8]), _mm_set1_ps(v.z())));
+    r = _mm_add_ps(r, _mm_loadu_ps(&m.m[12]));
+    alignas(16) float out[4];
+    _mm_store_ps(out, r);
+    return vector3<float>(out);
+}
+#endif
+
+// transforms count points of 3 coordinates stored contiguously in place
+template<class T>
+void transform_points(const matrix44<T>& m, T* points, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        (m * vector3<T>(&points[i * 3])).append_to(&points[i * 3]);
+    }
+}
+
+#ifdef YAE_SSE
+inline void transform_points(const matrix44<float>& m, float* points, size_t count)
+{
+    __m128 m0 = _mm_set1_ps(m.m[0]), m1 = _mm_set1_ps(m.m[1]), m2 = _mm_set1_ps(m.m[2]);
+    __m128 m4 = _mm_set1_ps(m.m[4]), m5 = _mm_set1_ps(m.m[5]), m6 = _mm_set1_ps(m.m[6]);
+    __m128 m8 = _mm_set1_ps(m.m[8]), m9 = _mm_set1_ps(m.m[9]), m10 = _mm_set1_ps(m.m[10]);
+    __m128 m12 = _mm_set1_ps(m.m[12]), m13 = _mm_set1_ps(m.m[13]), m14 = _mm_set1_ps(m.m[14]);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // 4 points x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3 are transposed
+        // into x0 x1 x2 x3 | y0 y1 y2 y3 | z0 z1 z2 z3 and back
+        float* p = &points[i * 3];
+        __m128 a = _mm_loadu_ps(p);
+        __m128 b = _mm_loadu_ps(p + 4);
+        __m128 c = _mm_loadu_ps(p + 8);
+        __m128 x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+        __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+        // same order of operations as matrix * vector3
+        __m128 tx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, x), _mm_mul_ps(m4, y)), _mm_mul_ps(m8, z)), m12);
+        __m128 ty = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, x), _mm_mul_ps(m5, y)), _mm_mul_ps(m9, z)), m13);
+        __m128 tz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, x), _mm_mul_ps(m6, y)), _mm_mul_ps(m10, z)), m14);
+        a = _mm_shuffle_ps(_mm_shuffle_ps(tx, ty, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(tz, tx, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+        b = _mm_shuffle_ps(_mm_shuffle_ps(ty, tz, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(tx, ty, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+        c = _mm_shuffle_ps(_mm_shuffle_ps(tz, tx, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(ty, tz, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        _mm_storeu_ps(p, a);
+        _mm_storeu_ps(p + 4, b);
+        _mm_storeu_ps(p + 8, c);
+    }
+    for (; i < count; i++) {
+        (m * vector3<float>(&points[i * 3])).append_to(&points[i * 3]);
+    }
+}
+#endif
+
 template<class T>
 inline vector3<T> normalize(const vector3<T>& v)
 {
@@ -151,7 +220,19 @@ inline vector3<T> cross_product(const vector3<T>& u, const vector3<T>& v)
 }
 
 template<class T>
-matrix44<T> multm(matrix44<T> m1, matrix44<T> m2)
+inline T dot_product(const vector3<T>& u, const vector3<T>& v)
+{
+    return u.x()*v.x() + u.y()*v.y() + u.z()*v.z();
+}
+
+template<class T>
+inline T length(const vector3<T>& v)
+{
+    return sqrt(dot_product(v, v));
+}
+
+template<class T>
+matrix44<T> multm_scalar(const matrix44<T>& m1, const matrix44<T>& m2)
 {
     matrix44<T> m;
     for (int i = 0; i < 4; i++) {
@@ -166,8 +247,36 @@ matrix44<T> multm(matrix44<T> m1, matrix44<T> m2)
     return m;
 }
 
+template<class T>
+inline matrix44<T> multm(const matrix44<T>& m1, const matrix44<T>& m2)
+{
+    return multm_scalar(m1, m2);
+}
+
+#ifdef YAE_SSE
+inline matrix44<float> multm(const matrix44<float>& m1, const matrix44<float>& m2)
+{
+    // each column of the result is a linear combination of the columns of m1,
+    // unaligned loads are used as std::vector does not honor alignas everywhere
+    __m128 c0 = _mm_loadu_ps(&m1.m[0]);
+    __m128 c1 = _mm_loadu_ps(&m1.m[4]);
+    __m128 c2 = _mm_loadu_ps(&m1.m[8]);
+    __m128 c3 = _mm_loadu_ps(&m1.m[12]);
+    matrix44<float> m;
+    for (int j = 0; j < 4; j++) {
+        __m128 b = _mm_loadu_ps(&m2.m[j * 4]);
+        __m128 r = _mm_mul_ps(c0, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 0, 0, 0)));
+        r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 1, 1, 1))));
+        r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 2, 2, 2))));
+        r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 3, 3, 3))));
+        _mm_storeu_ps(&m.m[j * 4], r);
+    }
+    return m;
+}
+#endif
+
 template <class T, class... M>
-matrix44<T> multm(matrix44<T> m1, matrix44<T> m2, M... m)
+matrix44<T> multm(const matrix44<T>& m1, const matrix44<T>& m2, const M&... m)
 {
     return multm(m1, multm(m2, m...));
 }
@@ -264,6 +373,29 @@ matrix44<T> translation(T x, T y, T z)
     return mat;
 }
 
+template<class T>
+matrix44<T> scaling(T x, T y, T z)
+{
+    matrix44<T> mat;
+    mat.m[0] = x;
+    mat.m[1] = 0.0f;
+    mat.m[2] = 0.0f;
+    mat.m[3] = 0.0f;
+    mat.m[4] = 0.0f;
+    mat.m[5] = y;
+    mat.m[6] = 0.0f;
+    mat.m[7] = 0.0f;
+    mat.m[8] = 0.0f;
+    mat.m[9] = 0.0f;
+    mat.m[10] = z;
+    mat.m[11] = 0.0f;
+    mat.m[12] = 0.0f;
+    mat.m[13] = 0.0f;
+    mat.m[14] = 0.0f;
+    mat.m[15] = 1.0f;
+    return mat;
+}
+
 template<class T>
 inline T to_radians(T deg)
 {
@@ -276,17 +408,21 @@ matrix44<T> rotation(T deg, T x, T y, T z)
     matrix44<T> mat;
     T c = (T)cos(to_radians(deg));
     T s = (T)sin(to_radians(deg));
-    mat.m[0] = x * x * (1 - c) + c;
-    mat.m[1] = y * x * (1 - c) + z * s;
-    mat.m[2] = x * z * (1 - c) - y * s;
+    T t = 1 - c;
+    T xy = y * x * t;
+    T xz = x * z * t;
+    T yz = y * z * t;
+    mat.m[0] = x * x * t + c;
+    mat.m[1] = xy + z * s;
+    mat.m[2] = xz - y * s;
     mat.m[3] = 0.0f;
-    mat.m[4] = y * x * (1 - c) - z * s;
-    mat.m[5] = y * y * (1 - c) + c;
-    mat.m[6] = y * z * (1 - c) + x * s;
+    mat.m[4] = xy - z * s;
+    mat.m[5] = y * y * t + c;
+    mat.m[6] = yz + x * s;
     mat.m[7] = 0.0f;
-    mat.m[8] = x * z * (1 - c) + y * s;
-    mat.m[9] = y * z * (1 - c) - x * s;
-    mat.m[10] = z * z * (1 - c) + c;
+    mat.m[8] = xz + y * s;
+    mat.m[9] = yz - x * s;
+    mat.m[10] = z * z * t + c;
     mat.m[11] = 0.0f;
     mat.m[12] = 0.0f;
     mat.m[13] = 0.0f;
@@ -303,7 +439,7 @@ matrix44<T> look_at(T eye_x, T eye_y, T eye_z, T center_x, T center_y, T center_
     auto up = normalize(vector3<T>(up_x, up_y, up_z));
     auto s = cross_product(f, up);
     auto u = cross_product(s, f);
-    matrix44f m44;
+    matrix44<T> m44;
     m44.m[0] = s.x();
     m44.m[1] = u.x();
     m44.m[2] = -f.x();
@@ -316,11 +452,66 @@ matrix44<T> look_at(T eye_x, T eye_y, T eye_z, T center_x, T center_y, T center_
     m44.m[9] = u.z();
     m44.m[10] = -f.z();
     m44.m[11] = 0;
-    m44.m[12] = 0;
-    m44.m[13] = 0;
-    m44.m[14] = 0;
+    // the translation by -eye is folded in the last column
+    // instead of doing a full matrix multiplication
+    m44.m[12] = -(s.x() * eye_x + s.y() * eye_y + s.z() * eye_z);
+    m44.m[13] = -(u.x() * eye_x + u.y() * eye_y + u.z() * eye_z);
+    m44.m[14] = f.x() * eye_x + f.y() * eye_y + f.z() * eye_z;
     m44.m[15] = 1;
-    return multm(m44, translation(-eye_x, -eye_y, -eye_z));
+    return m44;
+}
+
+// v transformed without the translation of m, for directions
+template<class T>
+inline vector3<T> transform_direction(const matrix44<T>& m, const vector3<T>& v)
+{
+    T x = m.m[0] * v.x() + m.m[4] * v.y() + m.m[8] * v.z();
+    T y = m.m[1] * v.x() + m.m[5] * v.y() + m.m[9] * v.z();
+    T z = m.m[2] * v.x() + m.m[6] * v.y() + m.m[10] * v.z();
+    return vector3<T>(x, y, z);
+}
+
+// the inverse of m by cofactors, false when m is singular
+template<class T>
+bool invert(const matrix44<T>& m, matrix44<T>& inverse)
+{
+    const T* a = m.m;
+    // the 2x2 determinants of the 2 first and 2 last columns
+    T s0 = a[0] * a[5] - a[1] * a[4];
+    T s1 = a[0] * a[6] - a[2] * a[4];
+    T s2 = a[0] * a[7] - a[3] * a[4];
+    T s3 = a[1] * a[6] - a[2] * a[5];
+    T s4 = a[1] * a[7] - a[3] * a[5];
+    T s5 = a[2] * a[7] - a[3] * a[6];
+    T c5 = a[10] * a[15] - a[11] * a[14];
+    T c4 = a[9] * a[15] - a[11] * a[13];
+    T c3 = a[9] * a[14] - a[10] * a[13];
+    T c2 = a[8] * a[15] - a[11] * a[12];
+    T c1 = a[8] * a[14] - a[10] * a[12];
+    T c0 = a[8] * a[13] - a[9] * a[12];
+    T det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    if (det == (T)0) {
+        return false;
+    }
+    T d = (T)1 / det;
+    T* r = inverse.m;
+    r[0] = (a[5] * c5 - a[6] * c4 + a[7] * c3) * d;
+    r[1] = (-a[1] * c5 + a[2] * c4 - a[3] * c3) * d;
+    r[2] = (a[13] * s5 - a[14] * s4 + a[15] * s3) * d;
+    r[3] = (-a[9] * s5 + a[10] * s4 - a[11] * s3) * d;
+    r[4] = (-a[4] * c5 + a[6] * c2 - a[7] * c1) * d;
+    r[5] = (a[0] * c5 - a[2] * c2 + a[3] * c1) * d;
+    r[6] = (-a[12] * s5 + a[14] * s2 - a[15] * s1) * d;
+    r[7] = (a[8] * s5 - a[10] * s2 + a[11] * s1) * d;
+    r[8] = (a[4] * c4 - a[5] * c2 + a[7] * c0) * d;
+    r[9] = (-a[0] * c4 + a[1] * c2 - a[3] * c0) * d;
+    r[10] = (a[12] * s4 - a[13] * s2 + a[15] * s0) * d;
+    r[11] = (-a[8] * s4 + a[9] * s2 - a[11] * s0) * d;
+    r[12] = (-a[4] * c3 + a[5] * c1 - a[6] * c0) * d;
+    r[13] = (a[0] * c3 - a[1] * c1 + a[2] * c0) * d;
+    r[14] = (-a[12] * s3 + a[13] * s1 - a[14] * s0) * d;
+    r[15] = (a[8] * s3 - a[9] * s1 + a[10] * s0) * d;
+    return true;
 }
 
 typedef vector3<float> vector3f;
@@ -0,0 +1,117 @@
+#include <tuple>
+
+#include "mesh_cache.hpp"
+
+using namespace yae;
+
+bool mesh_key::operator<(const mesh_key& that) const
+{
+    return std::tie(generator, parameters, primitive_type) < std::tie(that.generator, that.parameters, that.primitive_type);
+}
+
+mesh_cache::mesh_cache()
+    : _capacity(0), _hits(0), _misses(0), _evictions(0)
+{
+}
+
+std::shared_ptr<geometry<float>> mesh_cache::get(const mesh_key& key, const build_function& build)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _entries.find(key);
+        if (it != _entries.end()) {
+            _hits++;
+            _lru.splice(_lru.begin(), _lru, it->second.lru_position);
+            return it->second.geom;
+        }
+        _misses++;
+    }
+    // built without the lock, build may use the cache itself
+    std::shared_ptr<geometry<float>> geom = build();
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entries.find(key);
+    if (it != _entries.end()) {
+        // built meanwhile by another thread
+        return it->second.geom;
+    }
+    _lru.push_front(key);
+    _entries[key] = entry{ geom, _lru.begin() };
+    evict_to_capacity();
+    return geom;
+}
+
+void mesh_cache::set_capacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _capacity = capacity;
+    evict_to_capacity();
+}
+
+void mesh_cache::evict_to_capacity()
+{
+    while (_capacity > 0 && _entries.size() > _capacity) {
+        _entries.erase(_lru.back());
+        _lru.pop_back();
+        _evictions++;
+    }
+}
+
+size_t mesh_cache::evict_unused()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    size_t count = 0;
+    for (auto it = _entries.begin(); it != _entries.end();) {
+        if (it->second.geom.use_count() == 1) {
+            _lru.erase(it->second.lru_position);
+            it = _entries.erase(it);
+            count++;
+        } else {
+            ++it;
+        }
+    }
+    _evictions += count;
+    return count;
+}
+
+void mesh_cache::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entries.clear();
+    _lru.clear();
+}
+
+size_t mesh_cache::size() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _entries.size();
+}
+
+mesh_cache& mesh_cache::instance()
+{
+    static mesh_cache cache;
+    return cache;
+}
+
+std::shared_ptr<geometry<float>> yae::cached_grid(int nx, int ny)
+{
+    return mesh_cache::instance().get(mesh_key{ "grid", { (double)nx, (double)ny }, GL_TRIANGLES },
+        [=]() { return make_grid<float>(nx, ny).build(); });
+}
+
+std::shared_ptr<geometry<float>> yae::cached_box(int nx, int ny, int nz)
+{
+    return mesh_cache::instance().get(mesh_key{ "box", { (double)nx, (double)ny, (double)nz }, GL_TRIANGLES },
+        [=]() { return make_box<float>(nx, ny, nz).build(); });
+}
+
+std::shared_ptr<geometry<float>> yae::cached_uv_sphere(int nlong, int nlat)
+{
+    return mesh_cache::instance().get(mesh_key{ "uv_sphere", { (double)nlong, (double)nlat }, GL_TRIANGLES },
+        [=]() { return make_uv_sphere<float>(nlong, nlat).build(); });
+}
+
+std::shared_ptr<geometry<float>> yae::cached_octahedron_sphere(int n)
+{
+    return mesh_cache::instance().get(mesh_key{ "octahedron_sphere", { (double)n }, GL_TRIANGLES },
+        [=]() { return make_octahedron_sphere<float>(n).build(); });
+}
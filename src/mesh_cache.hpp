@@ -0,0 +1,75 @@
+#ifndef _mesh_cache_hpp_
+#define _mesh_cache_hpp_
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "geometry.hpp"
+
+namespace yae {
+
+// identifies a generated mesh, e.g. { "box", { 10, 20, 5 }, GL_TRIANGLES },
+// the primitive type being that of the geometry built, quads built as triangles
+struct mesh_key {
+    std::string generator;
+    std::vector<double> parameters;
+    GLenum primitive_type;
+
+    bool operator<(const mesh_key& that) const;
+};
+
+// Process wide cache of generated geometries, so that identical primitives
+// share their buffers. When the capacity is reached the least recently used
+// entry is dropped, the geometry stays alive as long as a node refers to it.
+class mesh_cache {
+public:
+    typedef std::function<std::unique_ptr<geometry<float>>()> build_function;
+
+    mesh_cache();
+    // returns the geometry of key, calling build the first time only
+    std::shared_ptr<geometry<float>> get(const mesh_key& key, const build_function& build);
+    // 0, the default, for no limit
+    void set_capacity(size_t capacity);
+    // drops the geometries only referred to by the cache
+    size_t evict_unused();
+    void clear();
+    size_t size() const;
+    inline size_t hits() const { return _hits; }
+    inline size_t misses() const { return _misses; }
+    inline size_t evictions() const { return _evictions; }
+    // cleared by engine::run before it returns, as it outlives the context
+    static mesh_cache& instance();
+private:
+    struct entry {
+        std::shared_ptr<geometry<float>> geom;
+        std::list<mesh_key>::iterator lru_position;
+    };
+    void evict_to_capacity();
+    std::map<mesh_key, entry> _entries;
+    std::list<mesh_key> _lru; // most recently used first
+    size_t _capacity;
+    // read without the lock
+    std::atomic<size_t> _hits;
+    std::atomic<size_t> _misses;
+    std::atomic<size_t> _evictions;
+    mutable std::mutex _mutex;
+    mesh_cache(const mesh_cache&);
+};
+
+std::shared_ptr<geometry<float>> cached_grid(int nx, int ny);
+std::shared_ptr<geometry<float>> cached_box(int nx, int ny, int nz);
+std::shared_ptr<geometry<float>> cached_uv_sphere(int nlong, int nlat);
+std::shared_ptr<geometry<float>> cached_octahedron_sphere(int n);
+
+}
+
+#endif
@@ -0,0 +1,286 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mesh_file.hpp"
+
+using namespace yae;
+
+static_assert(sizeof(mesh_file_header) == 176, "mesh_file_header has no padding");
+static_assert(sizeof(mesh_file_element) == 20, "mesh_file_element has no padding");
+
+mapped_file::mapped_file()
+    : _data(nullptr), _size(0)
+#ifdef _WIN32
+    , _file(INVALID_HANDLE_VALUE), _mapping(nullptr)
+#endif
+{
+}
+
+mapped_file::~mapped_file()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool mapped_file::open(const std::string& path)
+{
+    close();
+    _file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER size;
+    if (_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(_file, &size) || size.QuadPart == 0) {
+        close();
+        return false;
+    }
+    _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mapping != nullptr) {
+        _data = static_cast<const unsigned char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (_data == nullptr) {
+        close();
+        return false;
+    }
+    _size = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void mapped_file::close()
+{
+    if (_data != nullptr) {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping != nullptr) {
+        CloseHandle(_mapping);
+    }
+    if (_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(_file);
+    }
+    _data = nullptr;
+    _size = 0;
+    _mapping = nullptr;
+    _file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool mapped_file::open(const std::string& path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            _data = static_cast<const unsigned char*>(p);
+            _size = static_cast<size_t>(st.st_size);
+            // the whole file is about to be read, starts reading ahead
+            madvise(p, _size, MADV_WILLNEED);
+        }
+    }
+    // the mapping stays valid once the descriptor is closed
+    ::close(fd);
+    return _data != nullptr;
+}
+
+void mapped_file::close()
+{
+    if (_data != nullptr) {
+        munmap(const_cast<unsigned char*>(_data), _size);
+    }
+    _data = nullptr;
+    _size = 0;
+}
+
+#endif
+
+static inline uint64_t align(uint64_t offset)
+{
+    return (offset + mesh_file_alignment - 1) / mesh_file_alignment * mesh_file_alignment;
+}
+
+bool yae::save_mesh_file(const std::string& path, const geometry_data& data)
+{
+    mesh_file_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = mesh_file_magic;
+    header.version = mesh_file_version;
+    header.primitive_type = data.primitive_type;
+    header.dimensions = data.dimensions;
+    header.count = data.count;
+    header.index_type = data.indices.empty() ? GL_NONE : data.index_type;
+    header.primitive_restart = data.primitive_restart ? 1 : 0;
+    header.element_count = static_cast<uint32_t>(data.format.elements.size());
+    header.stride = data.format.stride;
+    header.vertices_offset = align(sizeof(header) + header.element_count * sizeof(mesh_file_element));
+    header.vertices_size = data.vertices.size();
+    header.indices_offset = align(header.vertices_offset + header.vertices_size);
+    header.indices_size = data.indices.size();
+    memcpy(header.position_transform, data.position_transform.m, sizeof(header.position_transform));
+    const bounds& b = data.model_bounds;
+    header.bounds_known = b.known ? 1 : 0;
+    b.lo.append_to(header.bounds_lo);
+    b.hi.append_to(header.bounds_hi);
+    b.center.append_to(header.bounds_center);
+    header.bounds_radius = b.radius;
+
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    if (!f) {
+        printf("Cannot write %s\n", path.c_str());
+        return false;
+    }
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (auto& e : data.format.elements) {
+        mesh_file_element element = { e.attribute, e.size, e.type, e.normalized ? 1u : 0u, e.offset };
+        f.write(reinterpret_cast<const char*>(&element), sizeof(element));
+    }
+    const char padding[mesh_file_alignment] = {};
+    uint64_t offset = sizeof(header) + header.element_count * sizeof(mesh_file_element);
+    f.write(padding, header.vertices_offset - offset);
+    f.write(reinterpret_cast<const char*>(data.vertices.data()), header.vertices_size);
+    f.write(padding, header.indices_offset - header.vertices_offset - header.vertices_size);
+    f.write(reinterpret_cast<const char*>(data.indices.data()), header.indices_size);
+    if (!f) {
+        printf("Cannot write %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+static bool is_primitive_type(uint32_t type)
+{
+    return type == GL_POINTS || type == GL_LINES || type == GL_LINE_LOOP || type == GL_LINE_STRIP
+        || type == GL_TRIANGLES || type == GL_TRIANGLE_STRIP || type == GL_TRIANGLE_FAN || type == GL_QUADS;
+}
+
+static bool is_component_type(uint32_t type)
+{
+    return type == GL_BYTE || type == GL_UNSIGNED_BYTE || type == GL_SHORT || type == GL_UNSIGNED_SHORT
+        || type == GL_INT || type == GL_UNSIGNED_INT || type == GL_HALF_FLOAT || type == GL_FLOAT
+        || type == GL_DOUBLE || is_packed(type);
+}
+
+// whether the count first indices refer to one of the vertices, or restart
+template<class I>
+static bool indices_in_range(const unsigned char* bytes, size_t count, uint64_t vertex_count, bool restart)
+{
+    const I restart_index = std::numeric_limits<I>::max();
+    for (size_t i = 0; i < count; i++) {
+        I index;
+        memcpy(&index, bytes + i * sizeof(I), sizeof(I));
+        if (index >= vertex_count && !(restart && index == restart_index)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool yae::read_mesh_file(const unsigned char* bytes, size_t size, mesh_file_view& view)
+{
+    if (size < sizeof(mesh_file_header)) {
+        printf("Mesh file truncated\n");
+        return false;
+    }
+    auto header = reinterpret_cast<const mesh_file_header*>(bytes);
+    if (header->magic != mesh_file_magic) {
+        printf("Not a mesh file\n");
+        return false;
+    }
+    if (header->version != mesh_file_version) {
+        printf("Unsupported mesh file version %u\n", header->version);
+        return false;
+    }
+    uint64_t elements_end = sizeof(mesh_file_header) + (uint64_t)header->element_count * sizeof(mesh_file_element);
+    if (elements_end > size || header->vertices_offset < elements_end || header->vertices_offset > size
+        || header->vertices_size > size - header->vertices_offset
+        || header->indices_offset > size || header->indices_size > size - header->indices_offset) {
+        printf("Mesh file truncated\n");
+        return false;
+    }
+    uint32_t index_type = header->index_type;
+    if (!is_primitive_type(header->primitive_type) || header->dimensions < 2 || header->dimensions > 4
+        || header->count < 0 || header->stride <= 0 || header->element_count == 0
+        || (index_type != GL_NONE && index_type != GL_UNSIGNED_BYTE && index_type != GL_UNSIGNED_SHORT
+            && index_type != GL_UNSIGNED_INT)
+        || (index_type == GL_NONE) != (header->indices_size == 0)) {
+        printf("Invalid mesh file header\n");
+        return false;
+    }
+    view.header = header;
+    view.format = vertex_format();
+    auto elements = reinterpret_cast<const mesh_file_element*>(bytes + sizeof(mesh_file_header));
+    for (uint32_t i = 0; i < header->element_count; i++) {
+        const mesh_file_element& e = elements[i];
+        if (e.attribute >= 16 || e.size < 1 || e.size > 4 || !is_component_type(e.type) || e.offset < 0
+            || e.offset + attribute_bytes(e.type, e.size) > header->stride) {
+            printf("Invalid mesh file vertex format\n");
+            return false;
+        }
+        view.format.elements.push_back(vertex_element{ e.attribute, e.size, e.type, static_cast<GLboolean>(e.normalized), e.offset });
+    }
+    view.format.stride = header->stride;
+    view.vertices = bytes + header->vertices_offset;
+    view.indices = header->indices_size > 0 ? bytes + header->indices_offset : nullptr;
+    // what a draw reads
+    uint64_t vertex_count = header->vertices_size / static_cast<uint64_t>(header->stride);
+    uint64_t count = static_cast<uint64_t>(header->count);
+    bool restart = header->primitive_restart != 0;
+    bool in_range = index_type == GL_NONE ? count <= vertex_count
+        : count * component_bytes(index_type) > header->indices_size ? false
+        : index_type == GL_UNSIGNED_BYTE ? indices_in_range<GLubyte>(view.indices, count, vertex_count, restart)
+        : index_type == GL_UNSIGNED_SHORT ? indices_in_range<GLushort>(view.indices, count, vertex_count, restart)
+        : indices_in_range<GLuint>(view.indices, count, vertex_count, restart);
+    if (!in_range) {
+        printf("Mesh file draws past its buffers\n");
+        return false;
+    }
+    view.model_bounds = bounds();
+    if (header->bounds_known != 0) {
+        view.model_bounds.lo = vector3f(header->bounds_lo);
+        view.model_bounds.hi = vector3f(header->bounds_hi);
+        view.model_bounds.center = vector3f(header->bounds_center);
+        view.model_bounds.radius = header->bounds_radius;
+        view.model_bounds.known = true;
+    }
+    return true;
+}
+
+std::unique_ptr<geometry<float>> yae::load_mesh_file(const std::string& path)
+{
+    mapped_file file;
+    if (!file.open(path)) {
+        printf("Cannot map %s\n", path.c_str());
+        return nullptr;
+    }
+    mesh_file_view view;
+    if (!read_mesh_file(file.data(), file.size(), view)) {
+        return nullptr;
+    }
+    const mesh_file_header& h = *view.header;
+    auto g = std::make_unique<geometry<float>>(h.count, h.dimensions, h.primitive_type);
+    // glBufferData copies the pages of the mapping, no intermediate array
+    g->set_vertex_buffer(view.vertices, static_cast<long>(h.vertices_size), view.format);
+    if (view.indices != nullptr) {
+        g->set_indices(view.indices, static_cast<long>(h.indices_size), h.index_type);
+    }
+    g->set_primitive_restart(h.primitive_restart != 0);
+    matrix44f position_transform;
+    memcpy(position_transform.m, h.position_transform, sizeof(position_transform.m));
+    g->set_position_transform(position_transform);
+    g->set_bounds(view.model_bounds);
+    return g;
+}
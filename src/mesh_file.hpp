@@ -0,0 +1,107 @@
+#ifndef _mesh_file_hpp_
+#define _mesh_file_hpp_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <GL/glew.h>
+
+#include "geometry.hpp"
+
+namespace yae {
+
+// A file mapped read only in memory, the pages are loaded on first access.
+class mapped_file {
+public:
+    mapped_file();
+    ~mapped_file();
+    bool open(const std::string& path);
+    void close();
+    inline bool is_open() const { return _data != nullptr; }
+    inline const unsigned char* data() const { return _data; }
+    inline size_t size() const { return _size; }
+private:
+    const unsigned char* _data;
+    size_t _size;
+#ifdef _WIN32
+    void* _file;
+    void* _mapping;
+#endif
+    mapped_file(const mapped_file&);
+};
+
+// Binary meshes, laid out to be uploaded straight from a mapping: the header,
+// element_count elements describing the vertex format, then the vertices and
+// the indices, each starting on a multiple of mesh_file_alignment bytes.
+// Values are stored in the byte order of the machine, which the magic checks.
+const uint32_t mesh_file_magic = 0x4d454159; // "YAEM" read as little endian
+const uint32_t mesh_file_version = 2; // 2 adds the bounds
+const size_t mesh_file_alignment = 16;
+
+struct mesh_file_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t primitive_type;
+    int32_t dimensions;
+    int32_t count;
+    uint32_t index_type; // GL_NONE when not indexed
+    uint32_t primitive_restart;
+    uint32_t element_count;
+    int32_t stride;
+    uint32_t bounds_known;
+    uint64_t vertices_offset;
+    uint64_t vertices_size;
+    uint64_t indices_offset;
+    uint64_t indices_size;
+    float position_transform[16];
+    // in model coordinates, cf geometry_data::model_bounds
+    float bounds_lo[3];
+    float bounds_hi[3];
+    float bounds_center[3];
+    float bounds_radius;
+};
+
+struct mesh_file_element {
+    uint32_t attribute;
+    int32_t size;
+    uint32_t type;
+    uint32_t normalized;
+    int32_t offset;
+};
+
+// the contents of a mesh file, pointing into its bytes
+struct mesh_file_view {
+    const mesh_file_header* header;
+    vertex_format format;
+    const unsigned char* vertices;
+    const unsigned char* indices;
+    bounds model_bounds;
+};
+
+bool save_mesh_file(const std::string& path, const geometry_data& data);
+
+// Checks the header, the vertex format, that the blobs lie in the bytes and
+// that the vertices and the indices drawn lie in the blobs, prints why it fails.
+bool read_mesh_file(const unsigned char* bytes, size_t size, mesh_file_view& view);
+
+// Maps a file written by save_mesh_file and fills the buffers of a geometry
+// directly from the mapping, nullptr on failure.
+std::unique_ptr<geometry<float>> load_mesh_file(const std::string& path);
+
+template<class T>
+bool save_mesh_file(const std::string& path, geometry_builder<T>& builder, const vertex_format& format)
+{
+    return save_mesh_file(path, builder.build_data(format));
+}
+
+template<class T>
+bool save_mesh_file(const std::string& path, geometry_builder<T>& builder)
+{
+    return save_mesh_file(path, builder, builder.default_format());
+}
+
+}
+
+#endif
@@ -0,0 +1,824 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+
+#include "mesh_file.hpp"
+#include "mesh_import.hpp"
+#include "parallel.hpp"
+
+using namespace yae;
+
+namespace {
+
+// files are split in ranges of at least this many bytes
+const size_t min_chunk_bytes = 1 << 20;
+// vertices per chunk of binary PLY
+const size_t vertex_grain = 65536;
+
+const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+inline bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline void skip_blanks(const char*& p, const char* end)
+{
+    while (p < end && is_blank(*p)) {
+        p++;
+    }
+}
+
+inline const char* line_end(const char* p, const char* end)
+{
+    const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+    return nl != nullptr ? nl : end;
+}
+
+// Decimal to float without strtod, which is locale dependent and needs
+// a terminated string. Mantissas of up to 19 digits scaled by a power of
+// ten both exactly representable as doubles give the correctly rounded
+// double (Clinger's fast path), the rest falls back to strtod.
+bool parse_float(const char*& p, const char* end, float& value)
+{
+    skip_blanks(p, end);
+    const char* s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) {
+        negative = *s == '-';
+        s++;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any = false;
+    for (; s < end && is_digit(*s); s++, any = true) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*s - '0');
+            digits += mantissa != 0;
+        } else {
+            exponent++;
+        }
+    }
+    if (s < end && *s == '.') {
+        for (s++; s < end && is_digit(*s); s++, any = true) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*s - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+    if (!any) {
+        return false;
+    }
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        const char* e = s + 1;
+        bool negative_exponent = false;
+        if (e < end && (*e == '-' || *e == '+')) {
+            negative_exponent = *e == '-';
+            e++;
+        }
+        if (e < end && is_digit(*e)) {
+            int n = 0;
+            for (; e < end && is_digit(*e); e++) {
+                n = std::min(n * 10 + (*e - '0'), 100000);
+            }
+            exponent += negative_exponent ? -n : n;
+            s = e;
+        }
+    }
+    double d;
+    if (mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+        d = static_cast<double>(mantissa);
+        d = exponent < 0 ? d / powers_of_ten[-exponent] : d * powers_of_ten[exponent];
+        d = negative ? -d : d;
+    } else {
+        char buffer[64];
+        size_t n = std::min<size_t>(s - p, sizeof(buffer) - 1);
+        memcpy(buffer, p, n);
+        buffer[n] = '\0';
+        d = strtod(buffer, nullptr);
+    }
+    value = static_cast<float>(d);
+    p = s;
+    return true;
+}
+
+bool parse_int(const char*& p, const char* end, long& value)
+{
+    skip_blanks(p, end);
+    const char* s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) {
+        negative = *s == '-';
+        s++;
+    }
+    if (s == end || !is_digit(*s)) {
+        return false;
+    }
+    long n = 0;
+    for (; s < end && is_digit(*s); s++) {
+        n = n * 10 + (*s - '0');
+    }
+    value = negative ? -n : n;
+    p = s;
+    return true;
+}
+
+// the bounds of about count ranges of [begin, end), each ending after a new line
+std::vector<const char*> split_lines(const char* begin, const char* end)
+{
+    size_t size = end - begin;
+    size_t count = std::max<size_t>(1, std::min<size_t>(size / min_chunk_bytes, (thread_pool::instance().size() + 1) * 4));
+    std::vector<const char*> bounds(1, begin);
+    for (size_t i = 1; i < count; i++) {
+        const char* p = std::max(bounds.back(), begin + size / count * i);
+        p = line_end(p, end);
+        if (p + 1 >= end) {
+            break;
+        }
+        bounds.push_back(p + 1);
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+// the attributes and the triangles of a range of lines of an OBJ file
+struct obj_chunk {
+    std::vector<float> v;
+    std::vector<float> vt;
+    std::vector<float> vn;
+    // the v, vt and vn indices of the corners of the triangles, -1 when missing
+    std::vector<int> corners;
+    // the corners given relative to the end of the chunk so far, the number
+    // of attributes read by the previous chunks is added once known
+    std::vector<size_t> relative;
+    bool has_vt = false;
+    bool has_vn = false;
+    const char* error = nullptr;
+};
+
+bool read_floats(const char*& p, const char* end, std::vector<float>& out, int required, int count)
+{
+    for (int i = 0; i < count; i++) {
+        float f = 0.0f;
+        if (!parse_float(p, end, f) && i < required) {
+            return false;
+        }
+        out.push_back(f);
+    }
+    return true;
+}
+
+void parse_obj_chunk(const char* p, const char* end, obj_chunk& c)
+{
+    std::vector<int> polygon;
+    std::vector<unsigned char> relative;
+    for (; p < end; p++) {
+        skip_blanks(p, end);
+        const char* e = line_end(p, end);
+        if (e - p >= 2 && p[0] == 'v' && is_blank(p[1])) {
+            if (!read_floats(++p, e, c.v, 3, 3)) {
+                c.error = p;
+                return;
+            }
+        } else if (e - p >= 3 && p[0] == 'v' && p[1] == 't' && is_blank(p[2])) {
+            p += 2;
+            if (!read_floats(p, e, c.vt, 1, 2)) {
+                c.error = p;
+                return;
+            }
+        } else if (e - p >= 3 && p[0] == 'v' && p[1] == 'n' && is_blank(p[2])) {
+            p += 2;
+            if (!read_floats(p, e, c.vn, 3, 3)) {
+                c.error = p;
+                return;
+            }
+        } else if (e - p >= 2 && p[0] == 'f' && is_blank(p[1])) {
+            polygon.clear();
+            relative.clear();
+            p++;
+            for (;;) {
+                skip_blanks(p, e);
+                if (p == e) {
+                    break;
+                }
+                // v, v/vt, v//vn or v/vt/vn
+                int corner[3] = { -1, -1, -1 };
+                unsigned char mask = 0;
+                const size_t counts[3] = { c.v.size() / 3, c.vt.size() / 2, c.vn.size() / 3 };
+                for (int k = 0; k < 3; k++) {
+                    long i;
+                    if (k > 0) {
+                        if (p == e || *p != '/') {
+                            break;
+                        }
+                        p++;
+                        if (p < e && *p == '/') {
+                            continue;
+                        }
+                    }
+                    if (!parse_int(p, e, i) || i == 0) {
+                        c.error = p;
+                        return;
+                    }
+                    corner[k] = i > 0 ? static_cast<int>(i - 1) : static_cast<int>(counts[k] + i);
+                    mask |= i < 0 ? 1 << k : 0;
+                }
+                c.has_vt |= corner[1] >= 0 || (mask & 2) != 0;
+                c.has_vn |= corner[2] >= 0 || (mask & 4) != 0;
+                polygon.insert(polygon.end(), corner, corner + 3);
+                relative.push_back(mask);
+            }
+            // a fan around the first corner
+            size_t n = relative.size();
+            size_t base = c.corners.size();
+            c.corners.resize(base + (std::max<size_t>(n, 2) - 2) * 9);
+            int* out = c.corners.data() + base;
+            for (size_t i = 2; i < n; i++) {
+                for (size_t j : { (size_t)0, i - 1, i }) {
+                    memcpy(out, &polygon[j * 3], 3 * sizeof(int));
+                    for (int k = 0; relative[j] != 0 && k < 3; k++) {
+                        if (relative[j] & (1 << k)) {
+                            c.relative.push_back(out - c.corners.data() + k);
+                        }
+                    }
+                    out += 3;
+                }
+            }
+        }
+        p = e;
+    }
+}
+
+enum class ply_type {
+    int8, uint8, int16, uint16, int32, uint32, float32, float64, invalid
+};
+
+size_t ply_type_size(ply_type type)
+{
+    switch (type) {
+    case ply_type::int8: case ply_type::uint8: return 1;
+    case ply_type::int16: case ply_type::uint16: return 2;
+    case ply_type::float64: return 8;
+    default: return 4;
+    }
+}
+
+ply_type parse_ply_type(const std::string& name)
+{
+    static const char* names[][2] = {
+        { "char", "int8" }, { "uchar", "uint8" }, { "short", "int16" }, { "ushort", "uint16" },
+        { "int", "int32" }, { "uint", "uint32" }, { "float", "float32" }, { "double", "float64" }
+    };
+    for (int i = 0; i < 8; i++) {
+        if (name == names[i][0] || name == names[i][1]) {
+            return static_cast<ply_type>(i);
+        }
+    }
+    return ply_type::invalid;
+}
+
+template<class V>
+V read_binary(const unsigned char* p, ply_type type, bool swap)
+{
+    unsigned char b[8];
+    size_t n = ply_type_size(type);
+    memcpy(b, p, n);
+    if (swap) {
+        std::reverse(b, b + n);
+    }
+    switch (type) {
+    case ply_type::int8: { int8_t v; memcpy(&v, b, 1); return static_cast<V>(v); }
+    case ply_type::uint8: { uint8_t v; memcpy(&v, b, 1); return static_cast<V>(v); }
+    case ply_type::int16: { int16_t v; memcpy(&v, b, 2); return static_cast<V>(v); }
+    case ply_type::uint16: { uint16_t v; memcpy(&v, b, 2); return static_cast<V>(v); }
+    case ply_type::int32: { int32_t v; memcpy(&v, b, 4); return static_cast<V>(v); }
+    case ply_type::uint32: { uint32_t v; memcpy(&v, b, 4); return static_cast<V>(v); }
+    case ply_type::float32: { float v; memcpy(&v, b, 4); return static_cast<V>(v); }
+    case ply_type::float64: { double v; memcpy(&v, b, 8); return static_cast<V>(v); }
+    default: return V();
+    }
+}
+
+struct ply_property {
+    std::string name;
+    ply_type type;
+    ply_type count_type; // invalid unless a list
+    // where the vertex property goes, 0 to 2 positions, 3 to 5 normals, 6 and 7 tex coords
+    int target;
+};
+
+struct ply_element {
+    std::string name;
+    size_t count;
+    std::vector<ply_property> properties;
+
+    // size of an element of a binary file, 0 when it holds lists
+    size_t binary_size() const
+    {
+        size_t size = 0;
+        for (auto& p : properties) {
+            if (p.count_type != ply_type::invalid) {
+                return 0;
+            }
+            size += ply_type_size(p.type);
+        }
+        return size;
+    }
+};
+
+int ply_vertex_target(const std::string& name)
+{
+    static const char* names[][3] = {
+        { "x", "x", "x" }, { "y", "y", "y" }, { "z", "z", "z" },
+        { "nx", "nx", "nx" }, { "ny", "ny", "ny" }, { "nz", "nz", "nz" },
+        { "u", "s", "texture_u" }, { "v", "t", "texture_v" }
+    };
+    for (int i = 0; i < 8; i++) {
+        if (name == names[i][0] || name == names[i][1] || name == names[i][2]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+struct ply_header {
+    enum { ascii, little_endian, big_endian } format;
+    std::vector<ply_element> elements;
+    size_t size;
+};
+
+bool parse_ply_header(const char* bytes, size_t size, ply_header& header)
+{
+    const char* end = bytes + size;
+    const char* p = bytes;
+    bool has_format = false;
+    header.format = ply_header::ascii;
+    for (int line = 0; p < end; line++) {
+        const char* e = line_end(p, end);
+        std::istringstream tokens(std::string(p, e));
+        p = e + 1;
+        std::string keyword;
+        tokens >> keyword;
+        if (line == 0) {
+            if (keyword != "ply") {
+                printf("Not a PLY file\n");
+                return false;
+            }
+        } else if (keyword == "format") {
+            std::string format;
+            tokens >> format;
+            has_format = true;
+            if (format == "ascii") {
+                header.format = ply_header::ascii;
+            } else if (format == "binary_little_endian") {
+                header.format = ply_header::little_endian;
+            } else if (format == "binary_big_endian") {
+                header.format = ply_header::big_endian;
+            } else {
+                has_format = false;
+            }
+        } else if (keyword == "element") {
+            ply_element element;
+            tokens >> element.name >> element.count;
+            header.elements.push_back(element);
+        } else if (keyword == "property" && !header.elements.empty()) {
+            ply_property property;
+            std::string type;
+            tokens >> type;
+            property.count_type = ply_type::invalid;
+            if (type == "list") {
+                std::string count_type;
+                tokens >> count_type >> type;
+                property.count_type = parse_ply_type(count_type);
+                if (property.count_type == ply_type::invalid) {
+                    printf("Unknown PLY type %s\n", count_type.c_str());
+                    return false;
+                }
+            }
+            tokens >> property.name;
+            property.type = parse_ply_type(type);
+            if (property.type == ply_type::invalid) {
+                printf("Unknown PLY type %s\n", type.c_str());
+                return false;
+            }
+            property.target = header.elements.back().name == "vertex" && property.count_type == ply_type::invalid
+                ? ply_vertex_target(property.name) : -1;
+            header.elements.back().properties.push_back(property);
+        } else if (keyword == "end_header") {
+            if (!has_format) {
+                printf("Unsupported PLY format\n");
+                return false;
+            }
+            header.size = std::min<size_t>(p - bytes, size);
+            return true;
+        }
+    }
+    printf("PLY header truncated\n");
+    return false;
+}
+
+inline bool is_face_indices(const ply_property& p)
+{
+    return p.count_type != ply_type::invalid && (p.name == "vertex_indices" || p.name == "vertex_index");
+}
+
+// fan triangles of a polygon of count vertices
+inline void append_fan(const long* polygon, size_t count, std::vector<GLuint>& indices)
+{
+    size_t base = indices.size();
+    indices.resize(base + (std::max<size_t>(count, 2) - 2) * 3);
+    GLuint* out = indices.data() + base;
+    for (size_t i = 2; i < count; i++) {
+        *out++ = static_cast<GLuint>(polygon[0]);
+        *out++ = static_cast<GLuint>(polygon[i - 1]);
+        *out++ = static_cast<GLuint>(polygon[i]);
+    }
+}
+
+// the arrays of the vertex properties of the mesh, 3 or 2 components each
+struct vertex_targets {
+    vertex_targets(imported_mesh& mesh, const ply_element& vertices)
+    {
+        bool present[3] = { false, false, false };
+        for (auto& p : vertices.properties) {
+            if (p.target >= 0) {
+                present[p.target < 3 ? 0 : p.target < 6 ? 1 : 2] = true;
+            }
+        }
+        mesh.positions.assign(vertices.count * 3, 0.0f);
+        mesh.normals.assign(present[1] ? vertices.count * 3 : 0, 0.0f);
+        mesh.tex_coords.assign(present[2] ? vertices.count * 2 : 0, 0.0f);
+        arrays[0] = mesh.positions.data();
+        arrays[1] = mesh.normals.data();
+        arrays[2] = mesh.tex_coords.data();
+    }
+
+    inline float& get(size_t vertex, int target)
+    {
+        return target < 3 ? arrays[0][vertex * 3 + target]
+            : target < 6 ? arrays[1][vertex * 3 + target - 3]
+            : arrays[2][vertex * 2 + target - 6];
+    }
+
+    float* arrays[3];
+};
+
+bool import_binary_ply(const ply_header& header, const unsigned char* p, const unsigned char* end, imported_mesh& mesh)
+{
+    const uint16_t one = 1;
+    bool little_endian = *reinterpret_cast<const unsigned char*>(&one) == 1;
+    bool swap = (header.format == ply_header::little_endian) != little_endian;
+    bool truncated = false;
+    for (auto& element : header.elements) {
+        size_t element_size = element.binary_size();
+        if (element.name == "vertex" && element_size > 0) {
+            if ((size_t)(end - p) / element_size < element.count) {
+                truncated = true;
+                break;
+            }
+            // fixed size vertices, decoded in parallel
+            vertex_targets targets(mesh, element);
+            parallel_for(0, element.count, vertex_grain, [&](size_t begin, size_t chunk_end) {
+                for (size_t v = begin; v < chunk_end; v++) {
+                    const unsigned char* q = p + v * element_size;
+                    for (auto& property : element.properties) {
+                        if (property.target >= 0) {
+                            targets.get(v, property.target) = read_binary<float>(q, property.type, swap);
+                        }
+                        q += ply_type_size(property.type);
+                    }
+                }
+            });
+            p += element.count * element_size;
+            continue;
+        }
+        // elements holding lists are walked one at a time
+        bool faces = element.name == "face";
+        if (faces) {
+            mesh.indices.reserve(element.count * 3);
+        }
+        std::unique_ptr<vertex_targets> targets;
+        if (element.name == "vertex") {
+            targets.reset(new vertex_targets(mesh, element));
+        }
+        std::vector<long> polygon;
+        for (size_t i = 0; i < element.count && !truncated; i++) {
+            for (auto& property : element.properties) {
+                size_t value_size = ply_type_size(property.type);
+                bool list = property.count_type != ply_type::invalid;
+                size_t count_size = list ? ply_type_size(property.count_type) : 0;
+                if ((size_t)(end - p) < count_size) {
+                    truncated = true;
+                    break;
+                }
+                size_t count = list ? read_binary<size_t>(p, property.count_type, swap) : 1;
+                p += count_size;
+                if ((size_t)(end - p) / value_size < count) {
+                    truncated = true;
+                    break;
+                }
+                if (faces && is_face_indices(property)) {
+                    polygon.resize(count);
+                    for (size_t k = 0; k < count; k++) {
+                        polygon[k] = read_binary<long>(p + k * value_size, property.type, swap);
+                    }
+                    append_fan(polygon.data(), count, mesh.indices);
+                } else if (targets && property.target >= 0) {
+                    targets->get(i, property.target) = read_binary<float>(p, property.type, swap);
+                }
+                p += count * value_size;
+            }
+        }
+        if (truncated) {
+            break;
+        }
+    }
+    if (truncated) {
+        printf("PLY data truncated\n");
+        return false;
+    }
+    return true;
+}
+
+// ranges of lines of an ascii element, parsed into chunk local arrays
+struct ascii_chunk {
+    std::vector<float> values; // the targets of the vertices, 8 per vertex
+    std::vector<GLuint> indices;
+    bool error = false;
+};
+
+void parse_ascii_lines(const ply_element& element, const char* p, const char* end, ascii_chunk& c)
+{
+    bool faces = element.name == "face";
+    std::vector<long> polygon;
+    for (; p < end; p++) {
+        const char* e = line_end(p, end);
+        float vertex[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+        for (auto& property : element.properties) {
+            if (property.count_type == ply_type::invalid) {
+                float value;
+                if (!parse_float(p, e, value)) {
+                    c.error = true;
+                    return;
+                }
+                if (property.target >= 0) {
+                    vertex[property.target] = value;
+                }
+                continue;
+            }
+            long count;
+            if (!parse_int(p, e, count) || count < 0) {
+                c.error = true;
+                return;
+            }
+            polygon.resize(count);
+            for (long k = 0; k < count; k++) {
+                float value;
+                bool read = faces ? parse_int(p, e, polygon[k]) : parse_float(p, e, value);
+                if (!read) {
+                    c.error = true;
+                    return;
+                }
+            }
+            if (faces && is_face_indices(property)) {
+                append_fan(polygon.data(), count, c.indices);
+            }
+        }
+        if (element.name == "vertex") {
+            c.values.insert(c.values.end(), vertex, vertex + 8);
+        }
+        p = e;
+    }
+}
+
+bool import_ascii_ply(const ply_header& header, const char* p, const char* end, imported_mesh& mesh)
+{
+    for (auto& element : header.elements) {
+        // the lines of the element
+        const char* begin = p;
+        for (size_t i = 0; i < element.count && p < end; i++) {
+            p = line_end(p, end) + 1;
+        }
+        p = std::min(p, end);
+        if (element.name != "vertex" && element.name != "face") {
+            continue;
+        }
+        std::vector<const char*> bounds = split_lines(begin, p);
+        std::vector<ascii_chunk> chunks(bounds.size() - 1);
+        parallel_for(0, chunks.size(), 1, [&](size_t chunk_begin, size_t chunk_end) {
+            for (size_t i = chunk_begin; i < chunk_end; i++) {
+                parse_ascii_lines(element, bounds[i], bounds[i + 1], chunks[i]);
+            }
+        });
+        if (element.name == "face") {
+            for (auto& c : chunks) {
+                if (c.error) {
+                    printf("Malformed PLY face\n");
+                    return false;
+                }
+                mesh.indices.insert(mesh.indices.end(), c.indices.begin(), c.indices.end());
+            }
+            continue;
+        }
+        size_t vertex = 0;
+        vertex_targets targets(mesh, element);
+        for (auto& c : chunks) {
+            if (c.error) {
+                printf("Malformed PLY vertex\n");
+                return false;
+            }
+            for (size_t i = 0; i < c.values.size() && vertex < element.count; i += 8, vertex++) {
+                for (auto& property : element.properties) {
+                    if (property.target >= 0) {
+                        targets.get(vertex, property.target) = c.values[i + property.target];
+                    }
+                }
+            }
+        }
+        if (vertex < element.count) {
+            printf("PLY data truncated\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+bool yae::import_obj(const char* text, size_t size, imported_mesh& mesh)
+{
+    std::vector<const char*> bounds = split_lines(text, text + size);
+    std::vector<obj_chunk> chunks(bounds.size() - 1);
+    parallel_for(0, chunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            parse_obj_chunk(bounds[i], bounds[i + 1], chunks[i]);
+        }
+    });
+
+    // resolves the relative indices and merges the chunks
+    size_t counts[3] = { 0, 0, 0 };
+    size_t corner_count = 0;
+    bool has_vt = false;
+    bool has_vn = false;
+    for (auto& c : chunks) {
+        if (c.error != nullptr) {
+            const char* e = line_end(c.error, text + size);
+            const char* b = c.error;
+            while (b > text && b[-1] != '\n') {
+                b--;
+            }
+            printf("Malformed OBJ line: %s\n", std::string(b, e).c_str());
+            return false;
+        }
+        for (size_t i : c.relative) {
+            c.corners[i] += static_cast<int>(counts[i % 3]);
+        }
+        counts[0] += c.v.size() / 3;
+        counts[1] += c.vt.size() / 2;
+        counts[2] += c.vn.size() / 3;
+        corner_count += c.corners.size() / 3;
+        has_vt |= c.has_vt;
+        has_vn |= c.has_vn;
+    }
+    // concatenates an array of the chunks, freeing them on the way
+    auto gather = [&](std::vector<float>& out, std::vector<float> obj_chunk::* array) {
+        size_t size = 0;
+        for (auto& c : chunks) {
+            size += (c.*array).size();
+        }
+        out.reserve(size);
+        for (auto& c : chunks) {
+            out.insert(out.end(), (c.*array).begin(), (c.*array).end());
+            c.*array = std::vector<float>();
+        }
+    };
+    // -1 stands for a missing tex coord or normal
+    auto in_range = [&](const int* corner) {
+        return corner[0] >= 0 && corner[0] < (long)counts[0] && corner[1] >= -1 && corner[1] < (long)counts[1]
+            && corner[2] >= -1 && corner[2] < (long)counts[2];
+    };
+    std::vector<float> v;
+    gather(v, &obj_chunk::v);
+    if (!has_vt && !has_vn) {
+        mesh.positions.swap(v);
+        mesh.normals.clear();
+        mesh.tex_coords.clear();
+        mesh.indices.resize(corner_count);
+        GLuint* out = mesh.indices.data();
+        for (auto& c : chunks) {
+            for (size_t i = 0; i < c.corners.size(); i += 3) {
+                if (!in_range(&c.corners[i])) {
+                    printf("OBJ index out of range\n");
+                    return false;
+                }
+                *out++ = static_cast<GLuint>(c.corners[i]);
+            }
+            c.corners = std::vector<int>();
+        }
+        return true;
+    }
+    std::vector<int> corners;
+    corners.reserve(corner_count * 3);
+    for (auto& c : chunks) {
+        corners.insert(corners.end(), c.corners.begin(), c.corners.end());
+        c.corners = std::vector<int>();
+    }
+    for (size_t i = 0; i < corners.size(); i += 3) {
+        if (!in_range(&corners[i])) {
+            printf("OBJ index out of range\n");
+            return false;
+        }
+    }
+    // a vertex per distinct triple of indices
+    std::vector<float> vt;
+    std::vector<float> vn;
+    gather(vt, &obj_chunk::vt);
+    gather(vn, &obj_chunk::vn);
+    std::vector<GLuint> first;
+    weld_vertices(corners.data(), corner_count, 3 * sizeof(int), mesh.indices, first);
+    mesh.positions.resize(first.size() * 3);
+    mesh.tex_coords.assign(has_vt ? first.size() * 2 : 0, 0.0f);
+    mesh.normals.assign(has_vn ? first.size() * 3 : 0, 0.0f);
+    for (size_t u = 0; u < first.size(); u++) {
+        const int* corner = &corners[first[u] * 3];
+        memcpy(&mesh.positions[u * 3], &v[corner[0] * 3], 3 * sizeof(float));
+        if (has_vt && corner[1] >= 0) {
+            memcpy(&mesh.tex_coords[u * 2], &vt[corner[1] * 2], 2 * sizeof(float));
+        }
+        if (has_vn && corner[2] >= 0) {
+            memcpy(&mesh.normals[u * 3], &vn[corner[2] * 3], 3 * sizeof(float));
+        }
+    }
+    return true;
+}
+
+bool yae::import_ply(const char* bytes, size_t size, imported_mesh& mesh)
+{
+    ply_header header;
+    if (!parse_ply_header(bytes, size, header)) {
+        return false;
+    }
+    mesh = imported_mesh();
+    bool imported = header.format == ply_header::ascii
+        ? import_ascii_ply(header, bytes + header.size, bytes + size, mesh)
+        : import_binary_ply(header, reinterpret_cast<const unsigned char*>(bytes) + header.size,
+            reinterpret_cast<const unsigned char*>(bytes) + size, mesh);
+    if (!imported) {
+        return false;
+    }
+    size_t vertex_count = mesh.positions.size() / 3;
+    for (GLuint i : mesh.indices) {
+        if (i >= vertex_count) {
+            printf("PLY index out of range\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool yae::import_mesh(const std::string& path, imported_mesh& mesh)
+{
+    std::string extension = path.substr(std::min(path.size(), path.rfind('.')));
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower(c); });
+    if (extension != ".obj" && extension != ".ply") {
+        printf("Unsupported mesh file %s\n", path.c_str());
+        return false;
+    }
+    mapped_file file;
+    if (!file.open(path)) {
+        printf("Cannot map %s\n", path.c_str());
+        return false;
+    }
+    const char* bytes = reinterpret_cast<const char*>(file.data());
+    return extension == ".obj" ? import_obj(bytes, file.size(), mesh) : import_ply(bytes, file.size(), mesh);
+}
+
+geometry_builder<float> yae::make_builder(imported_mesh mesh)
+{
+    geometry_builder<float> geomb(3, GL_TRIANGLES);
+    geomb.append(mesh.positions);
+    geomb.set_indices(std::move(mesh.indices));
+    if (!mesh.normals.empty()) {
+        geomb.set_normals(std::move(mesh.normals));
+    }
+    if (!mesh.tex_coords.empty()) {
+        geomb.set_tex_coords(std::move(mesh.tex_coords), 2);
+    }
+    return geomb;
+}
@@ -0,0 +1,40 @@
+#ifndef _mesh_import_hpp_
+#define _mesh_import_hpp_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "geometry.hpp"
+
+namespace yae {
+
+// an indexed triangle mesh read from a file
+struct imported_mesh {
+    std::vector<float> positions; // 3 per vertex
+    std::vector<float> normals; // 3 per vertex, empty when the file has none
+    std::vector<float> tex_coords; // 2 per vertex, empty when the file has none
+    std::vector<GLuint> indices; // 3 per triangle, polygons are split in fans
+};
+
+// Wavefront OBJ, the v, vt, vn and f statements. Vertices with the same
+// position, tex coord and normal indices are merged.
+bool import_obj(const char* text, size_t size, imported_mesh& mesh);
+
+// PLY, ascii or binary in either byte order. The x, y, z, nx, ny, nz and
+// u, v (or s, t) properties of the vertices and the vertex_indices of the
+// faces are read, the other properties and elements are skipped.
+bool import_ply(const char* bytes, size_t size, imported_mesh& mesh);
+
+// Maps the file and imports it according to its extension, .obj or .ply.
+// Large files are parsed in parallel ranges of lines or vertices.
+bool import_mesh(const std::string& path, imported_mesh& mesh);
+
+// an indexed triangle builder of the mesh, see geometry_builder::set_indices
+geometry_builder<float> make_builder(imported_mesh mesh);
+
+}
+
+#endif
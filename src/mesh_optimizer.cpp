@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <cmath>
+
+#include "mesh_optimizer.hpp"
+
+using namespace yae;
+
+vertex_cache_statistics yae::analyze_vertex_cache(const std::vector<GLuint>& indices, size_t vertex_count, size_t cache_size)
+{
+    // FIFO cache, as most hardware implements
+    std::vector<size_t> timestamps(vertex_count, 0);
+    size_t time = cache_size + 1;
+    size_t misses = 0;
+    for (GLuint i : indices) {
+        if (time - timestamps[i] > cache_size) {
+            timestamps[i] = time++;
+            misses++;
+        }
+    }
+    vertex_cache_statistics stats;
+    size_t triangle_count = indices.size() / 3;
+    stats.acmr = triangle_count > 0 ? (float)misses / triangle_count : 0.0f;
+    stats.atvr = vertex_count > 0 ? (float)misses / vertex_count : 0.0f;
+    return stats;
+}
+
+namespace {
+
+const int forsyth_cache_size = 32;
+const int max_valence = 32;
+
+struct vertex_scores {
+
+    vertex_scores()
+    {
+        for (int i = 0; i < forsyth_cache_size; i++) {
+            cache[i] = i < 3 ? 0.75f : std::pow(1.0f - (float)(i - 3) / (forsyth_cache_size - 3), 1.5f);
+        }
+        valence[0] = 0.0f;
+        for (int i = 1; i < max_valence; i++) {
+            valence[i] = 2.0f / std::sqrt((float)i);
+        }
+    }
+
+    float get(int cache_position, unsigned int remaining) const
+    {
+        if (remaining == 0) {
+            return -1.0f;
+        }
+        float score = cache_position >= 0 ? cache[cache_position] : 0.0f;
+        return score + valence[std::min<unsigned int>(remaining, max_valence - 1)];
+    }
+
+    float cache[forsyth_cache_size];
+    float valence[max_valence];
+};
+
+}
+
+void yae::optimize_vertex_cache(std::vector<GLuint>& indices, size_t vertex_count)
+{
+    static const vertex_scores scores;
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    // triangles using each vertex, the first remaining[v] are not emitted yet
+    std::vector<GLuint> remaining(vertex_count, 0);
+    for (GLuint i : indices) {
+        remaining[i]++;
+    }
+    std::vector<size_t> offsets(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; v++) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+    std::vector<GLuint> adjacency(indices.size());
+    {
+        std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangle_count; t++) {
+            for (int k = 0; k < 3; k++) {
+                adjacency[fill[indices[t * 3 + k]]++] = static_cast<GLuint>(t);
+            }
+        }
+    }
+
+    std::vector<int> cache_position(vertex_count, -1);
+    std::vector<float> vertex_score(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++) {
+        vertex_score[v] = scores.get(-1, remaining[v]);
+    }
+    std::vector<float> triangle_score(triangle_count);
+    std::vector<bool> emitted(triangle_count, false);
+    size_t best = 0;
+    for (size_t t = 0; t < triangle_count; t++) {
+        triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+        if (triangle_score[t] > triangle_score[best]) {
+            best = t;
+        }
+    }
+
+    std::vector<GLuint> result;
+    result.reserve(indices.size());
+    std::vector<GLuint> cache;
+    std::vector<GLuint> new_cache;
+    size_t next_candidate = 0;
+    for (;;) {
+        const GLuint* tri = &indices[best * 3];
+        result.insert(result.end(), tri, tri + 3);
+        emitted[best] = true;
+
+        for (int k = 0; k < 3; k++) {
+            GLuint v = tri[k];
+            GLuint* begin = &adjacency[offsets[v]];
+            GLuint* end = begin + remaining[v];
+            GLuint* it = std::find(begin, end, static_cast<GLuint>(best));
+            std::swap(*it, *(end - 1));
+            remaining[v]--;
+        }
+
+        // the vertices of the triangle move to the front of the cache
+        new_cache.assign(tri, tri + 3);
+        for (GLuint v : cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                new_cache.push_back(v);
+            }
+        }
+        for (size_t i = 0; i < new_cache.size(); i++) {
+            GLuint v = new_cache[i];
+            cache_position[v] = i < (size_t)forsyth_cache_size ? (int)i : -1;
+            float score = scores.get(cache_position[v], remaining[v]);
+            float delta = score - vertex_score[v];
+            vertex_score[v] = score;
+            for (size_t a = offsets[v]; a < offsets[v] + remaining[v]; a++) {
+                triangle_score[adjacency[a]] += delta;
+            }
+        }
+        if (new_cache.size() > (size_t)forsyth_cache_size) {
+            new_cache.resize(forsyth_cache_size);
+        }
+        cache.swap(new_cache);
+
+        // the next triangle is the best one using a cached vertex
+        float best_score = -1.0f;
+        bool found = false;
+        for (GLuint v : cache) {
+            for (size_t a = offsets[v]; a < offsets[v] + remaining[v]; a++) {
+                GLuint t = adjacency[a];
+                if (triangle_score[t] > best_score) {
+                    best_score = triangle_score[t];
+                    best = t;
+                    found = true;
+                }
+            }
+        }
+        if (!found) {
+            while (next_candidate < triangle_count && emitted[next_candidate]) {
+                next_candidate++;
+            }
+            if (next_candidate == triangle_count) {
+                break;
+            }
+            best = next_candidate;
+        }
+    }
+    indices.swap(result);
+}
+
+void yae::optimize_overdraw(std::vector<GLuint>& indices, const std::vector<float>& positions, size_t vertex_count)
+{
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    // a new cluster starts where the cache gets flushed, that is
+    // at triangles whose three vertices are all cache misses
+    std::vector<size_t> clusters;
+    std::vector<size_t> timestamps(vertex_count, 0);
+    size_t time = simulated_cache_size + 1;
+    for (size_t t = 0; t < triangle_count; t++) {
+        int misses = 0;
+        for (int k = 0; k < 3; k++) {
+            GLuint v = indices[t * 3 + k];
+            if (time - timestamps[v] > simulated_cache_size) {
+                timestamps[v] = time++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3) {
+            clusters.push_back(t);
+        }
+    }
+    clusters.push_back(triangle_count);
+
+    float center[3] = { 0.0f, 0.0f, 0.0f };
+    for (size_t v = 0; v < vertex_count; v++) {
+        for (int c = 0; c < 3; c++) {
+            center[c] += positions[v * 3 + c] / vertex_count;
+        }
+    }
+
+    // sort key of a cluster, how much its area weighted normal points
+    // away from the mesh center
+    struct cluster {
+        size_t begin;
+        size_t end;
+        float key;
+    };
+    std::vector<cluster> sorted;
+    for (size_t i = 0; i + 1 < clusters.size(); i++) {
+        float area_normal[3] = { 0.0f, 0.0f, 0.0f };
+        float centroid[3] = { 0.0f, 0.0f, 0.0f };
+        float area = 0.0f;
+        for (size_t t = clusters[i]; t < clusters[i + 1]; t++) {
+            const float* p0 = &positions[indices[t * 3] * 3];
+            const float* p1 = &positions[indices[t * 3 + 1] * 3];
+            const float* p2 = &positions[indices[t * 3 + 2] * 3];
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            float a = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int c = 0; c < 3; c++) {
+                area_normal[c] += n[c];
+                centroid[c] += a * (p0[c] + p1[c] + p2[c]) / 3.0f;
+            }
+            area += a;
+        }
+        float key = 0.0f;
+        if (area > 0.0f) {
+            for (int c = 0; c < 3; c++) {
+                key += (centroid[c] / area - center[c]) * area_normal[c];
+            }
+            key /= area;
+        }
+        sorted.push_back(cluster{ clusters[i], clusters[i + 1], key });
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const cluster& c1, const cluster& c2) { return c1.key > c2.key; });
+
+    std::vector<GLuint> result;
+    result.reserve(indices.size());
+    for (auto& c : sorted) {
+        result.insert(result.end(), indices.begin() + c.begin * 3, indices.begin() + c.end * 3);
+    }
+    indices.swap(result);
+}
+
+void yae::optimize_vertex_fetch(std::vector<GLuint>& indices, size_t vertex_count, std::vector<GLuint>& order)
+{
+    const GLuint unused = ~0u;
+    std::vector<GLuint> remap(vertex_count, unused);
+    order.clear();
+    order.reserve(vertex_count);
+    for (GLuint& i : indices) {
+        if (remap[i] == unused) {
+            remap[i] = static_cast<GLuint>(order.size());
+            order.push_back(i);
+        }
+        i = remap[i];
+    }
+    // vertices that no triangle references are kept at the end
+    for (size_t v = 0; v < vertex_count; v++) {
+        if (remap[v] == unused) {
+            order.push_back(static_cast<GLuint>(v));
+        }
+    }
+}
+
+// the rotation of triangle t which continues a strip ending with x, y,
+// -1 if none; odd is the parity of the next triangle of the strip
+static int continuing_rotation(const GLuint* t, GLuint x, GLuint y, bool odd)
+{
+    for (int r = 0; r < 3; r++) {
+        GLuint t0 = t[r];
+        GLuint t1 = t[(r + 1) % 3];
+        if ((!odd && t0 == x && t1 == y) || (odd && t0 == y && t1 == x)) {
+            return r;
+        }
+    }
+    return -1;
+}
+
+void yae::stripify(const std::vector<GLuint>& indices, GLuint restart_index, std::vector<GLuint>& strip)
+{
+    size_t triangle_count = indices.size() / 3;
+    strip.clear();
+    strip.reserve(indices.size());
+    size_t length = 0; // triangles in the current strip
+    for (size_t t = 0; t < triangle_count; t++) {
+        const GLuint* tri = &indices[t * 3];
+        if (length > 0) {
+            int r = continuing_rotation(tri, strip[strip.size() - 2], strip.back(), length % 2 == 1);
+            if (r >= 0) {
+                strip.push_back(tri[(r + 2) % 3]);
+                length++;
+                continue;
+            }
+            strip.push_back(restart_index);
+        }
+        // starts with the rotation the next triangle can continue, if any
+        int start = 0;
+        if (t + 1 < triangle_count) {
+            for (int r = 0; r < 3; r++) {
+                if (continuing_rotation(&indices[(t + 1) * 3], tri[(r + 1) % 3], tri[(r + 2) % 3], true) >= 0) {
+                    start = r;
+                    break;
+                }
+            }
+        }
+        for (int k = 0; k < 3; k++) {
+            strip.push_back(tri[(start + k) % 3]);
+        }
+        length = 1;
+    }
+}
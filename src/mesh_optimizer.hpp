@@ -0,0 +1,44 @@
+#ifndef _mesh_optimizer_hpp_
+#define _mesh_optimizer_hpp_
+
+#include <vector>
+#include <cstddef>
+
+#include <GL/glew.h>
+
+namespace yae {
+
+// size of the FIFO post-transform cache used to measure the meshes
+const size_t simulated_cache_size = 16;
+
+struct vertex_cache_statistics {
+    float acmr; // average cache miss ratio, vertices transformed per triangle
+    float atvr; // average transformed vertex ratio, vertices transformed per vertex
+};
+
+vertex_cache_statistics analyze_vertex_cache(const std::vector<GLuint>& indices, size_t vertex_count,
+    size_t cache_size = simulated_cache_size);
+
+// Reorders the triangles of an indexed triangle list for the post-transform
+// vertex cache, cf Tom Forsyth's "Linear-Speed Vertex Cache Optimisation".
+void optimize_vertex_cache(std::vector<GLuint>& indices, size_t vertex_count);
+
+// Reorders the clusters of triangles produced by optimize_vertex_cache so that
+// the ones facing away from the center of the mesh are drawn first, which
+// lowers overdraw while keeping most of the cache efficiency, cf Sander et al.
+// "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Tipsify).
+// positions holds 3 floats per vertex.
+void optimize_overdraw(std::vector<GLuint>& indices, const std::vector<float>& positions, size_t vertex_count);
+
+// Renumbers the vertices in the order they are first referenced by indices,
+// fills order with the previous number of each vertex (order[new] = old).
+void optimize_vertex_fetch(std::vector<GLuint>& indices, size_t vertex_count, std::vector<GLuint>& order);
+
+// Converts an indexed triangle list to triangle strips separated by
+// restart_index, to be drawn with primitive restart. The triangles are
+// taken in order so a list optimized for the vertex cache stays so.
+void stripify(const std::vector<GLuint>& indices, GLuint restart_index, std::vector<GLuint>& strip);
+
+}
+
+#endif
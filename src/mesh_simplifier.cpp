@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+
+#include "matrix.hpp"
+#include "mesh_simplifier.hpp"
+
+using namespace yae;
+
+namespace {
+
+// the plane quadrics of the border edges weigh more than those of the faces
+const double border_weight = 10.0;
+
+// the symmetric matrix of the sum of the squared distances to planes,
+// aa ab ac ad bb bc bd cc cd dd
+struct quadric {
+    double q[10];
+};
+
+void add_plane(quadric& m, const vector3<double>& n, double d, double w)
+{
+    double a = n.x();
+    double b = n.y();
+    double c = n.z();
+    double p[10] = { a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d };
+    for (int i = 0; i < 10; i++) {
+        m.q[i] += w * p[i];
+    }
+}
+
+double evaluate(const quadric& m, const quadric& n, const vector3<double>& v)
+{
+    double q[10];
+    for (int i = 0; i < 10; i++) {
+        q[i] = m.q[i] + n.q[i];
+    }
+    double x = v.x();
+    double y = v.y();
+    double z = v.z();
+    return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+        + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+        + q[7] * z * z + 2 * q[8] * z + q[9];
+}
+
+struct collapse {
+    float cost;
+    GLuint from;
+    GLuint to;
+    unsigned int from_version;
+    unsigned int to_version;
+    // the cheapest on top of the queue
+    bool operator<(const collapse& c) const { return cost > c.cost; }
+};
+
+struct simplifier {
+    std::vector<GLuint>& indices;
+    std::vector<vector3<double>> positions;
+    std::vector<quadric> quadrics;
+    std::vector<std::vector<GLuint>> triangles_of; // the triangles around each vertex, dead ones included
+    std::vector<bool> dead;
+    std::vector<unsigned int> versions;
+    std::priority_queue<collapse> queue;
+
+    simplifier(std::vector<GLuint>& indices) : indices(indices) {}
+
+    inline const GLuint* triangle(GLuint t) const { return &indices[t * 3]; }
+
+    inline bool has_vertex(GLuint t, GLuint v) const
+    {
+        const GLuint* tri = triangle(t);
+        return tri[0] == v || tri[1] == v || tri[2] == v;
+    }
+
+    vector3<double> normal(GLuint t, GLuint replaced, const vector3<double>& by) const
+    {
+        const GLuint* tri = triangle(t);
+        vector3<double> p[3];
+        for (int k = 0; k < 3; k++) {
+            p[k] = tri[k] == replaced ? by : positions[tri[k]];
+        }
+        return cross_product(p[1] - p[0], p[2] - p[0]);
+    }
+
+    void push(GLuint from, GLuint to)
+    {
+        double cost = evaluate(quadrics[from], quadrics[to], positions[to]);
+        queue.push(collapse{ static_cast<float>(std::max(0.0, cost)), from, to, versions[from], versions[to] });
+    }
+
+    // the collapses of the edges around v, forgetting its dead triangles
+    void push_edges(GLuint v)
+    {
+        auto& around = triangles_of[v];
+        around.erase(std::remove_if(around.begin(), around.end(), [this](GLuint t) { return dead[t]; }), around.end());
+        for (GLuint t : around) {
+            for (int k = 0; k < 3; k++) {
+                GLuint u = triangle(t)[k];
+                if (u != v) {
+                    push(v, u);
+                    push(u, v);
+                }
+            }
+        }
+    }
+
+    void neighbors(GLuint v, std::vector<GLuint>& out) const
+    {
+        out.clear();
+        for (GLuint t : triangles_of[v]) {
+            if (!dead[t]) {
+                out.insert(out.end(), triangle(t), triangle(t) + 3);
+            }
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    }
+
+    // Refuses the collapses that flip a triangle, or that join two vertices
+    // sharing more neighbors than the triangles of their edge (which would
+    // pinch the surface into non manifold edges).
+    bool allowed(GLuint from, GLuint to, std::vector<GLuint>& a, std::vector<GLuint>& b) const
+    {
+        size_t shared = 0;
+        for (GLuint t : triangles_of[from]) {
+            if (dead[t]) {
+                continue;
+            }
+            if (has_vertex(t, to)) {
+                shared++;
+                continue;
+            }
+            vector3<double> before = normal(t, from, positions[from]);
+            vector3<double> after = normal(t, from, positions[to]);
+            if (dot_product(before, after) <= 0.0) {
+                return false;
+            }
+        }
+        neighbors(from, a);
+        neighbors(to, b);
+        std::vector<GLuint> common;
+        std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(common));
+        // from and to are among the common neighbors
+        return common.size() == shared + 2;
+    }
+
+    size_t apply(GLuint from, GLuint to)
+    {
+        size_t removed = 0;
+        for (GLuint t : triangles_of[from]) {
+            if (dead[t]) {
+                continue;
+            }
+            if (has_vertex(t, to)) {
+                dead[t] = true;
+                removed++;
+                continue;
+            }
+            GLuint* tri = &indices[t * 3];
+            for (int k = 0; k < 3; k++) {
+                if (tri[k] == from) {
+                    tri[k] = to;
+                }
+            }
+            triangles_of[to].push_back(t);
+        }
+        triangles_of[from].clear();
+        for (int i = 0; i < 10; i++) {
+            quadrics[to].q[i] += quadrics[from].q[i];
+        }
+        versions[from]++;
+        versions[to]++;
+        return removed;
+    }
+};
+
+}
+
+float yae::simplify(std::vector<GLuint>& indices, const std::vector<float>& positions, size_t vertex_count,
+    size_t target_index_count, float max_error)
+{
+    size_t triangle_count = indices.size() / 3;
+    simplifier s(indices);
+    s.positions.resize(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++) {
+        s.positions[v] = vector3<double>(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+    }
+    s.quadrics.assign(vertex_count, quadric{});
+    s.triangles_of.resize(vertex_count);
+    s.dead.assign(triangle_count, false);
+    s.versions.assign(vertex_count, 0);
+    // the planes of the faces, and the edges used by a single face
+    std::unordered_map<unsigned long long, int> edge_faces;
+    auto edge_key = [](GLuint a, GLuint b) {
+        return (static_cast<unsigned long long>(std::min(a, b)) << 32) | std::max(a, b);
+    };
+    for (GLuint t = 0; t < triangle_count; t++) {
+        const GLuint* tri = s.triangle(t);
+        vector3<double> n = s.normal(t, tri[0], s.positions[tri[0]]);
+        double norm = length(n);
+        for (int k = 0; k < 3; k++) {
+            s.triangles_of[tri[k]].push_back(t);
+            edge_faces[edge_key(tri[k], tri[(k + 1) % 3])]++;
+        }
+        if (norm > 0.0) {
+            n = n / norm;
+            double d = -dot_product(n, s.positions[tri[0]]);
+            for (int k = 0; k < 3; k++) {
+                add_plane(s.quadrics[tri[k]], n, d, 1.0);
+            }
+        }
+    }
+    for (GLuint t = 0; t < triangle_count; t++) {
+        const GLuint* tri = s.triangle(t);
+        vector3<double> face = s.normal(t, tri[0], s.positions[tri[0]]);
+        for (int k = 0; k < 3; k++) {
+            GLuint a = tri[k];
+            GLuint b = tri[(k + 1) % 3];
+            if (edge_faces[edge_key(a, b)] != 1) {
+                continue;
+            }
+            // the plane through the border, perpendicular to the face
+            vector3<double> n = cross_product(s.positions[b] - s.positions[a], face);
+            double norm = length(n);
+            if (norm > 0.0) {
+                n = n / norm;
+                double d = -dot_product(n, s.positions[a]);
+                add_plane(s.quadrics[a], n, d, border_weight);
+                add_plane(s.quadrics[b], n, d, border_weight);
+            }
+        }
+    }
+    for (GLuint t = 0; t < triangle_count; t++) {
+        const GLuint* tri = s.triangle(t);
+        for (int k = 0; k < 3; k++) {
+            s.push(tri[k], tri[(k + 1) % 3]);
+            s.push(tri[(k + 1) % 3], tri[k]);
+        }
+    }
+    size_t live = triangle_count;
+    float error = 0.0f;
+    std::vector<GLuint> a;
+    std::vector<GLuint> b;
+    while (live * 3 > target_index_count && !s.queue.empty()) {
+        collapse c = s.queue.top();
+        s.queue.pop();
+        if (c.from_version != s.versions[c.from] || c.to_version != s.versions[c.to]) {
+            continue;
+        }
+        if (c.cost > max_error) {
+            break;
+        }
+        if (!s.allowed(c.from, c.to, a, b)) {
+            continue;
+        }
+        live -= s.apply(c.from, c.to);
+        error = c.cost;
+        s.push_edges(c.to);
+    }
+    std::vector<GLuint> kept;
+    kept.reserve(live * 3);
+    for (GLuint t = 0; t < triangle_count; t++) {
+        if (!s.dead[t]) {
+            kept.insert(kept.end(), s.triangle(t), s.triangle(t) + 3);
+        }
+    }
+    indices.swap(kept);
+    return error;
+}
@@ -0,0 +1,25 @@
+#ifndef _mesh_simplifier_hpp_
+#define _mesh_simplifier_hpp_
+
+#include <cfloat>
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+namespace yae {
+
+// Simplifies an indexed triangle list by collapsing the edges of least quadric
+// error first, cf Garland and Heckbert "Surface Simplification Using Quadric
+// Error Metrics", until at most target_index_count indices remain or the next
+// collapse would cost more than max_error (about a squared distance).
+// An edge collapses onto one of its vertices, none is moved or created, so the
+// other attributes stay valid. Open borders, e.g. texture seams of welded
+// meshes, are kept in place by penalizing the collapses that move them.
+// positions holds 3 floats per vertex. Returns the error of the last collapse.
+float simplify(std::vector<GLuint>& indices, const std::vector<float>& positions, size_t vertex_count,
+    size_t target_index_count, float max_error = FLT_MAX);
+
+}
+
+#endif
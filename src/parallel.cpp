@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <exception>
+
+#include "parallel.hpp"
+
+using namespace yae;
+
+static thread_local bool worker_thread = false;
+
+thread_pool::thread_pool(unsigned int thread_count)
+    : _stopping(false)
+{
+    for (unsigned int i = 0; i < thread_count; i++) {
+        _threads.emplace_back([this]() { work(); });
+    }
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _cv.notify_all();
+    for (auto& t : _threads) {
+        t.join();
+    }
+}
+
+std::future<void> thread_pool::submit(std::function<void()> task)
+{
+    std::packaged_task<void()> pt(task);
+    std::future<void> f = pt.get_future();
+    if (_threads.empty()) {
+        pt();
+        return f;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.push_back(std::move(pt));
+    }
+    _cv.notify_one();
+    return f;
+}
+
+void thread_pool::work()
+{
+    worker_thread = true;
+    for (;;) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+            if (_tasks.empty()) {
+                return;
+            }
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+        task();
+    }
+}
+
+bool thread_pool::in_worker_thread()
+{
+    return worker_thread;
+}
+
+thread_pool& thread_pool::instance()
+{
+    // the calling thread takes part in parallel_for, hence one less worker
+    static thread_pool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+void yae::parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& f)
+{
+    if (begin >= end) {
+        return;
+    }
+    size_t n = end - begin;
+    thread_pool& pool = thread_pool::instance();
+    size_t max_chunks = pool.size() + 1;
+    size_t chunks = std::min(max_chunks, (n + grain - 1) / std::max<size_t>(grain, 1));
+    if (chunks <= 1 || thread_pool::in_worker_thread()) {
+        f(begin, end);
+        return;
+    }
+    size_t chunk_size = (n + chunks - 1) / chunks;
+    std::vector<std::future<void>> futures;
+    for (size_t chunk_begin = begin + chunk_size; chunk_begin < end; chunk_begin += chunk_size) {
+        size_t chunk_end = std::min(end, chunk_begin + chunk_size);
+        futures.push_back(pool.submit([&f, chunk_begin, chunk_end]() { f(chunk_begin, chunk_end); }));
+    }
+    // every chunk must be done before f goes out of scope, even if one throws
+    std::exception_ptr error;
+    try {
+        f(begin, std::min(end, begin + chunk_size));
+    } catch (...) {
+        error = std::current_exception();
+    }
+    for (auto& future : futures) {
+        future.wait();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+}
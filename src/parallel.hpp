@@ -0,0 +1,40 @@
+#ifndef _parallel_hpp_
+#define _parallel_hpp_
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+namespace yae {
+
+class thread_pool {
+public:
+    thread_pool(unsigned int thread_count);
+    ~thread_pool();
+    std::future<void> submit(std::function<void()> task);
+    inline unsigned int size() const { return static_cast<unsigned int>(_threads.size()); }
+    static bool in_worker_thread();
+    static thread_pool& instance();
+private:
+    void work();
+    std::vector<std::thread> _threads;
+    std::deque<std::packaged_task<void()>> _tasks;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _stopping;
+    thread_pool(const thread_pool&);
+};
+
+// Calls f(chunk_begin, chunk_end) on disjoint chunks covering [begin, end),
+// using the calling thread and the shared pool. Ranges smaller than grain
+// and calls made from a pool thread run inline.
+void parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& f);
+
+}
+
+#endif
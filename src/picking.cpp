@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cmath>
+
+#include "parallel.hpp"
+#include "picking.hpp"
+
+using namespace yae;
+
+namespace {
+
+// triangles per task when computing their bounds
+const size_t bounds_grain = 16384;
+// below this determinant the ray is considered parallel to the triangle
+const float parallel_epsilon = 1e-12f;
+
+}
+
+triangle_bvh::triangle_bvh() : _stride(0) {}
+
+void triangle_bvh::build(const std::vector<float>& positions, const std::vector<GLuint>& indices)
+{
+    size_t count = indices.size() / 3;
+    std::vector<bounds> boxes(count);
+    parallel_for(0, count, bounds_grain, [&](size_t begin, size_t end) {
+        float points[9];
+        for (size_t t = begin; t < end; t++) {
+            for (int k = 0; k < 3; k++) {
+                std::copy_n(&positions[indices[t * 3 + k] * 3], 3, &points[k * 3]);
+            }
+            boxes[t] = bounds_of(points, 3);
+        }
+    });
+    _bvh.build(boxes);
+    // padded so that 4 triangles can be loaded from any of them, the padding
+    // is of degenerate triangles hit by no ray
+    _stride = count + 3;
+    _triangles.assign(_stride * 9, 0.0f);
+    const std::vector<GLuint>& order = _bvh.order();
+    parallel_for(0, count, bounds_grain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const GLuint* tri = &indices[order[i] * 3];
+            vector3f v0(&positions[tri[0] * 3]);
+            vector3f e1 = vector3f(&positions[tri[1] * 3]) - v0;
+            vector3f e2 = vector3f(&positions[tri[2] * 3]) - v0;
+            const vector3f* v[3] = { &v0, &e1, &e2 };
+            for (int k = 0; k < 3; k++) {
+                _triangles[(k * 3) * _stride + i] = v[k]->x();
+                _triangles[(k * 3 + 1) * _stride + i] = v[k]->y();
+                _triangles[(k * 3 + 2) * _stride + i] = v[k]->z();
+            }
+        }
+    });
+}
+
+float triangle_bvh::intersect_range(const ray& r, size_t first, size_t count, float max_distance, size_t& triangle) const
+{
+    // Moller Trumbore, cf http://www.graphics.cornell.edu/pubs/1997/MT97.pdf
+    const float* t = _triangles.data();
+    size_t s = _stride;
+#ifdef YAE_SSE
+    __m128 ox = _mm_set1_ps(r.origin.x());
+    __m128 oy = _mm_set1_ps(r.origin.y());
+    __m128 oz = _mm_set1_ps(r.origin.z());
+    __m128 dx = _mm_set1_ps(r.direction.x());
+    __m128 dy = _mm_set1_ps(r.direction.y());
+    __m128 dz = _mm_set1_ps(r.direction.z());
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 epsilon = _mm_set1_ps(parallel_epsilon);
+    __m128 sign = _mm_set1_ps(-0.0f);
+    for (size_t i = first; i < first + count; i += 4) {
+        __m128 e1x = _mm_loadu_ps(t + 3 * s + i);
+        __m128 e1y = _mm_loadu_ps(t + 4 * s + i);
+        __m128 e1z = _mm_loadu_ps(t + 5 * s + i);
+        __m128 e2x = _mm_loadu_ps(t + 6 * s + i);
+        __m128 e2y = _mm_loadu_ps(t + 7 * s + i);
+        __m128 e2z = _mm_loadu_ps(t + 8 * s + i);
+        // p = d x e2, det = e1 . p
+        __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+        __m128 inverse = _mm_div_ps(one, det);
+        // s = o - v0, u = s . p / det
+        __m128 sx = _mm_sub_ps(ox, _mm_loadu_ps(t + i));
+        __m128 sy = _mm_sub_ps(oy, _mm_loadu_ps(t + s + i));
+        __m128 sz = _mm_sub_ps(oz, _mm_loadu_ps(t + 2 * s + i));
+        __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverse);
+        // q = s x e1, v = d . q / det, distance = e2 . q / det
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+        __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverse);
+        __m128 d = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverse);
+        __m128 hit = _mm_cmpgt_ps(_mm_andnot_ps(sign, det), epsilon);
+        hit = _mm_and_ps(hit, _mm_cmpge_ps(u, zero));
+        hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+        hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), one));
+        hit = _mm_and_ps(hit, _mm_cmpge_ps(d, zero));
+        hit = _mm_and_ps(hit, _mm_cmplt_ps(d, _mm_set1_ps(max_distance)));
+        int mask = _mm_movemask_ps(hit);
+        if (first + count - i < 4) {
+            mask &= (1 << (first + count - i)) - 1;
+        }
+        if (mask == 0) {
+            continue;
+        }
+        alignas(16) float distances[4];
+        _mm_store_ps(distances, d);
+        for (int k = 0; k < 4; k++) {
+            if ((mask & (1 << k)) && distances[k] < max_distance) {
+                max_distance = distances[k];
+                triangle = _bvh.order()[i + k];
+            }
+        }
+    }
+#else
+    for (size_t i = first; i < first + count; i++) {
+        vector3f e1(t[3 * s + i], t[4 * s + i], t[5 * s + i]);
+        vector3f e2(t[6 * s + i], t[7 * s + i], t[8 * s + i]);
+        vector3f p = cross_product(r.direction, e2);
+        float det = dot_product(e1, p);
+        if (std::abs(det) <= parallel_epsilon) {
+            continue;
+        }
+        float inverse = 1.0f / det;
+        vector3f sv = r.origin - vector3f(t[i], t[s + i], t[2 * s + i]);
+        float u = dot_product(sv, p) * inverse;
+        vector3f q = cross_product(sv, e1);
+        float v = dot_product(r.direction, q) * inverse;
+        float d = dot_product(e2, q) * inverse;
+        if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && d >= 0.0f && d < max_distance) {
+            max_distance = d;
+            triangle = _bvh.order()[i];
+        }
+    }
+#endif
+    return max_distance;
+}
+
+bool triangle_bvh::intersect(const ray& r, float max_distance, size_t& triangle, float& distance) const
+{
+    bool found = false;
+    _bvh.raycast(r, max_distance, [&](size_t first, size_t count, float limit) {
+        float d = intersect_range(r, first, count, limit, triangle);
+        if (d < limit) {
+            found = true;
+            distance = d;
+        }
+        return d;
+    });
+    return found;
+}
+
+pickable_node::pickable_node(std::shared_ptr<node> drawn, std::shared_ptr<const triangle_bvh> triangles)
+    : _drawn(drawn), _triangles(triangles) {}
+
+void pickable_node::render(rendering_context& ctx)
+{
+    _drawn->render(ctx);
+}
+
+bounds pickable_node::get_bounds() const
+{
+    return _drawn->get_bounds();
+}
+
+bool pickable_node::intersect(const ray& r, ray_hit& hit)
+{
+    size_t triangle;
+    float distance;
+    if (!_triangles->intersect(r, hit.distance, triangle, distance)) {
+        return false;
+    }
+    hit.triangle = triangle;
+    hit.distance = distance;
+    return true;
+}
+
+ray_hit yae::pick(const std::shared_ptr<node>& root, const ray& r, float max_distance)
+{
+    ray_hit hit{ nullptr, 0, max_distance };
+    if (root->intersect(r, hit) && hit.hit_node == nullptr) {
+        hit.hit_node = root;
+    }
+    return hit;
+}
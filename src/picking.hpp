@@ -0,0 +1,80 @@
+#ifndef _picking_hpp_
+#define _picking_hpp_
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "bvh.hpp"
+#include "geometry.hpp"
+#include "yae.hpp"
+
+namespace yae {
+
+// A bvh of the triangles of a mesh for ray casts. The triangles are also kept
+// in the order of the leaves, 4 at a time in SIMD registers, as a vertex and
+// the 2 edges from it.
+class triangle_bvh {
+public:
+    triangle_bvh();
+    // 3 floats per position, 3 indices per triangle
+    void build(const std::vector<float>& positions, const std::vector<GLuint>& indices);
+    inline size_t size() const { return _bvh.size(); }
+    inline bounds get_bounds() const { return _bvh.get_bounds(); }
+    // The nearest triangle hit before max_distance, from both sides, and the
+    // distance of the hit. False when none.
+    bool intersect(const ray& r, float max_distance, size_t& triangle, float& distance) const;
+private:
+    // the nearest hit of the triangles in [first, first + count) of the leaf order
+    float intersect_range(const ray& r, size_t first, size_t count, float max_distance, size_t& triangle) const;
+    bvh _bvh;
+    // v0 x y z, e1 x y z, e2 x y z, each of _stride floats
+    std::vector<float> _triangles;
+    size_t _stride;
+};
+
+// Draws a node, picked through the triangles of what it draws rather than
+// through its bounds. For a lod_node, those of the most detailed level.
+class pickable_node : public node {
+public:
+    pickable_node(std::shared_ptr<node> drawn, std::shared_ptr<const triangle_bvh> triangles);
+    virtual void render(rendering_context& ctx);
+    virtual bounds get_bounds() const;
+    virtual bool intersect(const ray& r, ray_hit& hit);
+private:
+    std::shared_ptr<node> _drawn;
+    std::shared_ptr<const triangle_bvh> _triangles;
+};
+
+// the triangles of the current group of geomb, cf geometry_builder::triangles
+template<class T>
+std::shared_ptr<triangle_bvh> make_triangle_bvh(const geometry_builder<T>& geomb)
+{
+    std::vector<float> positions;
+    std::vector<GLuint> indices;
+    geomb.triangles(positions, indices);
+    auto triangles = std::make_shared<triangle_bvh>();
+    triangles->build(positions, indices);
+    return triangles;
+}
+
+// a geometry node of geomb picked through its triangles
+template<class T>
+std::shared_ptr<pickable_node> make_pickable_node(geometry_builder<T>& geomb)
+{
+    auto drawn = std::make_shared<geometry_node<T>>(geomb.build());
+    return std::make_shared<pickable_node>(drawn, make_triangle_bvh(geomb));
+}
+
+// The nearest hit of the ray in the nodes under root, root being the node hit
+// when it is not a group. Rays from a camera are in world coordinates, those
+// root is rendered in.
+ray_hit pick(const std::shared_ptr<node>& root, const ray& r,
+    float max_distance = std::numeric_limits<float>::max());
+
+}
+
+#endif
@@ -0,0 +1,120 @@
+#include <cassert>
+#include <cstring>
+
+#include "render_queue.hpp"
+#include "yae.hpp"
+
+using namespace yae;
+
+namespace {
+
+const uint64_t transparent_bit = 1ull << 63;
+const uint32_t field_mask = (1u << 12) - 1; // programs and textures beyond share the last value
+
+uint32_t field(uint32_t value)
+{
+    return value < field_mask ? value : field_mask;
+}
+
+// the bits of a positive float sort like the float, those behind the eye are 0
+uint32_t depth_bits(float depth)
+{
+    if (!(depth > 0.0f)) {
+        return 0;
+    }
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return bits;
+}
+
+}
+
+render_queue::render_queue()
+{
+}
+
+uint64_t render_queue::make_key(bool transparent, uint32_t program, uint32_t texture, float depth)
+{
+    uint64_t d = depth_bits(depth);
+    if (transparent) {
+        return transparent_bit | (static_cast<uint64_t>(~d & 0xffffffffu) << 31)
+            | (static_cast<uint64_t>(field(program)) << 19) | (static_cast<uint64_t>(field(texture)) << 7);
+    }
+    return (static_cast<uint64_t>(field(program)) << 51) | (static_cast<uint64_t>(field(texture)) << 39) | (d << 7);
+}
+
+void render_queue::sort(std::vector<std::pair<uint64_t, uint32_t>>& entries,
+    std::vector<std::pair<uint64_t, uint32_t>>& scratch)
+{
+    // least significant byte first, the bytes all items share skipped
+    scratch.resize(entries.size());
+    size_t counts[256];
+    for (int shift = 0; shift < 64; shift += 8) {
+        memset(counts, 0, sizeof(counts));
+        for (const auto& e : entries) {
+            counts[(e.first >> shift) & 0xff]++;
+        }
+        if (counts[entries.empty() ? 0 : (entries[0].first >> shift) & 0xff] == entries.size()) {
+            continue;
+        }
+        size_t offset = 0;
+        for (size_t& c : counts) {
+            size_t n = c;
+            c = offset;
+            offset += n;
+        }
+        for (const auto& e : entries) {
+            scratch[counts[(e.first >> shift) & 0xff]++] = e;
+        }
+        entries.swap(scratch);
+    }
+}
+
+uint32_t render_queue::program_index(const program* prog)
+{
+    auto it = _programs.find(prog);
+    if (it == _programs.end()) {
+        it = _programs.insert(std::make_pair(prog, static_cast<uint32_t>(_programs.size()))).first;
+    }
+    return it->second;
+}
+
+void render_queue::push(const geometry<float>& geom, program& prog, const matrix44f& mvp, const matrix44f& mv)
+{
+    const bounds& b = geom.get_bounds();
+    float depth = -(mv * (b.known ? b.center : vector3f(0.0f, 0.0f, 0.0f))).z();
+    GLuint texture = prog.get_texture_id();
+    _entries.push_back(std::make_pair(make_key(prog.is_transparent(), program_index(&prog), texture, depth),
+        static_cast<uint32_t>(_items.size())));
+    _items.push_back(item{ &geom, &prog, texture, mvp, mv });
+}
+
+void render_queue::submit(rendering_context& ctx)
+{
+    // the state changes of the traversal order, then those of the sorted one
+    sorting_statistics& stats = ctx.sorting;
+    stats.draws += _items.size();
+    for (size_t i = 1; i < _items.size(); i++) {
+        stats.unsorted_program_changes += _items[i].prog != _items[i - 1].prog ? 1 : 0;
+        stats.unsorted_texture_changes += _items[i].texture != _items[i - 1].texture ? 1 : 0;
+    }
+    sort(_entries, _scratch);
+    const item* previous = nullptr;
+    for (const auto& e : _entries) {
+        const item& it = _items[e.second];
+        if (previous != nullptr) {
+            stats.program_changes += it.prog != previous->prog ? 1 : 0;
+            stats.texture_changes += it.texture != previous->texture ? 1 : 0;
+        }
+        // sorted by the texture pushed, drawn with the current one
+        assert(it.prog->get_texture_id() == it.texture);
+        ctx.load(it.mvp, it.mv);
+        it.prog->render(*it.geom, ctx);
+        previous = &it;
+    }
+    ctx.reset();
+    _items.clear();
+    _entries.clear();
+    // not to keep the addresses of programs since freed, which others may reuse
+    _programs.clear();
+}
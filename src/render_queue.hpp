@@ -0,0 +1,56 @@
+#ifndef _render_queue_hpp_
+#define _render_queue_hpp_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "geometry.hpp"
+#include "matrix.hpp"
+#include "shader.hpp"
+
+namespace yae {
+
+class rendering_context;
+
+// Draws collected by a traversal, cf rendering_context::draw, then sorted
+// and submitted at once: opaque draws first grouped by program and texture,
+// front to back, then transparent ones back to front. The geometries and
+// programs must live until submit, and the programs keep the state they had
+// when pushed, e.g. their color or texture: they read it as they draw, only
+// their texture is checked, by an assertion.
+class render_queue {
+public:
+    render_queue();
+    void push(const geometry<float>& geom, program& prog, const matrix44f& mvp, const matrix44f& mv);
+    // draws the queued geometries in the order of their keys, then empties the queue,
+    // forgetting the programs
+    void submit(rendering_context& ctx);
+    inline size_t size() const { return _items.size(); }
+    // from the most significant bits: transparent, then program, texture and
+    // depth when opaque, depth reversed, program and texture when transparent
+    static uint64_t make_key(bool transparent, uint32_t program, uint32_t texture, float depth);
+    // by key, stable, scratch resized to the size of entries
+    static void sort(std::vector<std::pair<uint64_t, uint32_t>>& entries,
+        std::vector<std::pair<uint64_t, uint32_t>>& scratch);
+private:
+    struct item {
+        const geometry<float>* geom;
+        program* prog;
+        GLuint texture;
+        matrix44f mvp;
+        matrix44f mv;
+    };
+    // small, in the order the programs are first queued since the last submit
+    uint32_t program_index(const program* prog);
+    std::vector<item> _items;
+    std::vector<std::pair<uint64_t, uint32_t>> _entries; // key, item
+    std::vector<std::pair<uint64_t, uint32_t>> _scratch;
+    std::unordered_map<const program*, uint32_t> _programs;
+};
+
+}
+
+#endif
@@ -25,6 +25,16 @@ struct sdl_window : window {
     int keydown() { return SDL_KEYDOWN; }
     int window_resized() { return SDL_WINDOWEVENT_RESIZED; }
     void make_current();
+    std::unique_ptr<shared_context> create_shared_context();
+};
+
+struct sdl_shared_context : shared_context {
+    SDL_Window* win;
+    SDL_GLContext ctx;
+    sdl_shared_context(SDL_Window* win, SDL_GLContext ctx) : win(win), ctx(ctx) {}
+    ~sdl_shared_context() { SDL_GL_DeleteContext(ctx); }
+    void make_current() { SDL_GL_MakeCurrent(win, ctx); }
+    void done_current() { SDL_GL_MakeCurrent(win, nullptr); }
 };
 
 sdl_window::sdl_window(SDL_Window* win, SDL_GLContext ctx)
@@ -87,19 +97,45 @@ void sdl_window::make_current()
     SDL_GL_MakeCurrent(win, ctx);
 }
 
-std::unique_ptr<window> sdl_engine::create_simple_window()
+std::unique_ptr<shared_context> sdl_window::create_shared_context()
+{
+    // the version and profile attributes are still those of the window
+    make_current();
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+    SDL_GLContext shared = SDL_GL_CreateContext(win);
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+    // creating a context makes it current
+    make_current();
+    if (shared == nullptr) {
+        printf("Cannot create a shared context: %s\n", SDL_GetError());
+        return nullptr;
+    }
+    return std::make_unique<sdl_shared_context>(win, shared);
+}
+
+std::unique_ptr<window> sdl_engine::create_simple_window(bool core_profile)
 {
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+    if (core_profile) {
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG | SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG);
+    } else {
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+    }
     SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
     SDL_Window* win = SDL_CreateWindow("GLEW Test",
         SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
         800, 600,
         SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
     SDL_GLContext ctx = SDL_GL_CreateContext(win);
+    // without it GLEW looks up the entry points with the extension string, missing in core profiles
+    glewExperimental = GL_TRUE;
     glewInit();
-    glViewport(0, 0, 800, 600);
+    // glewInit queries GL_EXTENSIONS, an invalid enum in core profiles
+    glGetError();
+    yae::gl_state::current().viewport(0, 0, 800, 600);
     return std::make_unique<sdl_window>(win, ctx);
 }
 
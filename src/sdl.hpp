@@ -16,7 +16,7 @@ struct sdl_engine : yae::engine {
     sdl_engine();
     ~sdl_engine();
 
-    std::unique_ptr<window> create_simple_window();
+    std::unique_ptr<window> create_simple_window(bool core_profile = false);
 };
 
 }
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <cstring>
+#include <vector>
 
 #include "yae.hpp"
 #include "shader.hpp"
@@ -68,42 +70,204 @@ GLuint shader<type>::get_id() const
     return id;
 }
 
+// Without multi draw indirect and base instances, the draws are issued one
+// by one, the attributes read per instance pointed at the base instance.
+static void draw_each(const geometry<float>& geometry, GLuint attributes)
+{
+    GLenum type = geometry.get_index_type();
+    for (const draw_elements_command& d : geometry.get_draws()) {
+        for (const vertex_stream& stream : geometry.get_streams()) {
+            if (stream.format.divisor == 0 || (stream.format.attributes() & attributes) == 0) {
+                continue;
+            }
+            gl_state::current().bind_buffer(GL_ARRAY_BUFFER, stream.buffer_id);
+            size_t base = static_cast<size_t>(d.base_instance / stream.format.divisor) * stream.format.stride;
+            for (auto& e : stream.format.elements) {
+                if (attributes & attribute_bit(e.attribute)) {
+                    glVertexAttribPointer(e.attribute, e.size, e.type, e.normalized, stream.format.stride,
+                        reinterpret_cast<const void*>(base + e.offset));
+                }
+            }
+        }
+        glDrawElementsInstancedBaseVertex(geometry.get_primitive_type(), d.count, type,
+            reinterpret_cast<const void*>(static_cast<size_t>(d.first_index) * component_bytes(type)),
+            d.instance_count, d.base_vertex);
+    }
+}
+
+void yae::draw_geometry(const geometry<float>& geometry, GLuint attributes)
+{
+    // the vertex array stays bound, as long as the next geometry does not change it
+    gl_state& state = gl_state::current();
+    GLuint vertex_array = geometry.get_vertex_array(attributes);
+    if (!geometry.get_draws().empty()) {
+        if (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance) {
+            GLuint draws = geometry.get_draws_buffer();
+            state.bind_vertex_array(vertex_array);
+            state.bind_buffer(GL_DRAW_INDIRECT_BUFFER, draws);
+            glMultiDrawElementsIndirect(geometry.get_primitive_type(), geometry.get_index_type(), nullptr,
+                static_cast<GLsizei>(geometry.get_draws().size()), 0);
+        } else {
+            state.bind_vertex_array(vertex_array);
+            draw_each(geometry, attributes);
+        }
+        return;
+    }
+    state.bind_vertex_array(vertex_array);
+    GLenum type = geometry.get_index_type();
+    bool restart = geometry.is_indexed() && geometry.has_primitive_restart();
+    if (restart) {
+        state.enable(GL_PRIMITIVE_RESTART);
+        glPrimitiveRestartIndex(type == GL_UNSIGNED_BYTE ? 0xff : type == GL_UNSIGNED_SHORT ? 0xffff : 0xffffffff);
+    } else {
+        state.disable(GL_PRIMITIVE_RESTART);
+    }
+    GLsizei instances = geometry.get_instance_count();
+    if (instances > 0) {
+        if (geometry.is_indexed() && geometry.get_first() != 0) {
+            glDrawElementsInstancedBaseVertex(geometry.get_primitive_type(), geometry.get_count(), type, 0, instances,
+                geometry.get_first());
+        } else if (geometry.is_indexed()) {
+            glDrawElementsInstanced(geometry.get_primitive_type(), geometry.get_count(), type, 0, instances);
+        } else {
+            glDrawArraysInstanced(geometry.get_primitive_type(), geometry.get_first(), geometry.get_count(), instances);
+        }
+    } else if (geometry.is_indexed() && geometry.get_first() != 0) {
+        glDrawElementsBaseVertex(geometry.get_primitive_type(), geometry.get_count(), type, 0, geometry.get_first());
+    } else if (geometry.is_indexed()) {
+        glDrawElements(geometry.get_primitive_type(), geometry.get_count(), type, 0);
+    } else {
+        glDrawArrays(geometry.get_primitive_type(), geometry.get_first(), geometry.get_count());
+    }
+}
+
+namespace {
+
+// std140: the vec3 is padded to 16 bytes unless followed by a float
+struct frame_block {
+    float projection[16];
+    float view[16];
+    float light_dir[3];
+    float time;
+};
+
+static_assert(sizeof(frame_block) == 144, "the frame block is laid out as std140");
+
+}
+
+frame_uniforms::frame_uniforms() : _buffer_id(0)
+{
+}
+
+frame_uniforms::~frame_uniforms()
+{
+    if (_buffer_id != 0) {
+        gl_state::current().delete_buffer(_buffer_id);
+    }
+}
+
+void frame_uniforms::update(const matrix44f& projection, const matrix44f& view, const vector3f& light_dir, float time)
+{
+    frame_block block;
+    memcpy(block.projection, projection.m, sizeof(block.projection));
+    memcpy(block.view, view.m, sizeof(block.view));
+    block.light_dir[0] = light_dir.x();
+    block.light_dir[1] = light_dir.y();
+    block.light_dir[2] = light_dir.z();
+    block.time = time;
+    gl_state& state = gl_state::current();
+    if (_buffer_id == 0) {
+        glGenBuffers(1, &_buffer_id);
+        state.bind_buffer(GL_UNIFORM_BUFFER, _buffer_id);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(block), &block, GL_DYNAMIC_DRAW);
+    } else {
+        state.bind_buffer(GL_UNIFORM_BUFFER, _buffer_id);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+    }
+    state.bind_buffer_base(GL_UNIFORM_BUFFER, binding, _buffer_id);
+}
+
 shader_program::shader_program(const std::string& vertex_shader_source,
     const std::string& fragment_shader_source,
     const std::map<int, std::string>& attribute_indices)
     : vertex_shader(vertex_shader_source), fragment_shader(fragment_shader_source),
-    polygon_face(GL_FRONT), polygon_mode(GL_FILL)
+    polygon_face(GL_FRONT_AND_BACK), polygon_mode(GL_FILL), attributes(0)
 {
     id = glCreateProgram();
     glAttachShader(id, vertex_shader.get_id());
     glAttachShader(id, fragment_shader.get_id());
     for (auto it = attribute_indices.begin(); it != attribute_indices.end(); it++) {
         glBindAttribLocation(id, it->first, it->second.c_str());
+        attributes |= attribute_bits(it->first);
     }
     glLinkProgram(id);
     check_program_link_status(id);
+    // looked up once rather than by name at each draw
+    GLint count = 0;
+    GLint max_length = 0;
+    glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+    std::vector<GLchar> name(max_length + 1);
+    for (GLint i = 0; i < count; i++) {
+        uniform_info u;
+        GLsizei length = 0;
+        glGetActiveUniform(id, i, max_length + 1, &length, &u.size, &u.type, name.data());
+        std::string n(name.data(), length);
+        u.location = glGetUniformLocation(id, n.c_str());
+        if (u.location < 0) {
+            continue; // in a uniform block
+        }
+        uniforms[n.substr(0, n.find('['))] = u;
+    }
+    static const char* names[PROGRAM_UNIFORM_COUNT] = { "mvpMatrix", "mvMatrix", "positionMatrix", "color", "tex" };
+    for (GLuint u = 0; u < PROGRAM_UNIFORM_COUNT; u++) {
+        locations[u] = get_uniform_location(names[u]);
+    }
+    GLuint block_index = glGetUniformBlockIndex(id, "frame");
+    if (block_index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(id, block_index, frame_uniforms::binding);
+    }
+}
+
+GLint shader_program::get_uniform_location(const std::string& name) const
+{
+    auto it = uniforms.find(name);
+    return it != uniforms.end() ? it->second.location : -1;
 }
 
 shader_program::~shader_program()
 {
-    glDeleteProgram(id);
+    gl_state::current().delete_program(id);
+}
+
+void shader_program::set_default_instance_attributes()
+{
+    // read by the instances of a geometry without a color or position transform stream
+    if (attributes & attribute_bit(vertex_attribute::INSTANCE_COLOR)) {
+        glVertexAttrib4f(vertex_attribute::INSTANCE_COLOR, 1.0f, 1.0f, 1.0f, 1.0f);
+    }
+    if (attributes & attribute_bit(vertex_attribute::INSTANCE_POSITION_TRANSFORM)) {
+        for (GLuint c = 0; c < 4; c++) {
+            glVertexAttrib4f(vertex_attribute::INSTANCE_POSITION_TRANSFORM + c, c == 0 ? 1.0f : 0.0f, c == 1 ? 1.0f : 0.0f,
+                c == 2 ? 1.0f : 0.0f, c == 3 ? 1.0f : 0.0f);
+        }
+    }
 }
 
 void monochrome_program::render(const geometry<float>& geometry, rendering_context& ctx)
 {
-    glPolygonMode(polygon_face, polygon_mode);
-    glUseProgram(id);
-    GLuint matrix_uniform = glGetUniformLocation(id, "mvpMatrix");
-    glUniformMatrix4fv(matrix_uniform, 1, false, ctx.mvp().m);
-    GLuint color_uniform = glGetUniformLocation(id, "color");
-    glUniform4f(color_uniform, col.r(), col.g(), col.b(), col.a());
-    glEnableVertexAttribArray(vertex_attribute::POSITION);
-    glBindBuffer(GL_ARRAY_BUFFER, geometry.get_positions_id());
-    glVertexAttribPointer(vertex_attribute::POSITION, geometry.get_dimensions(), GL_FLOAT, GL_FALSE, 0, 0);
-    glDrawArrays(geometry.get_primitive_type(), 0, geometry.get_count());
-    glDisableVertexAttribArray(vertex_attribute::POSITION);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glUseProgram(id);
+    gl_state::current().polygon_mode(polygon_face, polygon_mode);
+    gl_state::current().use_program(id);
+    if (instanced()) {
+        // the position transform comes before that of the instance
+        glUniformMatrix4fv(locations[MVP_MATRIX], 1, false, ctx.mvp().m);
+        glUniformMatrix4fv(locations[POSITION_MATRIX], 1, false, geometry.get_position_transform().m);
+        set_default_instance_attributes();
+    } else {
+        glUniformMatrix4fv(locations[MVP_MATRIX], 1, false, multm(ctx.mvp(), geometry.get_position_transform()).m);
+    }
+    glUniform4f(locations[COLOR], col.r(), col.g(), col.b(), col.a());
+    draw_geometry(geometry, attributes);
 }
 
 static const std::string monochrome_2d_vert = R"SHADER(
@@ -142,6 +306,23 @@ void main(void)
 }
 )SHADER";
 
+static const std::string monochrome_3d_instanced_vert = R"SHADER(
+#version 330
+uniform mat4 mvpMatrix;
+uniform mat4 positionMatrix;
+uniform vec4 color;
+in vec3 vpos;
+in vec4 iColor;
+in mat4 iTransform;
+in mat4 iPositionTransform;
+out vec4 vcolor;
+void main(void)
+{
+	gl_Position = mvpMatrix * iTransform * iPositionTransform * positionMatrix * vec4(vpos, 1.0f);
+	vcolor = color * iColor;
+}
+)SHADER";
+
 monochrome_program::monochrome_program(const std::string& monochrome_vert, const std::string& monochrome_frag, const std::map<int, std::string>& attribute_indices)
 : shader_program(monochrome_vert, monochrome_frag, attribute_indices)
 {
@@ -161,25 +342,22 @@ std::shared_ptr<monochrome_program> monochrome_program::create_3d()
     return std::shared_ptr<monochrome_program>(new monochrome_program(monochrome_3d_vert, monochrome_frag, monochrome_attribute_indices));
 }
 
+std::shared_ptr<monochrome_program> monochrome_program::create_3d_instanced()
+{
+    std::map<int, std::string> monochrome_attribute_indices;
+    monochrome_attribute_indices[vertex_attribute::POSITION] = "vpos";
+    monochrome_attribute_indices[vertex_attribute::INSTANCE_COLOR] = "iColor";
+    monochrome_attribute_indices[vertex_attribute::INSTANCE_TRANSFORM] = "iTransform";
+    monochrome_attribute_indices[vertex_attribute::INSTANCE_POSITION_TRANSFORM] = "iPositionTransform";
+    return std::shared_ptr<monochrome_program>(new monochrome_program(monochrome_3d_instanced_vert, monochrome_frag, monochrome_attribute_indices));
+}
+
 void texture_program::render(const geometry<float>& geometry, rendering_context& ctx)
 {
-    glUseProgram(id);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, current_texture->get_id());
-    GLuint matrix_uniform = glGetUniformLocation(id, "mvpMatrix");
-    glUniformMatrix4fv(matrix_uniform, 1, false, ctx.mvp().m);
-    GLuint texture_uniform = glGetUniformLocation(id, "texture");
-    glUniform1i(texture_uniform, 0); // we pass the texture unit
-    glEnableVertexAttribArray(vertex_attribute::POSITION);
-    glBindBuffer(GL_ARRAY_BUFFER, geometry.get_positions_id());
-    glVertexAttribPointer(vertex_attribute::POSITION, geometry.get_dimensions(), GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(vertex_attribute::TEXCOORD);
-    glBindBuffer(GL_ARRAY_BUFFER, geometry.get_tex_coords_id());
-    glVertexAttribPointer(vertex_attribute::TEXCOORD, geometry.get_dimensions(), GL_FLOAT, GL_FALSE, 0, 0);
-    glDrawArrays(geometry.get_primitive_type(), 0, 4);
-    glDisableVertexAttribArray(vertex_attribute::POSITION);
-    glDisableVertexAttribArray(vertex_attribute::TEXCOORD);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl_state::current().use_program(id);
+    gl_state::current().bind_texture(0, current_texture->get_id());
+    glUniformMatrix4fv(locations[MVP_MATRIX], 1, false, multm(ctx.mvp(), geometry.get_position_transform()).m);
+    draw_geometry(geometry, attributes);
 }
 
 void texture_program::set_texture(std::shared_ptr<texture> t)
@@ -187,6 +365,11 @@ void texture_program::set_texture(std::shared_ptr<texture> t)
     current_texture = t;
 }
 
+GLuint texture_program::get_texture_id() const
+{
+    return current_texture ? current_texture->get_id() : 0;
+}
+
 std::shared_ptr<texture_program> texture_program::create()
 {
     std::map<int, std::string> texture_attribute_indices;
@@ -198,7 +381,6 @@ std::shared_ptr<texture_program> texture_program::create()
 static const std::string texture_vert = R"SHADER(
 #version 330 core
 uniform mat4 mvpMatrix;
-uniform sampler2D texture;
 in vec2 pos;
 in vec2 texCoord;
 out vec2 vTexCoord;
@@ -211,44 +393,41 @@ void main(void)
 
 static const std::string texture_frag = R"SHADER(
 #version 330 core
-uniform sampler2D texture;
+uniform sampler2D tex;
 in vec2 vTexCoord;
 out vec4 fColor;
 void main(void)
 {
-    fColor = texture2D(texture, vTexCoord);
+    fColor = texture(tex, vTexCoord);
 }
 )SHADER";
 
 texture_program::texture_program(std::map<int, std::string>& attribute_indices) :
-shader_program(texture_vert, texture_frag, attribute_indices) {}
+shader_program(texture_vert, texture_frag, attribute_indices)
+{
+    // the texture unit sampled, the same for every draw
+    gl_state::current().use_program(id);
+    glUniform1i(locations[SAMPLER], 0);
+}
 
 void flat_shading_program::render(const geometry<float>& geometry, rendering_context& ctx)
 {
-    glUseProgram(id);
-
-    GLuint mvp_uniform = glGetUniformLocation(id, "mvpMatrix");
-    glUniformMatrix4fv(mvp_uniform, 1, false, ctx.mvp().m);
-
-    GLuint mv_uniform = glGetUniformLocation(id, "mvMatrix");
-    glUniformMatrix4fv(mv_uniform, 1, false, ctx.mv().m);
+    gl_state::current().use_program(id);
+
+    if (instanced()) {
+        glUniformMatrix4fv(locations[MVP_MATRIX], 1, false, ctx.mvp().m);
+        glUniformMatrix4fv(locations[POSITION_MATRIX], 1, false, geometry.get_position_transform().m);
+        set_default_instance_attributes();
+    } else {
+        glUniformMatrix4fv(locations[MVP_MATRIX], 1, false, multm(ctx.mvp(), geometry.get_position_transform()).m);
+    }
 
-    GLuint light_dir_uniform = glGetUniformLocation(id, "lightDir");
-    glUniform3f(light_dir_uniform, ctx.dir.x(), ctx.dir.y(), ctx.dir.z());
+    glUniformMatrix4fv(locations[MV_MATRIX], 1, false, ctx.mv().m);
 
-    GLuint color_uniform = glGetUniformLocation(id, "color");
-    glUniform3f(color_uniform, col.r(), col.g(), col.b());
+    // the light direction comes from the frame uniforms
+    glUniform3f(locations[COLOR], col.r(), col.g(), col.b());
 
-    glEnableVertexAttribArray(vertex_attribute::POSITION);
-    glBindBuffer(GL_ARRAY_BUFFER, geometry.get_positions_id());
-    glVertexAttribPointer(vertex_attribute::POSITION, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(vertex_attribute::NORMAL);
-    glBindBuffer(GL_ARRAY_BUFFER, geometry.get_normals_id());
-    glVertexAttribPointer(vertex_attribute::NORMAL, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glDrawArrays(geometry.get_primitive_type(), 0, geometry.get_count());
-    glDisableVertexAttribArray(vertex_attribute::POSITION);
-    glDisableVertexAttribArray(vertex_attribute::NORMAL);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    draw_geometry(geometry, attributes);
 }
 
 std::shared_ptr<flat_shading_program> flat_shading_program::create()
@@ -264,7 +443,12 @@ static const std::string flat_shading_vert = R"SHADER(
 uniform mat4 mvpMatrix;
 uniform mat4 mvMatrix;
 uniform vec3 color;
-uniform vec3 lightDir;
+layout(std140) uniform frame {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 lightDir;
+    float time;
+};
 in vec3 vPosition;
 in vec3 vNormal;
 out vec4 vColor;
@@ -282,6 +466,36 @@ void main(void)
 }
 )SHADER";
 
+// the normals are transformed by the instance matrix as is, which is then
+// expected to be a rotation, a translation and a uniform scaling, the
+// position transform of the instance not
+static const std::string flat_shading_instanced_vert = R"SHADER(
+#version 330 core
+uniform mat4 mvpMatrix;
+uniform mat4 positionMatrix;
+uniform mat4 mvMatrix;
+uniform vec3 color;
+layout(std140) uniform frame {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 lightDir;
+    float time;
+};
+in vec3 vPosition;
+in vec3 vNormal;
+in vec4 iColor;
+in mat4 iTransform;
+in mat4 iPositionTransform;
+out vec4 vColor;
+void main(void)
+{
+    vec3 normalEye = normalize(vec3(mvMatrix * iTransform * vec4(vNormal, 0.0f)));
+    float dotProduct = dot(normalEye, lightDir);
+    gl_Position = mvpMatrix * iTransform * iPositionTransform * positionMatrix * vec4(vPosition, 1.0f);
+    vColor = -min(dotProduct, 0.0f) * vec4(color, 1.0f) * iColor;
+}
+)SHADER";
+
 const std::string flat_shading_frag = R"SHADER(
 #version 330 core
 in vec4 vColor;
@@ -295,6 +509,20 @@ void main(void)
 flat_shading_program::flat_shading_program(const std::map<int, std::string>& attribute_indices) :
 shader_program(flat_shading_vert, flat_shading_frag, attribute_indices) {}
 
+flat_shading_program::flat_shading_program(const std::string& vert, const std::map<int, std::string>& attribute_indices) :
+shader_program(vert, flat_shading_frag, attribute_indices) {}
+
+std::shared_ptr<flat_shading_program> flat_shading_program::create_instanced()
+{
+    std::map<int, std::string> attribute_indices;
+    attribute_indices[vertex_attribute::POSITION] = "vPosition";
+    attribute_indices[vertex_attribute::NORMAL] = "vNormal";
+    attribute_indices[vertex_attribute::INSTANCE_COLOR] = "iColor";
+    attribute_indices[vertex_attribute::INSTANCE_TRANSFORM] = "iTransform";
+    attribute_indices[vertex_attribute::INSTANCE_POSITION_TRANSFORM] = "iPositionTransform";
+    return std::shared_ptr<flat_shading_program>(new flat_shading_program(flat_shading_instanced_vert, attribute_indices));
+}
+
 wireframe_program::wireframe_program()
 : prog(monochrome_program::create_3d())
 {
@@ -302,14 +530,15 @@ wireframe_program::wireframe_program()
 
 void wireframe_program::render(const geometry<float>& geometry, rendering_context& ctx)
 {
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_POLYGON_OFFSET_FILL);
-    glPolygonOffset(1.0f, 1.0f);
+    gl_state& state = gl_state::current();
+    state.enable(GL_DEPTH_TEST);
+    state.enable(GL_POLYGON_OFFSET_FILL);
+    state.polygon_offset(1.0f, 1.0f);
     prog->set_polygon_mode(GL_FILL);
     prog->set_polygon_face(GL_FRONT_AND_BACK);
     prog->set_color(solid_col);
     prog->render(geometry, ctx);
-    glDisable(GL_POLYGON_OFFSET_FILL);
+    state.disable(GL_POLYGON_OFFSET_FILL);
     prog->set_polygon_mode(GL_LINE);
     prog->set_color(wire_col);
     prog->render(geometry, ctx);
@@ -25,9 +25,54 @@ private:
     shader(const shader&);
 };
 
+// draws a geometry with the vertex array feeding the given attributes
+void draw_geometry(const geometry<float>& geometry, GLuint attributes);
+
+// the uniforms set per draw by the programs, their locations resolved at link
+enum program_uniform : GLuint {
+    MVP_MATRIX, // mvpMatrix
+    MV_MATRIX, // mvMatrix
+    POSITION_MATRIX, // positionMatrix
+    COLOR, // color
+    SAMPLER, // tex
+    PROGRAM_UNIFORM_COUNT
+};
+
+// an active uniform of a linked program, outside of uniform blocks
+struct uniform_info {
+    GLint location;
+    GLenum type; // e.g. GL_FLOAT_MAT4
+    GLint size; // of arrays
+};
+
+// The uniforms shared by the programs during the rendering of a camera,
+// cf camera::render, in the std140 uniform block:
+//   layout(std140) uniform frame {
+//       mat4 projectionMatrix;
+//       mat4 viewMatrix;
+//       vec3 lightDir; // in eye coordinates
+//       float time; // in seconds
+//   };
+// bound to the binding point of the block by every program declaring it.
+class frame_uniforms {
+public:
+    static const GLuint binding = 0;
+    frame_uniforms();
+    ~frame_uniforms();
+    // the buffer is created on first update
+    void update(const matrix44f& projection, const matrix44f& view, const vector3f& light_dir, float time);
+private:
+    frame_uniforms(const frame_uniforms&);
+    GLuint _buffer_id;
+};
+
 class program {
 public:
     virtual void render(const geometry<float>& geometry, rendering_context& ctx) = 0;
+    // drawn after the opaque geometries, back to front, cf render_queue
+    virtual bool is_transparent() const { return false; }
+    // the texture bound by render, 0 if none
+    virtual GLuint get_texture_id() const { return 0; }
 };
 
 class composite_program : public program {
@@ -41,11 +86,22 @@ public:
     virtual void render(const geometry<float>& geometry, rendering_context& ctx) = 0;
     inline void set_polygon_face(GLenum polygon_face) { this->polygon_face = polygon_face; }
     inline void set_polygon_mode(GLenum polygon_mode) { this->polygon_mode = polygon_mode; }
+    // the active uniforms by name, arrays without their [0]
+    inline const std::map<std::string, uniform_info>& get_uniforms() const { return uniforms; }
+    // -1 when the program has no such active uniform
+    GLint get_uniform_location(const std::string& name) const;
     ~shader_program();
 protected:
+    // whether the program reads a transform per instance, cf instanced_node
+    inline bool instanced() const { return (attributes & attribute_bit(vertex_attribute::INSTANCE_TRANSFORM)) != 0; }
+    // white and the identity, for the instances without a color or a position transform
+    void set_default_instance_attributes();
     GLuint id;
-    GLenum polygon_face; // GL_FRONT, GL_BACK, GL_FRONT_AND_BACK
+    GLenum polygon_face; // GL_FRONT_AND_BACK, the only one left in core profiles
     GLenum polygon_mode; // GL_POINT, GL_LINE, GL_FILL
+    GLuint attributes; // the vertex attributes read by the program, cf attribute_bit
+    GLint locations[PROGRAM_UNIFORM_COUNT]; // by program_uniform, -1 when not declared
+    std::map<std::string, uniform_info> uniforms;
 private:
     shader<GL_VERTEX_SHADER> vertex_shader;
     shader<GL_FRAGMENT_SHADER> fragment_shader;
@@ -57,8 +113,11 @@ public:
     monochrome_program(const std::string& monochrome_vert, const std::string& monochrome_frag, const std::map<int, std::string>& attribute_indices);
     virtual void render(const geometry<float>& geometry, rendering_context& ctx);
     inline void set_color(color4f col) { this->col = col; }
+    virtual bool is_transparent() const { return col.a() < 1.0f; }
     static std::shared_ptr<monochrome_program> create_2d();
     static std::shared_ptr<monochrome_program> create_3d();
+    // each instance transformed by its matrix and tinted by its color, cf instanced_node
+    static std::shared_ptr<monochrome_program> create_3d_instanced();
 private:
     color4f col;
 };
@@ -67,6 +126,7 @@ class texture_program : public shader_program {
 public:
     virtual void render(const geometry<float>& geometry, rendering_context& ctx);
     void set_texture(std::shared_ptr<texture> t);
+    virtual GLuint get_texture_id() const;
     static std::shared_ptr<texture_program> create();
 private:
     texture_program(std::map<int, std::string>& attribute_indices);
@@ -77,9 +137,13 @@ class flat_shading_program : public shader_program {
 public:
     virtual void render(const geometry<float>& geometry, rendering_context& ctx);
     inline void set_color(color4f col) { this->col = col; }
+    virtual bool is_transparent() const { return col.a() < 1.0f; }
     static std::shared_ptr<flat_shading_program> create();
+    // each instance transformed by its matrix and tinted by its color, cf instanced_node
+    static std::shared_ptr<flat_shading_program> create_instanced();
 private:
     flat_shading_program(const std::map<int, std::string>& attribute_indices);
+    flat_shading_program(const std::string& vert, const std::map<int, std::string>& attribute_indices);
     color4f col;
 };
 
@@ -89,6 +153,7 @@ public:
     virtual void render(const geometry<float>& geometry, rendering_context& ctx);
     inline void set_solid_color(color4f c) { this->solid_col = c; }
     inline void set_wire_color(color4f c) { this->wire_col = c; }
+    virtual bool is_transparent() const { return solid_col.a() < 1.0f || wire_col.a() < 1.0f; }
 private:
     color4f solid_col;
     color4f wire_col;
@@ -0,0 +1,117 @@
+#include "upload_thread.hpp"
+
+using namespace yae;
+
+upload_thread::upload_thread(std::unique_ptr<shared_context> context)
+    : _context(std::move(context)), _pending(0), _stopping(false)
+{
+    _thread = std::thread([this]() { work(); });
+}
+
+upload_thread::~upload_thread()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _cv.notify_all();
+    _thread.join();
+    // the thread uploaded everything submitted before stopping
+    for (auto& t : _uploaded) {
+        glClientWaitSync(t.fence, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(t.fence);
+        t.publish();
+    }
+}
+
+void upload_thread::submit(std::function<void()> upload, std::function<void()> publish)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _submitted.push_back(task{ std::move(upload), std::move(publish), nullptr });
+        _pending++;
+    }
+    _cv.notify_one();
+}
+
+void upload_thread::work()
+{
+    _context->make_current();
+    for (;;) {
+        task t;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [this]() { return _stopping || !_submitted.empty(); });
+            if (_submitted.empty()) {
+                break;
+            }
+            t = std::move(_submitted.front());
+            _submitted.pop_front();
+        }
+        t.upload();
+        t.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        // or the rendering thread could wait on a fence never sent to the GPU
+        glFlush();
+        std::lock_guard<std::mutex> lock(_mutex);
+        _uploaded.push_back(std::move(t));
+    }
+    _context->done_current();
+}
+
+size_t upload_thread::poll()
+{
+    size_t published = 0;
+    for (;;) {
+        task t;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_uploaded.empty()) {
+                break;
+            }
+            GLenum status = glClientWaitSync(_uploaded.front().fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+                break;
+            }
+            t = std::move(_uploaded.front());
+            _uploaded.pop_front();
+            _pending--;
+        }
+        glDeleteSync(t.fence);
+        t.publish();
+        published++;
+    }
+    return published;
+}
+
+size_t upload_thread::pending() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _pending;
+}
+
+GLuint yae::upload_buffer(const void* data, size_t size)
+{
+    // a target bound by no vertex array, that do not exist on the upload thread
+    GLuint id;
+    glGenBuffers(1, &id);
+    gl_state::current().bind_buffer(GL_COPY_WRITE_BUFFER, id);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, data, GL_STATIC_DRAW);
+    // unbound, as the buffer is deleted by the rendering thread whose
+    // gl_state the one of this thread does not hear of
+    gl_state::current().bind_buffer(GL_COPY_WRITE_BUFFER, 0);
+    return id;
+}
+
+void yae::upload_texture(upload_thread& thread, std::vector<GLubyte> rgba, GLsizei w, GLsizei h,
+    std::function<void(std::shared_ptr<texture>)> ready)
+{
+    auto pixels = std::make_shared<std::vector<GLubyte>>(std::move(rgba));
+    auto tex = std::make_shared<std::shared_ptr<texture>>();
+    thread.submit([pixels, w, h, tex]() {
+        *tex = std::make_shared<texture>(pixels->data(), w, h);
+        gl_state::current().bind_texture(0, 0);
+        pixels->clear();
+    }, [tex, ready]() {
+        ready(*tex);
+    });
+}
@@ -0,0 +1,62 @@
+#ifndef _upload_thread_hpp_
+#define _upload_thread_hpp_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "yae.hpp"
+
+namespace yae {
+
+// A thread with its own GL context, shared with the one of a window, that
+// creates and fills buffers and textures. Each upload is followed by a fence,
+// its publish function runs on the rendering thread once the fence signaled,
+// that is once the objects can be used from the rendering context.
+// Vertex array objects are not shared between contexts, geometries create
+// theirs when first drawn.
+class upload_thread {
+public:
+    upload_thread(std::unique_ptr<shared_context> context);
+    ~upload_thread();
+    // upload runs on the upload thread, publish on the rendering thread
+    void submit(std::function<void()> upload, std::function<void()> publish);
+    // Publishes the finished uploads, in submission order, from the rendering
+    // thread. Never waits for the GPU, returns the number published.
+    size_t poll();
+    // submitted but not published yet
+    size_t pending() const;
+private:
+    struct task {
+        std::function<void()> upload;
+        std::function<void()> publish;
+        GLsync fence;
+    };
+    void work();
+    std::unique_ptr<shared_context> _context;
+    std::deque<task> _submitted;
+    std::deque<task> _uploaded;
+    size_t _pending;
+    bool _stopping;
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    std::thread _thread;
+    upload_thread(const upload_thread&);
+};
+
+// a buffer of size bytes holding data, created with the current context
+GLuint upload_buffer(const void* data, size_t size);
+
+// creates a texture on the upload thread, ready is called on the rendering thread
+void upload_texture(upload_thread& thread, std::vector<GLubyte> rgba, GLsizei w, GLsizei h,
+    std::function<void(std::shared_ptr<texture>)> ready);
+
+}
+
+#endif
@@ -5,6 +5,11 @@
 #include <cstring>
 
 #include "yae.hpp"
+#include "async_loader.hpp"
+#include "culling.hpp"
+#include "mesh_cache.hpp"
+#include "render_queue.hpp"
+#include "upload_thread.hpp"
 
 using namespace yae;
 
@@ -42,7 +47,7 @@ double timer::elapsed()
 texture::texture(GLubyte* data, GLsizei w, GLsizei h)
 {
     glGenTextures(1, &id);
-    glBindTexture(GL_TEXTURE_2D, id);
+    gl_state::current().bind_texture(0, id);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -52,7 +57,7 @@ texture::texture(GLubyte* data, GLsizei w, GLsizei h)
 
 texture::~texture()
 {
-    glDeleteTextures(1, &id);
+    gl_state::current().delete_texture(id);
 }
 
 GLuint texture::get_id() const
@@ -77,16 +82,22 @@ rendering_context::rendering_context()
     memset(last_frame_times_seconds, 0, 100);
     elapsed_time_seconds = 0.0;
     frame_count = 0;
+    vp = viewport{ 0, 0, 0, 0 };
+    culling = culling_statistics{ 0, 0 };
+    last_culling = culling;
+    queue = nullptr;
+    sorting = sorting_statistics{ 0, 0, 0, 0, 0 };
+    last_sorting = sorting;
     exit = false;
     reset();
 }
 
-void rendering_context::projection(matrix44f mat)
+void rendering_context::projection(const matrix44f& mat)
 {
     mvp_stack.push_back(multm(mvp_stack.back(), mat));
 }
 
-void rendering_context::push(matrix44f mat)
+void rendering_context::push(const matrix44f& mat)
 {
     mvp_stack.push_back(multm(mvp_stack.back(), mat));
     mv_stack.push_back(multm(mv_stack.back(), mat));
@@ -106,6 +117,21 @@ void rendering_context::reset()
     mv_stack.push_back(identity<float>());
 }
 
+void rendering_context::load(const matrix44f& mvp, const matrix44f& mv)
+{
+    mvp_stack.assign(1, mvp);
+    mv_stack.assign(1, mv);
+}
+
+void rendering_context::draw(const geometry<float>& geom)
+{
+    if (queue != nullptr) {
+        queue->push(geom, *prog, mvp_stack.back(), mv_stack.back());
+    } else {
+        prog->render(geom, *this);
+    }
+}
+
 matrix44f rendering_context::mvp()
 {
     return mvp_stack.back();
@@ -121,6 +147,10 @@ direction_v(vector3f(0, 0, -1)), right_v(vector3f(1, 0, 0)), up_v(vector3f(0, 1,
 {
 }
 
+camera::~camera()
+{
+}
+
 void camera::reset()
 {
     position_v = vector3f(0, 0, 0);
@@ -211,20 +241,53 @@ matrix44f camera::position_and_orient()
     return look_at(position_v.x(), position_v.y(), position_v.z(), centerV.x(), centerV.y(), centerV.z(), up_v.x(), up_v.y(), up_v.z());
 }
 
-perspective_camera::perspective_camera(const clipping_volume& cv)
-: camera(cv)
+void camera::set_sorting(bool sorting)
 {
+    if (!sorting) {
+        queue.reset();
+    } else if (!queue) {
+        queue.reset(new render_queue());
+    }
 }
 
-void perspective_camera::render(std::shared_ptr<node> node, rendering_context& ctx, std::shared_ptr<program> prog)
+void camera::traverse(std::shared_ptr<node> node, rendering_context& ctx, std::shared_ptr<program> prog,
+    const matrix44f& projection)
 {
-    ctx.projection(frustum(cv.left, cv.right, cv.bottom, cv.top, cv.nearp, cv.farp));
-    ctx.push(position_and_orient());
+    matrix44f view = position_and_orient();
+    ctx.projection(projection);
+    ctx.push(view);
+    ctx.frame.update(projection, view, ctx.dir, static_cast<float>(ctx.elapsed_time_seconds));
     ctx.prog = prog;
+    ctx.queue = queue.get();
     node->render(ctx);
+    ctx.queue = nullptr;
+    if (queue) {
+        queue->submit(ctx);
+    }
     ctx.reset();
 }
 
+perspective_camera::perspective_camera(const clipping_volume& cv)
+: camera(cv)
+{
+}
+
+void perspective_camera::render(std::shared_ptr<node> node, rendering_context& ctx, std::shared_ptr<program> prog)
+{
+    traverse(node, ctx, prog, frustum(cv.left, cv.right, cv.bottom, cv.top, cv.nearp, cv.farp));
+}
+
+ray perspective_camera::ray_through(const viewport& vp, float x, float y)
+{
+    // the point of the near plane in eye coordinates back in world coordinates
+    matrix44f eye;
+    invert(position_and_orient(), eye);
+    float ex = cv.left + (x - vp.x) / vp.w * (cv.right - cv.left);
+    float ey = cv.bottom + (y - vp.y) / vp.h * (cv.top - cv.bottom);
+    vector3f origin = eye * vector3f(0.0f, 0.0f, 0.0f);
+    return ray{ origin, normalize(eye * vector3f(ex, ey, -cv.nearp) - origin) };
+}
+
 parallel_camera::parallel_camera(const clipping_volume& clippingVolume)
 : camera(clippingVolume)
 {
@@ -232,35 +295,154 @@ parallel_camera::parallel_camera(const clipping_volume& clippingVolume)
 
 void parallel_camera::render(std::shared_ptr<node> node, rendering_context& ctx, std::shared_ptr<program> prog)
 {
-    ctx.projection(ortho(cv.left, cv.right, cv.bottom, cv.top, cv.nearp, cv.farp));
-    ctx.push(position_and_orient());
-    ctx.prog = prog;
-    node->render(ctx);
-    ctx.reset();
+    traverse(node, ctx, prog, ortho(cv.left, cv.right, cv.bottom, cv.top, cv.nearp, cv.farp));
+}
+
+ray parallel_camera::ray_through(const viewport& vp, float x, float y)
+{
+    matrix44f eye;
+    invert(position_and_orient(), eye);
+    float ex = cv.left + (x - vp.x) / vp.w * (cv.right - cv.left);
+    float ey = cv.bottom + (y - vp.y) / vp.h * (cv.top - cv.bottom);
+    return ray{ eye * vector3f(ex, ey, -cv.nearp), normalize(transform_direction(eye, vector3f(0.0f, 0.0f, -1.0f))) };
+}
+
+static size_t current_bounds_generation = 0;
+
+void node::bounds_changed()
+{
+    current_bounds_generation++;
+}
+
+size_t node::bounds_generation()
+{
+    return current_bounds_generation;
 }
 
 group::group()
-: transform_callback([](rendering_context& ctx) { return identity<float>(); })
+: transform_callback([](rendering_context& ctx) { return identity<float>(); }),
+  fixed_transform(true), transform(identity<float>()), _bounds_generation(~(size_t)0)
 {
 }
 
 void group::set_transform_callback(std::function<matrix44f(rendering_context&)> f)
 {
     transform_callback = f;
+    fixed_transform = false;
+    bounds_changed();
+}
+
+void group::set_transform(const matrix44f& m)
+{
+    transform = m;
+    transform_callback = [m](rendering_context& /* ctx */) { return m; };
+    fixed_transform = true;
+    bounds_changed();
 }
 
 void group::add(std::shared_ptr<node> node)
 {
     children.push_back(node);
+    bounds_changed();
+}
+
+void group::set_program(std::shared_ptr<program> prog)
+{
+    this->prog = prog;
 }
 
 void group::render(rendering_context& ctx)
 {
+    std::shared_ptr<program> parent_prog = ctx.prog;
+    if (prog) {
+        ctx.prog = prog;
+    }
     ctx.push(transform_callback(ctx));
-    for (auto child : children) {
-        child->render(ctx);
+    clip_planes planes = extract_clip_planes(ctx.mvp());
+    size_t count = children.size();
+    for (size_t i = 0; i < count; i += 4) {
+        bounds b[4];
+        const bounds* boxes[4] = { nullptr, nullptr, nullptr, nullptr };
+        size_t n = std::min<size_t>(4, count - i);
+        for (size_t k = 0; k < n; k++) {
+            b[k] = children[i + k]->get_bounds();
+            boxes[k] = &b[k];
+        }
+        unsigned int visible = intersects(planes, boxes);
+        for (size_t k = 0; k < n; k++) {
+            if (visible & (1u << k)) {
+                ctx.culling.visited++;
+                children[i + k]->render(ctx);
+            } else {
+                ctx.culling.culled++;
+            }
+        }
     }
     ctx.pop();
+    ctx.prog = parent_prog;
+}
+
+bool group::local_ray(const ray& r, ray& local) const
+{
+    matrix44f inverse;
+    if (!fixed_transform || !invert(transform, inverse)) {
+        return false;
+    }
+    // not normalized, distances along the ray stay those of r
+    local.origin = inverse * r.origin;
+    local.direction = transform_direction(inverse, r.direction);
+    return true;
+}
+
+bool group::intersect_child(size_t child, const ray& r, ray_hit& hit)
+{
+    ray_hit h = hit;
+    h.hit_node = nullptr;
+    if (!children[child]->intersect(r, h)) {
+        return false;
+    }
+    if (h.hit_node == nullptr) {
+        h.hit_node = children[child];
+    }
+    hit = h;
+    return true;
+}
+
+bool group::intersect(const ray& r, ray_hit& hit)
+{
+    ray local;
+    if (!local_ray(r, local)) {
+        return false;
+    }
+    bool found = false;
+    for (size_t i = 0; i < children.size(); i++) {
+        found |= intersect_child(i, local, hit);
+    }
+    return found;
+}
+
+bounds group::get_bounds() const
+{
+    if (!fixed_transform) {
+        return bounds();
+    }
+    // the subtree is merged once per change of bounds anywhere, rather than at every call
+    if (_bounds_generation == bounds_generation()) {
+        return _bounds;
+    }
+    bounds merged;
+    merged.known = true;
+    merged.lo = vector3f(1.0f, 1.0f, 1.0f);
+    merged.hi = vector3f(-1.0f, -1.0f, -1.0f);
+    for (auto& child : children) {
+        merged = merge_bounds(merged, child->get_bounds());
+        if (!merged.known) {
+            break;
+        }
+    }
+    _bounds = merged.known ? transform_bounds(transform, merged) : merged;
+    _bounds_generation = bounds_generation();
+    return _bounds;
 }
 
 rendering_element::rendering_element(std::string name)
@@ -292,17 +474,19 @@ void custom_rendering_element::render(rendering_context& ctx)
 custom_rendering_element::callback yae::clear_viewport_callback(color4f c, viewport& vp)
 {
     return ([=, &vp](yae::rendering_context& ctx) {
-        glEnable(GL_SCISSOR_TEST);
-        glScissor(vp.x, vp.y, vp.w, vp.h);
+        gl_state& state = gl_state::current();
+        state.enable(GL_SCISSOR_TEST);
+        state.scissor(vp.x, vp.y, vp.w, vp.h);
         glClearColor(c.r(), c.g(), c.b(), c.a());
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glViewport(vp.x, vp.y, vp.w, vp.h);
+        state.viewport(vp.x, vp.y, vp.w, vp.h);
     });
 }
 
 rendering_scene::rendering_scene()
 {
     _desired_cv = clipping_volume{ -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f };
+    _viewport = viewport{ 0, 0, 0, 0 };
     _camera = std::make_shared<parallel_camera>(_desired_cv);
 }
  
@@ -313,9 +497,16 @@ void rendering_scene::add_element(std::shared_ptr<rendering_element> el)
 
 void rendering_scene::render(rendering_context& ctx)
 {
+    ctx.vp = _viewport;
     for (auto el : _rendering_elements) {
         el->render(ctx);
     }
+    ctx.vp = viewport{ 0, 0, 0, 0 };
+}
+
+std::unique_ptr<shared_context> window::create_shared_context()
+{
+    return nullptr;
 }
 
 window::window()
@@ -406,15 +597,66 @@ void window::render(rendering_context& ctx)
     swap();
 }
 
+engine::engine()
+{
+}
+
+engine::~engine()
+{
+    disable_upload_thread();
+}
+
 void engine::run(window* win)
 {
     while (!ctx.exit) {
+        ctx.last_culling = ctx.culling;
+        ctx.culling = culling_statistics{ 0, 0 };
+        ctx.last_sorting = ctx.sorting;
+        ctx.sorting = sorting_statistics{ 0, 0, 0, 0, 0 };
         ctx.elapsed_time_seconds = timer_absolute.elapsed();
         ctx.last_frame_times_seconds[ctx.frame_count % 100] = timer_frame.elapsed();
         timer_frame.reset();
         win->render(ctx);
+        // the meshes loaded in the background, within the budget of a frame
+        // or handed to the upload thread
+        async_loader::instance().upload();
+        if (uploads) {
+            uploads->poll();
+        }
         check_for_opengl_errors();
         ctx.frame_count++;
     }
+    disable_upload_thread();
+    async_loader::instance().shutdown();
+    // the geometries only the cache refers to are freed while the context is current
+    mesh_cache::instance().clear();
+}
+
+bool engine::enable_upload_thread(window* win)
+{
+    if (uploads) {
+        return true;
+    }
+    auto context = win->create_shared_context();
+    if (!context) {
+        return false;
+    }
+    uploads = std::make_unique<upload_thread>(std::move(context));
+    async_loader::instance().set_upload_thread(uploads.get());
+    return true;
+}
+
+void engine::disable_upload_thread()
+{
+    if (uploads) {
+        async_loader::instance().set_upload_thread(nullptr);
+        // publishes what was submitted
+        uploads.reset();
+    }
+}
+
+upload_thread* engine::get_upload_thread()
+{
+    return uploads.get();
 }
 
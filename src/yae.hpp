@@ -18,9 +18,12 @@ namespace yae {
 void check_for_opengl_errors();
 
 class rendering_context;
+class node;
 class program;
 class shader_program;
+class render_queue;
 struct window;
+class upload_thread;
     
 class timer {
 public:
@@ -42,29 +45,86 @@ private:
     GLuint id;
 };
 
+struct viewport {
+    int x;
+    int y;
+    int w;
+    int h;
+};
+
+// nodes drawn and skipped by frustum culling in a frame
+struct culling_statistics {
+    size_t visited;
+    size_t culled;
+};
+
+// draws sorted by render queues in a frame, with their program and texture
+// changes, sorted and in the order of the traversal
+struct sorting_statistics {
+    size_t draws;
+    size_t program_changes;
+    size_t texture_changes;
+    size_t unsorted_program_changes;
+    size_t unsorted_texture_changes;
+};
+
 class rendering_context {
 public:
     rendering_context();
-    void projection(matrix44f mat);
-    void push(matrix44f mat);
+    void projection(const matrix44f& mat);
+    void push(const matrix44f& mat);
     void pop();
     matrix44f mvp();
     matrix44f mv();
     void reset();
+    // replaces the stacks by the matrices, cf render_queue::submit
+    void load(const matrix44f& mvp, const matrix44f& mv);
+    // with prog and the current matrices, queued when there is a queue
+    void draw(const geometry<float>& geom);
     vector3f dir;
     double elapsed_time_seconds;
     double last_frame_times_seconds[100];
     long frame_count;
     std::shared_ptr<program> prog;
+    viewport vp; // of the scene being rendered, empty outside scenes
+    culling_statistics culling; // of the frame being rendered
+    culling_statistics last_culling; // of the previous frame
+    render_queue* queue; // of the camera rendering, nullptr when drawing immediately
+    sorting_statistics sorting; // of the frame being rendered
+    sorting_statistics last_sorting; // of the previous frame
+    frame_uniforms frame; // updated by each camera before rendering
     bool exit;
 private:
     std::vector<matrix44f> mvp_stack;
     std::vector<matrix44f> mv_stack;
 };
 
+// A half line, distances along it are in units of direction.
+struct ray {
+    vector3f origin;
+    vector3f direction;
+};
+
+// The nearest intersection of a ray with a scene, cf pick.
+struct ray_hit {
+    std::shared_ptr<node> hit_node; // the innermost node hit, nullptr if none
+    size_t triangle; // in the triangles of the node
+    float distance; // along the ray
+};
+
 class node {
 public:
     virtual void render(rendering_context& ctx) = 0;
+    // What render draws, in the coordinates it is rendered in, unknown by
+    // default. A node whose bounds change calls bounds_changed().
+    virtual bounds get_bounds() const { return bounds(); }
+    // Updates the triangle and distance of hit when the ray, in the coordinates
+    // the node is rendered in, hits it nearer than hit.distance. Groups set
+    // the node hit. Nothing is hit by default.
+    virtual bool intersect(const ray& /* r */, ray_hit& /* hit */) { return false; }
+    // the groups merge the bounds of their children again when the generation changes
+    static void bounds_changed();
+    static size_t bounds_generation();
 };
 
 struct clipping_volume {
@@ -83,16 +143,10 @@ struct viewport_relative {
     float height_percent;
 };
 
-struct viewport {
-    int x;
-    int y;
-    int w;
-    int h;
-};
-
 // cf http://www.codecolony.de/opengl.htm#camera2
 struct camera {
     camera(const clipping_volume& cv);
+    virtual ~camera();
     virtual void render(std::shared_ptr<node> node, rendering_context& ctx, std::shared_ptr<program> program) = 0;
     void reset();
     void rotate_x(float deg);
@@ -109,34 +163,72 @@ struct camera {
     float get_height();
     float get_width();
     matrix44f position_and_orient();
+    // The ray through the point x, y in pixels of the window, from its bottom
+    // left corner like vp, the pixel centers at half units.
+    virtual ray ray_through(const viewport& vp, float x, float y) = 0;
+    // the draws of a frame sorted by state and depth before they are issued,
+    // cf render_queue, issued while traversing by default
+    void set_sorting(bool sorting);
     vector3f position_v;
     vector3f direction_v;
     vector3f right_v;
     vector3f up_v;
     clipping_volume cv;
+protected:
+    // renders node with prog through the queue when sorting, after updating
+    // the frame uniforms with the projection and the view of the camera
+    void traverse(std::shared_ptr<node> node, rendering_context& ctx, std::shared_ptr<program> prog,
+        const matrix44f& projection);
+private:
+    std::unique_ptr<render_queue> queue;
 };
 
 class perspective_camera : public camera {
 public:
     perspective_camera(const clipping_volume& cv);
     virtual void render(std::shared_ptr<node> node, rendering_context& ctx, std::shared_ptr<program> program);
+    // from the position of the camera
+    virtual ray ray_through(const viewport& vp, float x, float y);
 };
 
 class parallel_camera : public camera {
 public:
     parallel_camera(const clipping_volume& cv);
     virtual void render(std::shared_ptr<node> node, rendering_context& ctx, std::shared_ptr<program> program);
+    // from the near plane, along the direction of the camera
+    virtual ray ray_through(const viewport& vp, float x, float y);
 };
 
+// Renders its children with a transform. The children outside the clip volume
+// are skipped, their bounds tested 4 at a time.
 class group : public node {
 public:
     group();
+    // evaluated each frame, the bounds of the group are then unknown
     void set_transform_callback(std::function<matrix44f(rendering_context&)> f);
+    // a transform kept until changed, the bounds of the group stay known
+    void set_transform(const matrix44f& transform);
     void add(std::shared_ptr<node> node);
+    // the program drawing the children instead of the one of the parent, none by default
+    void set_program(std::shared_ptr<program> prog);
     virtual void render(rendering_context& ctx);
+    // those of the children, merged again only after bounds changed
+    virtual bounds get_bounds() const;
+    // the children in turn, none when transformed by a callback
+    virtual bool intersect(const ray& r, ray_hit& hit);
 protected:
+    // r in the coordinates of the children, false when transformed by a callback
+    bool local_ray(const ray& r, ray& local) const;
+    // the child hit nearer than hit, set as the node hit unless one of its own
+    bool intersect_child(size_t child, const ray& r, ray_hit& hit);
     std::vector<std::shared_ptr<node>> children;
     std::function<matrix44f(rendering_context&)> transform_callback;
+    bool fixed_transform;
+    matrix44f transform;
+    std::shared_ptr<program> prog;
+private:
+    mutable bounds _bounds;
+    mutable size_t _bounds_generation; // of _bounds
 };
 
 template<class T>
@@ -144,7 +236,10 @@ class geometry_node : public node {
 public:
     geometry_node(std::shared_ptr<geometry<T>> geom) : geom(geom) {}
     virtual void render(rendering_context& ctx) {
-        ctx.prog->render(*geom, ctx);
+        ctx.draw(*geom);
+    }
+    virtual bounds get_bounds() const {
+        return geom->get_bounds();
     }
 private:
     std::shared_ptr<geometry<T>> geom;
@@ -222,6 +317,14 @@ private:
     std::shared_ptr<camera> _camera;
 };
 
+// A GL context sharing the buffers, textures and fences of a window,
+// current on another thread. Vertex array objects are not shared.
+struct shared_context {
+    virtual ~shared_context() {}
+    virtual void make_current() = 0;
+    virtual void done_current() = 0;
+};
+
 struct window {
 
     typedef std::function<void(rendering_context&)> resize_callback;
@@ -237,6 +340,8 @@ struct window {
     virtual int quit() = 0;
     virtual int keydown() = 0;
     virtual int window_resized() = 0;
+    // nullptr when the platform cannot share the context of the window
+    virtual std::unique_ptr<shared_context> create_shared_context();
     void close_when_keydown();
     void add_resize_callback(resize_callback f);
     void set_render_callback(render_callback f);
@@ -267,17 +372,28 @@ void rendering_scene::associate_camera(std::shared_ptr<camera> cam, window* win,
         _camera->cv = ClippingVolumeAdapter::adapt(_desired_cv, ar);
     };
     win->add_resize_callback(cb);
-    auto ctx = yae::rendering_context();
+    yae::rendering_context ctx;
     cb(ctx);
 }
 
 struct engine {
+    engine();
+    virtual ~engine();
     void run(window* win);
-    virtual std::unique_ptr<window> create_simple_window() = 0;
+    // a 3.3 core context when core_profile, 3.1 otherwise
+    virtual std::unique_ptr<window> create_simple_window(bool core_profile = false) = 0;
+    // Moves the buffer uploads of async_loader::instance() to a thread with a
+    // context shared with win, false when it cannot be created. Stops at the
+    // end of run, while win still exists.
+    bool enable_upload_thread(window* win);
+    void disable_upload_thread();
+    // nullptr when disabled, e.g. for upload_texture
+    upload_thread* get_upload_thread();
 private:
     timer timer_absolute;
     timer timer_frame;
     rendering_context ctx;
+    std::unique_ptr<upload_thread> uploads;
 };
 
 }
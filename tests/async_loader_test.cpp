@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+
+#include <async_loader.hpp>
+
+using namespace std;
+
+// uploads need a GL context, the tests stop once the data is prepared
+
+TEST(async_loader, prepares_on_worker_threads)
+{
+    yae::async_loader loader(2);
+    auto caller = this_thread::get_id();
+    thread::id worker;
+    auto handle = loader.load_builder([&]() {
+        worker = this_thread::get_id();
+        return yae::make_uv_sphere<float>(20, 10);
+    });
+    loader.wait_prepared();
+    ASSERT_NE(caller, worker);
+    ASSERT_FALSE(handle->has_failed());
+    // ready once uploaded only
+    ASSERT_FALSE(handle->is_ready());
+    ASSERT_EQ(1u, loader.pending());
+}
+
+TEST(async_loader, failed_loads_are_not_pending)
+{
+    yae::async_loader loader;
+    auto failed = loader.load([](yae::geometry_data&) { return false; });
+    auto missing = loader.load_file("missing.yaem");
+    loader.wait_prepared();
+    ASSERT_TRUE(failed->has_failed());
+    ASSERT_TRUE(missing->has_failed());
+    ASSERT_EQ(nullptr, failed->get());
+    ASSERT_EQ(0u, loader.pending());
+    ASSERT_EQ(0u, loader.upload());
+}
+
+TEST(async_loader, shutdown_fails_the_loads_not_uploaded)
+{
+    yae::async_loader loader;
+    auto handle = loader.load_builder([]() { return yae::make_box<float>(1, 1, 1); });
+    loader.wait_prepared();
+    loader.shutdown();
+    ASSERT_TRUE(handle->has_failed());
+    ASSERT_FALSE(handle->is_ready());
+    ASSERT_EQ(0u, loader.pending());
+    ASSERT_EQ(0u, loader.upload());
+}
@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <bvh.hpp>
+
+using namespace std;
+
+static yae::bounds box(float x, float y, float z, float half)
+{
+    float points[6] = { x - half, y - half, z - half, x + half, y + half, z + half };
+    return yae::bounds_of(points, 2);
+}
+
+static vector<yae::bounds> random_boxes(size_t count, unsigned int seed)
+{
+    mt19937 rng(seed);
+    uniform_real_distribution<float> position(-100.0f, 100.0f);
+    uniform_real_distribution<float> size(0.1f, 2.0f);
+    vector<yae::bounds> boxes;
+    for (size_t i = 0; i < count; i++) {
+        boxes.push_back(box(position(rng), position(rng), position(rng), size(rng)));
+    }
+    return boxes;
+}
+
+static bool overlap(const yae::bounds& a, const yae::bounds& b)
+{
+    return a.lo.x() <= b.hi.x() && b.lo.x() <= a.hi.x() && a.lo.y() <= b.hi.y() && b.lo.y() <= a.hi.y()
+        && a.lo.z() <= b.hi.z() && b.lo.z() <= a.hi.z();
+}
+
+static float distance2(const yae::bounds& b, const yae::vector3f& p)
+{
+    float dx = max(0.0f, max(b.lo.x() - p.x(), p.x() - b.hi.x()));
+    float dy = max(0.0f, max(b.lo.y() - p.y(), p.y() - b.hi.y()));
+    float dz = max(0.0f, max(b.lo.z() - p.z(), p.z() - b.hi.z()));
+    return dx * dx + dy * dy + dz * dz;
+}
+
+TEST(bvh, cull_keeps_every_visible_item)
+{
+    // enough items for the subtrees to be built in parallel
+    auto boxes = random_boxes(50000, 1);
+    yae::bvh tree;
+    tree.build(boxes);
+    ASSERT_EQ(boxes.size(), tree.size());
+    auto mvp = yae::multm(yae::frustum(-1.0f, 1.0f, -0.75f, 0.75f, 1.0f, 80.0f), yae::translation(0.0f, 0.0f, -20.0f));
+    auto planes = yae::extract_clip_planes(mvp);
+    vector<bool> visited(boxes.size(), false);
+    size_t visits = 0;
+    size_t culled = tree.cull(planes, [&](size_t item) { visited[item] = true; visits++; });
+    ASSERT_EQ(boxes.size(), visits + culled);
+    size_t visible = 0;
+    for (size_t i = 0; i < boxes.size(); i++) {
+        if (yae::intersects(planes, boxes[i])) {
+            ASSERT_TRUE(visited[i]);
+            visible++;
+        }
+    }
+    ASSERT_LE(visits, visible + visible / 100);
+    ASSERT_GT(culled, boxes.size() / 2);
+}
+
+TEST(bvh, range_and_nearest_match_brute_force)
+{
+    auto boxes = random_boxes(5000, 2);
+    yae::bvh tree;
+    tree.build(boxes);
+    mt19937 rng(3);
+    uniform_real_distribution<float> position(-120.0f, 120.0f);
+    for (int q = 0; q < 50; q++) {
+        auto query = box(position(rng), position(rng), position(rng), 15.0f);
+        vector<size_t> items;
+        tree.range(query, items);
+        sort(items.begin(), items.end());
+        vector<size_t> expected;
+        for (size_t i = 0; i < boxes.size(); i++) {
+            if (overlap(boxes[i], query)) {
+                expected.push_back(i);
+            }
+        }
+        ASSERT_EQ(expected, items);
+        yae::vector3f p(position(rng), position(rng), position(rng));
+        size_t item;
+        float d;
+        ASSERT_TRUE(tree.nearest(p, item, d));
+        float best = numeric_limits<float>::max();
+        for (auto& b : boxes) {
+            best = min(best, distance2(b, p));
+        }
+        ASSERT_FLOAT_EQ(best, d);
+        ASSERT_FLOAT_EQ(best, distance2(boxes[item], p));
+    }
+}
+
+TEST(bvh, update_refits_ancestors)
+{
+    auto boxes = random_boxes(2000, 4);
+    yae::bvh tree;
+    tree.build(boxes);
+    float cost = tree.sah_cost();
+    ASSERT_GT(cost, 0.0f);
+    ASSERT_LT(cost, 100.0f);
+    // the first items move far away, the tree must still find them
+    for (size_t i = 0; i < 100; i++) {
+        boxes[i] = box(300.0f + i, 0.0f, 0.0f, 0.5f);
+        tree.update(i, boxes[i]);
+    }
+    ASSERT_FLOAT_EQ(399.5f, tree.get_bounds().hi.x());
+    vector<size_t> items;
+    tree.range(box(350.0f, 0.0f, 0.0f, 60.0f), items);
+    sort(items.begin(), items.end());
+    ASSERT_EQ(100u, items.size());
+    ASSERT_EQ(99u, items.back());
+    // and shrink back when they return
+    for (size_t i = 0; i < 100; i++) {
+        boxes[i] = box(0.0f, 0.0f, 0.0f, 0.5f);
+        tree.update(i, boxes[i]);
+    }
+    ASSERT_LT(tree.get_bounds().hi.x(), 103.0f);
+    auto updated = tree.get_bounds();
+    tree.refit();
+    ASSERT_FLOAT_EQ(updated.hi.x(), tree.get_bounds().hi.x());
+    ASSERT_FLOAT_EQ(updated.lo.y(), tree.get_bounds().lo.y());
+}
+
+TEST(bvh, group_indexes_its_children)
+{
+    auto root = std::make_shared<yae::bvh_group>();
+    vector<std::shared_ptr<yae::group>> movers;
+    for (int i = 0; i < 100; i++) {
+        auto g = std::make_shared<yae::geometry<float>>(0, 3, GL_TRIANGLES);
+        g->set_bounds(box(0.0f, 0.0f, 0.0f, 0.5f));
+        auto mover = std::make_shared<yae::group>();
+        mover->add(std::make_shared<yae::geometry_node<float>>(g));
+        mover->set_transform(yae::translation(i * 10.0f, 0.0f, 0.0f));
+        movers.push_back(mover);
+        root->add(mover);
+    }
+    // an empty child, never indexed
+    root->add(std::make_shared<yae::group>());
+    ASSERT_EQ(movers[42], root->nearest(yae::vector3f(421.0f, 3.0f, 0.0f)));
+    movers[42]->set_transform(yae::translation(-500.0f, 0.0f, 0.0f));
+    root->invalidate(42);
+    ASSERT_EQ(movers[43], root->nearest(yae::vector3f(421.0f, 3.0f, 0.0f)));
+    vector<std::shared_ptr<yae::node>> found;
+    root->range(box(-500.0f, 0.0f, 0.0f, 1.0f), found);
+    ASSERT_EQ(1u, found.size());
+    ASSERT_EQ(movers[42], found[0]);
+    ASSERT_FLOAT_EQ(-500.5f, root->get_bounds().lo.x());
+}
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <culling.hpp>
+#include <yae.hpp>
+
+using namespace std;
+
+static yae::bounds box(float x, float y, float z, float half)
+{
+    float points[6] = { x - half, y - half, z - half, x + half, y + half, z + half };
+    return yae::bounds_of(points, 2);
+}
+
+TEST(culling, bounds_merge_and_transform)
+{
+    auto a = box(0.0f, 0.0f, 0.0f, 1.0f);
+    ASSERT_FLOAT_EQ(sqrt(3.0f), a.radius);
+    auto m = yae::merge_bounds(a, box(4.0f, 0.0f, 0.0f, 1.0f));
+    ASSERT_FLOAT_EQ(-1.0f, m.lo.x());
+    ASSERT_FLOAT_EQ(5.0f, m.hi.x());
+    ASSERT_FLOAT_EQ(2.0f, m.center.x());
+    ASSERT_FLOAT_EQ(2.0f + sqrt(3.0f), m.radius);
+    ASSERT_FALSE(yae::merge_bounds(a, yae::bounds()).known);
+    ASSERT_TRUE(yae::is_empty(yae::bounds_of(nullptr, 0)));
+    // a quarter turn around z then a translation
+    auto t = yae::transform_bounds(yae::multm(yae::translation(10.0f, 0.0f, 0.0f), yae::rotation(90.0f, 0.0f, 0.0f, 1.0f)), m);
+    ASSERT_NEAR(9.0f, t.lo.x(), 1e-5f);
+    ASSERT_NEAR(11.0f, t.hi.x(), 1e-5f);
+    ASSERT_NEAR(-1.0f, t.lo.y(), 1e-5f);
+    ASSERT_NEAR(5.0f, t.hi.y(), 1e-5f);
+    ASSERT_NEAR(m.radius, t.radius, 1e-5f);
+}
+
+TEST(culling, clip_planes_of_projections)
+{
+    auto parallel = yae::extract_clip_planes(yae::ortho(-10.0f, 10.0f, -10.0f, 10.0f, -1.0f, 1.0f));
+    ASSERT_TRUE(yae::intersects(parallel, box(0.0f, 0.0f, 0.0f, 1.0f)));
+    ASSERT_TRUE(yae::intersects(parallel, box(10.5f, 0.0f, 0.0f, 1.0f)));
+    ASSERT_FALSE(yae::intersects(parallel, box(11.5f, 0.0f, 0.0f, 1.0f)));
+    ASSERT_FALSE(yae::intersects(parallel, box(0.0f, 0.0f, 3.0f, 1.0f)));
+    ASSERT_TRUE(yae::intersects(parallel, yae::bounds()));
+    ASSERT_FALSE(yae::intersects(parallel, yae::bounds_of(nullptr, 0)));
+    auto mvp = yae::multm(yae::frustum(-1.0f, 1.0f, -1.0f, 1.0f, 1.0f, 100.0f), yae::translation(0.0f, 0.0f, -10.0f));
+    auto perspective = yae::extract_clip_planes(mvp);
+    ASSERT_TRUE(yae::intersects(perspective, box(0.0f, 0.0f, 0.0f, 1.0f)));
+    // the cone widens with the distance
+    ASSERT_FALSE(yae::intersects(perspective, box(13.0f, 0.0f, 0.0f, 1.0f)));
+    ASSERT_TRUE(yae::intersects(perspective, box(12.0f, 0.0f, -20.0f, 1.0f)));
+    // behind the eye and past the far plane
+    ASSERT_FALSE(yae::intersects(perspective, box(0.0f, 0.0f, 15.0f, 1.0f)));
+    ASSERT_FALSE(yae::intersects(perspective, box(0.0f, 0.0f, -100.0f, 1.0f)));
+}
+
+TEST(culling, four_boxes_match_one_at_a_time)
+{
+    auto mvp = yae::multm(yae::frustum(-1.0f, 1.0f, -0.75f, 0.75f, 1.0f, 50.0f),
+        yae::rotation(30.0f, 0.0f, 1.0f, 0.0f), yae::translation(0.0f, -1.0f, -5.0f));
+    auto planes = yae::extract_clip_planes(mvp);
+    mt19937 rng(7);
+    uniform_real_distribution<float> position(-40.0f, 40.0f);
+    uniform_real_distribution<float> size(0.0f, 3.0f);
+    vector<yae::bounds> boxes;
+    for (int i = 0; i < 4000; i++) {
+        boxes.push_back(box(position(rng), position(rng), position(rng), size(rng)));
+    }
+    boxes[5] = yae::bounds();
+    boxes[6] = yae::bounds_of(nullptr, 0);
+    size_t visible = 0;
+    for (size_t i = 0; i < boxes.size(); i += 4) {
+        const yae::bounds* batch[4] = { &boxes[i], &boxes[i + 1], &boxes[i + 2], i + 3 < 16 ? nullptr : &boxes[i + 3] };
+        unsigned int mask = yae::intersects(planes, batch);
+        for (int k = 0; k < 4; k++) {
+            bool expected = batch[k] != nullptr && yae::intersects(planes, *batch[k]);
+            ASSERT_EQ(expected, (mask & (1u << k)) != 0);
+            visible += expected ? 1 : 0;
+        }
+    }
+    ASSERT_GT(visible, 0u);
+    ASSERT_LT(visible, boxes.size() / 2);
+}
+
+TEST(culling, builder_and_group_bounds)
+{
+    auto geomb = yae::make_box<float>(2, 2, 2);
+    auto b = geomb.compute_bounds();
+    ASSERT_TRUE(b.known);
+    auto data = geomb.build_data(geomb.default_format());
+    ASSERT_FLOAT_EQ(b.lo.x(), data.model_bounds.lo.x());
+    ASSERT_FLOAT_EQ(b.radius, data.model_bounds.radius);
+    auto g = std::make_shared<yae::geometry<float>>(0, 3, GL_TRIANGLES);
+    g->set_bounds(b);
+    auto root = std::make_shared<yae::group>();
+    root->add(std::make_shared<yae::geometry_node<float>>(g));
+    root->set_transform(yae::translation(5.0f, 0.0f, 0.0f));
+    auto moved = root->get_bounds();
+    ASSERT_TRUE(moved.known);
+    ASSERT_FLOAT_EQ(b.lo.x() + 5.0f, moved.lo.x());
+    root->set_transform_callback([](yae::rendering_context&) { return yae::identity<float>(); });
+    ASSERT_FALSE(root->get_bounds().known);
+}
+
+namespace {
+
+// counts the calls of get_bounds
+struct counting_node : public yae::node {
+    counting_node(const yae::bounds& b) : b(b), calls(0) {}
+    virtual void render(yae::rendering_context& /* ctx */) {}
+    virtual yae::bounds get_bounds() const { calls++; return b; }
+    yae::bounds b;
+    mutable int calls;
+};
+
+}
+
+TEST(culling, group_bounds_merged_once_per_change)
+{
+    auto leaf = std::make_shared<counting_node>(box(0.0f, 0.0f, 0.0f, 1.0f));
+    auto inner = std::make_shared<yae::group>();
+    inner->add(leaf);
+    auto root = std::make_shared<yae::group>();
+    root->add(inner);
+    ASSERT_FLOAT_EQ(1.0f, root->get_bounds().hi.x());
+    ASSERT_FLOAT_EQ(1.0f, root->get_bounds().hi.x());
+    ASSERT_FLOAT_EQ(1.0f, inner->get_bounds().hi.x());
+    ASSERT_EQ(1, leaf->calls);
+    // changes below the root are seen from it
+    inner->set_transform(yae::translation(2.0f, 0.0f, 0.0f));
+    ASSERT_FLOAT_EQ(3.0f, root->get_bounds().hi.x());
+    inner->add(std::make_shared<counting_node>(box(10.0f, 0.0f, 0.0f, 1.0f)));
+    ASSERT_FLOAT_EQ(13.0f, root->get_bounds().hi.x());
+    leaf->b = box(20.0f, 0.0f, 0.0f, 1.0f);
+    yae::node::bounds_changed();
+    ASSERT_FLOAT_EQ(23.0f, root->get_bounds().hi.x());
+    ASSERT_EQ(4, leaf->calls);
+}
@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+
+#include <geometry_batch.hpp>
+
+using namespace std;
+
+TEST(geometry_batch, geometries_share_the_buffers)
+{
+    auto format = yae::position_layout::format();
+    auto box = yae::make_box<float>(1, 1, 1).build_data(format);
+    auto sphere = yae::make_octahedron_sphere<float>(2).build_data(format);
+    yae::geometry_batch batch(format);
+    ASSERT_EQ(0u, batch.add(box, yae::translation(10.0f, 0.0f, 0.0f)));
+    ASSERT_EQ(1u, batch.add(sphere, yae::identity<float>(), yae::color4f(1.0f, 0.0f, 0.0f)));
+    ASSERT_EQ(2u, batch.add_copy(0, yae::translation(-10.0f, 0.0f, 0.0f)));
+    ASSERT_EQ(3u, batch.size());
+    auto& draws = batch.draws();
+    ASSERT_EQ(0u, draws[0].first_index);
+    ASSERT_EQ(0, draws[0].base_vertex);
+    ASSERT_EQ(static_cast<GLuint>(box.count), draws[0].count);
+    ASSERT_EQ(static_cast<GLuint>(box.count), draws[1].first_index);
+    ASSERT_EQ(static_cast<GLint>(box.vertices.size() / format.stride), draws[1].base_vertex);
+    ASSERT_EQ(static_cast<GLuint>(sphere.count), draws[1].count);
+    // the copy draws the same range as another instance
+    ASSERT_EQ(draws[0].first_index, draws[2].first_index);
+    ASSERT_EQ(draws[0].base_vertex, draws[2].base_vertex);
+    for (GLuint i = 0; i < 3; i++) {
+        ASSERT_EQ(i, draws[i].base_instance);
+        ASSERT_EQ(1u, draws[i].instance_count);
+    }
+    auto b = batch.get_bounds();
+    ASSERT_TRUE(b.known);
+    ASSERT_NEAR(-10.0f + box.model_bounds.lo.x(), b.lo.x(), 1e-5f);
+    ASSERT_NEAR(10.0f + box.model_bounds.hi.x(), b.hi.x(), 1e-5f);
+    batch.set_transform(2, yae::translation(0.0f, 0.0f, 0.0f));
+    ASSERT_NEAR(min(box.model_bounds.lo.x(), sphere.model_bounds.lo.x()), batch.get_bounds().lo.x(), 1e-5f);
+}
+
+TEST(geometry_batch, rejects_other_formats_and_strips)
+{
+    yae::geometry_batch batch(yae::position_layout::format());
+    auto normals = yae::make_box<float>(1, 1, 1).build_data(yae::position_normal_layout::format());
+    ASSERT_EQ(yae::geometry_batch::not_added, batch.add(normals, yae::identity<float>()));
+    auto strips = yae::make_box<float>(2, 2, 2).set_strips(true).build_data(yae::position_layout::format());
+    ASSERT_EQ(yae::geometry_batch::not_added, batch.add(strips, yae::identity<float>()));
+    ASSERT_EQ(0u, batch.size());
+    ASSERT_TRUE(yae::is_empty(batch.get_bounds()));
+}
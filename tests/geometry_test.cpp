@@ -0,0 +1,215 @@
+#include <gtest/gtest.h>
+
+#include <geometry.hpp>
+
+using namespace std;
+
+TEST(geometry, bulk_transform_matches_per_vertex)
+{
+    // enough vertices to be split across threads, and a count
+    // that is not a multiple of the SIMD width
+    auto data = yae::make_grid_data<float>(301, 257);
+    data.insert(data.end(), { 1.0f, 2.0f, 3.0f });
+    auto tr = yae::multm(yae::rotation(33.0f, 0.0f, 0.6f, 0.8f), yae::translation(1.5f, -2.0f, 0.25f));
+    auto geomb = yae::geometry_builder<float>{3, GL_QUADS};
+    geomb.append(data).transform(tr);
+    auto transformed = geomb.data();
+    ASSERT_EQ(data.size(), transformed.size());
+    for (size_t i = 0; i < data.size(); i += 3) {
+        auto expected = tr * yae::vector3f(&data[i]);
+        ASSERT_EQ(expected.x(), transformed[i]);
+        ASSERT_EQ(expected.y(), transformed[i + 1]);
+        ASSERT_EQ(expected.z(), transformed[i + 2]);
+    }
+}
+
+TEST(geometry, nested_transform)
+{
+    auto geomb = yae::geometry_builder<float>{3, GL_TRIANGLES};
+    geomb.append(yae::vector3f(1.0f, 0.0f, 0.0f));
+    geomb.begin().append(yae::vector3f(0.0f, 1.0f, 0.0f)).transform(yae::translation(0.0f, 0.0f, 2.0f)).end();
+    auto data = geomb.data();
+    ASSERT_EQ(6u, data.size());
+    ASSERT_FLOAT_EQ(0.0f, data[2]);
+    ASSERT_FLOAT_EQ(2.0f, data[5]);
+}
+
+TEST(geometry, weld_grid_vertices)
+{
+    auto data = yae::make_grid_data<float>(4, 3);
+    std::vector<GLuint> remap;
+    std::vector<GLuint> first;
+    yae::weld_vertices(data.data(), data.size() / 3, 3 * sizeof(float), remap, first);
+    ASSERT_EQ(4u * 3u * 4u, remap.size());
+    ASSERT_EQ(5u * 4u, first.size());
+    for (size_t i = 0; i < remap.size(); i++) {
+        ASSERT_EQ(0, memcmp(&data[first[remap[i]] * 3], &data[i * 3], 3 * sizeof(float)));
+    }
+}
+
+TEST(geometry, vertex_layout_format)
+{
+    typedef yae::vertex_layout<
+        yae::attribute<yae::vertex_attribute::POSITION, 3>,
+        yae::attribute<yae::vertex_attribute::TEXCOORD, 2, GLushort, true>,
+        yae::attribute<yae::vertex_attribute::NORMAL, 3, GLbyte, true>> layout;
+    auto format = layout::format();
+    ASSERT_EQ(12 + 4 + 4, layout::stride);
+    ASSERT_EQ(layout::stride, format.stride);
+    ASSERT_EQ(3u, format.elements.size());
+    ASSERT_EQ(0, format.find(yae::vertex_attribute::POSITION)->offset);
+    ASSERT_EQ(12, format.find(yae::vertex_attribute::TEXCOORD)->offset);
+    ASSERT_EQ(GL_UNSIGNED_SHORT, format.find(yae::vertex_attribute::TEXCOORD)->type);
+    ASSERT_EQ(16, format.find(yae::vertex_attribute::NORMAL)->offset);
+    ASSERT_EQ(yae::attribute_bit(yae::vertex_attribute::POSITION) | yae::attribute_bit(yae::vertex_attribute::TEXCOORD)
+        | yae::attribute_bit(yae::vertex_attribute::NORMAL), format.attributes());
+}
+
+TEST(geometry, interleaved_vertices)
+{
+    auto geomb = yae::geometry_builder<float>{3, GL_TRIANGLES};
+    geomb.append(yae::vector3f(1.0f, 2.0f, 3.0f)).append(yae::vector3f(4.0f, 5.0f, 6.0f));
+    geomb.set_normals({ 0.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.0f });
+    auto format = yae::position_normal_layout::format();
+    auto bytes = geomb.vertices(format);
+    ASSERT_EQ(2u * 24u, bytes.size());
+    float v[12];
+    memcpy(v, bytes.data(), sizeof(v));
+    ASSERT_FLOAT_EQ(1.0f, v[0]);
+    ASSERT_FLOAT_EQ(3.0f, v[2]);
+    ASSERT_FLOAT_EQ(1.0f, v[5]);
+    ASSERT_FLOAT_EQ(4.0f, v[6]);
+    ASSERT_FLOAT_EQ(-1.0f, v[10]);
+}
+
+TEST(geometry, float_to_half)
+{
+    ASSERT_EQ(0x0000, yae::float_to_half(0.0f));
+    ASSERT_EQ(0x3c00, yae::float_to_half(1.0f));
+    ASSERT_EQ(0xc000, yae::float_to_half(-2.0f));
+    ASSERT_EQ(0x3555, yae::float_to_half(1.0f / 3.0f));
+    ASSERT_EQ(0x7bff, yae::float_to_half(65504.0f));
+    ASSERT_EQ(0x7c00, yae::float_to_half(1e6f));
+    ASSERT_EQ(0x0001, yae::float_to_half(5.96e-8f));
+    ASSERT_EQ(0x0400, yae::float_to_half(6.1035156e-5f));
+}
+
+TEST(geometry, quantized_vertices)
+{
+    auto geomb = yae::geometry_builder<float>{3, GL_TRIANGLES};
+    geomb.append(yae::vector3f(-1.0f, 10.0f, 5.0f)).append(yae::vector3f(3.0f, 20.0f, 5.0f));
+    geomb.set_normals({ 0.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.0f });
+    auto format = geomb.set_quantized(true).default_format();
+    ASSERT_EQ(yae::quantized_position_normal_layout::stride, format.stride);
+    ASSERT_EQ(12, format.stride);
+    auto bytes = geomb.vertices(format);
+    auto tr = geomb.position_transform(format);
+    for (int v = 0; v < 2; v++) {
+        GLshort s[3];
+        memcpy(s, &bytes[v * format.stride], sizeof(s));
+        auto p = tr * yae::vector3f(s[0] / 32767.0f, s[1] / 32767.0f, s[2] / 32767.0f);
+        auto expected = v == 0 ? yae::vector3f(-1.0f, 10.0f, 5.0f) : yae::vector3f(3.0f, 20.0f, 5.0f);
+        ASSERT_NEAR(expected.x(), p.x(), 1e-3f);
+        ASSERT_NEAR(expected.y(), p.y(), 1e-3f);
+        ASSERT_NEAR(expected.z(), p.z(), 1e-3f);
+    }
+    GLuint n[2];
+    memcpy(&n[0], &bytes[8], sizeof(GLuint));
+    memcpy(&n[1], &bytes[format.stride + 8], sizeof(GLuint));
+    ASSERT_EQ(511u << 20, n[0]);
+    ASSERT_EQ(((GLuint)-511 & 0x3ff) << 10, n[1]);
+}
+
+TEST(geometry, generate_normals)
+{
+    auto geomb = yae::make_box<float>(2, 3, 4);
+    auto data = geomb.data();
+    auto flat = geomb.generate_normals(yae::normal_generation::flat);
+    ASSERT_EQ(data.size(), flat.size());
+    // the normals of the first face of the box, which is in the z = 2 plane
+    for (int v = 0; v < 4; v++) {
+        ASSERT_FLOAT_EQ(2.0f, data[v * 3 + 2]);
+        ASSERT_FLOAT_EQ(1.0f, flat[v * 3 + 2]);
+    }
+    // those of every face pointing out of the box, which is centered on the origin
+    float half[3] = { 1.0f, 1.5f, 2.0f };
+    size_t faces[3][2] = { { 0, 0 }, { 0, 0 }, { 0, 0 } };
+    for (size_t v = 0; v < data.size(); v += 3) {
+        yae::vector3f n(&flat[v]);
+        int axis = std::abs(n.x()) > 0.5f ? 0 : std::abs(n.y()) > 0.5f ? 1 : 2;
+        ASSERT_NEAR(1.0f, std::abs(flat[v + axis]), 1e-5f);
+        ASSERT_NEAR(half[axis] * flat[v + axis], data[v + axis], 1e-5f);
+        faces[axis][flat[v + axis] > 0.0f ? 1 : 0]++;
+    }
+    // 2 by 3, 4 by 3 and 2 by 4 quads of 4 vertices on each side
+    ASSERT_EQ(24u, faces[2][0]);
+    ASSERT_EQ(24u, faces[2][1]);
+    ASSERT_EQ(48u, faces[0][0]);
+    ASSERT_EQ(48u, faces[0][1]);
+    ASSERT_EQ(32u, faces[1][0]);
+    ASSERT_EQ(32u, faces[1][1]);
+    auto smooth = geomb.generate_normals(yae::normal_generation::smooth);
+    for (size_t v = 0; v < data.size(); v += 3) {
+        ASSERT_GT(yae::dot_product(yae::vector3f(&smooth[v]), yae::vector3f(&data[v])), 0.0f);
+    }
+}
+
+TEST(geometry, generate_smooth_normals)
+{
+    auto geomb = yae::make_octahedron_sphere<float>(4);
+    auto data = geomb.data();
+    auto smooth = geomb.generate_normals(yae::normal_generation::smooth);
+    ASSERT_EQ(data.size(), smooth.size());
+    // on a unit sphere the normal at a vertex is close to its position
+    for (size_t v = 0; v < data.size(); v += 3) {
+        yae::vector3f n(&smooth[v]);
+        ASSERT_NEAR(1.0f, yae::length(n), 1e-5f);
+        ASSERT_GT(yae::dot_product(n, yae::vector3f(&data[v])), 0.99f);
+    }
+}
+
+TEST(geometry, smooth_normals_weld_signed_zeros)
+{
+    auto geomb = yae::geometry_builder<float>{3, GL_TRIANGLES};
+    geomb.append(yae::vector3f(0.0f, 0.0f, 0.0f)).append(yae::vector3f(1.0f, 0.0f, 0.0f)).append(yae::vector3f(0.0f, 1.0f, 0.0f));
+    geomb.append(yae::vector3f(-0.0f, 0.0f, 0.0f)).append(yae::vector3f(0.0f, 0.0f, 1.0f)).append(yae::vector3f(1.0f, 0.0f, 0.0f));
+    auto smooth = geomb.generate_normals(yae::normal_generation::smooth);
+    for (int c = 0; c < 3; c++) {
+        ASSERT_FLOAT_EQ(smooth[c], smooth[9 + c]);
+        ASSERT_FLOAT_EQ(smooth[3 + c], smooth[15 + c]);
+    }
+    ASSERT_GT(smooth[1], 0.5f);
+    ASSERT_GT(smooth[2], 0.5f);
+}
+
+TEST(geometry, generated_normals_are_not_kept)
+{
+    auto geomb = yae::geometry_builder<float>{3, GL_TRIANGLES};
+    geomb.append(yae::vector3f(0.0f, 0.0f, 0.0f)).append(yae::vector3f(1.0f, 0.0f, 0.0f)).append(yae::vector3f(0.0f, 1.0f, 0.0f));
+    geomb.set_normals({ 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f });
+    auto format = yae::position_normal_layout::format();
+    auto generated = geomb.set_normal_generation(yae::normal_generation::flat).build_data(format);
+    float n[3];
+    memcpy(n, &generated.vertices[12], sizeof(n));
+    ASSERT_FLOAT_EQ(1.0f, n[2]);
+    // the normals set are those written again once the generation is off
+    auto bytes = geomb.set_normal_generation(yae::normal_generation::none).vertices(format);
+    memcpy(n, &bytes[12], sizeof(n));
+    ASSERT_FLOAT_EQ(1.0f, n[0]);
+    ASSERT_FLOAT_EQ(0.0f, n[2]);
+}
+
+TEST(geometry, builder_groups_share_storage)
+{
+    static_assert(!std::is_copy_constructible<yae::geometry_builder<float>>::value, "builders are move only");
+    auto geomb = yae::geometry_builder<float>{3, GL_QUADS};
+    geomb.reserve(8);
+    geomb.begin().append_grid(1, 1).transform(yae::translation(0.0f, 0.0f, 1.0f)).end();
+    geomb.begin().append_grid(1, 1).end();
+    auto moved = std::move(geomb);
+    auto data = moved.data();
+    ASSERT_EQ(8u * 3u, data.size());
+    ASSERT_FLOAT_EQ(1.0f, data[2]);
+    ASSERT_FLOAT_EQ(0.0f, data[14]);
+    ASSERT_EQ(yae::make_grid_data<float>(1, 1), std::vector<float>(data.begin() + 12, data.end()));
+}
@@ -0,0 +1,31 @@
+#include <gtest/gtest.h>
+
+#include <instancing.hpp>
+
+using namespace std;
+
+TEST(instancing, bounds_of_instances)
+{
+    float points[6] = { -1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+    auto b = yae::bounds_of(points, 2);
+    vector<yae::matrix44f> transforms = {
+        yae::translation(10.0f, 0.0f, 0.0f),
+        yae::multm(yae::translation(0.0f, -5.0f, 0.0f), yae::scaling(2.0f, 2.0f, 2.0f))
+    };
+    auto merged = yae::instances_bounds(b, transforms);
+    ASSERT_TRUE(merged.known);
+    ASSERT_FLOAT_EQ(-2.0f, merged.lo.x());
+    ASSERT_FLOAT_EQ(-7.0f, merged.lo.y());
+    ASSERT_FLOAT_EQ(11.0f, merged.hi.x());
+    ASSERT_FLOAT_EQ(1.0f, merged.hi.y());
+    ASSERT_TRUE(yae::is_empty(yae::instances_bounds(b, {})));
+    ASSERT_FALSE(yae::instances_bounds(yae::bounds(), transforms).known);
+}
+
+TEST(instancing, matrix_attribute_takes_4_locations)
+{
+    ASSERT_EQ(0xf0u, yae::attribute_bits(yae::vertex_attribute::INSTANCE_TRANSFORM));
+    ASSERT_EQ(0xf00u, yae::attribute_bits(yae::vertex_attribute::INSTANCE_POSITION_TRANSFORM));
+    ASSERT_EQ(yae::attribute_bit(yae::vertex_attribute::INSTANCE_COLOR),
+        yae::attribute_bits(yae::vertex_attribute::INSTANCE_COLOR));
+}
@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include <lod.hpp>
+
+using namespace std;
+
+namespace {
+
+// records the geometries it draws
+struct recording_program : public yae::program {
+    virtual void render(const yae::geometry<float>& geometry, yae::rendering_context& /* ctx */) {
+        drawn.push_back(&geometry);
+    }
+    vector<const yae::geometry<float>*> drawn;
+};
+
+}
+
+TEST(lod, projected_diameter)
+{
+    yae::viewport vp{ 0, 0, 200, 200 };
+    auto parallel = yae::ortho(-10.0f, 10.0f, -10.0f, 10.0f, -1.0f, 1.0f);
+    ASSERT_NEAR(20.0f, yae::projected_diameter(parallel, vp, yae::vector3f(5.0f, 0.0f, 0.0f), 1.0f), 1e-3f);
+    // a radius of 1 at a distance of 10 covers a tenth of the half viewport
+    auto perspective = yae::frustum(-1.0f, 1.0f, -1.0f, 1.0f, 1.0f, 100.0f);
+    auto mvp = yae::multm(perspective, yae::translation(0.0f, 0.0f, -10.0f));
+    ASSERT_NEAR(20.0f, yae::projected_diameter(mvp, vp, yae::vector3f(), 1.0f), 1e-3f);
+    ASSERT_NEAR(10.0f, yae::projected_diameter(mvp, vp, yae::vector3f(0.0f, 0.0f, -10.0f), 1.0f), 1e-3f);
+    ASSERT_EQ(numeric_limits<float>::max(), yae::projected_diameter(mvp, vp, yae::vector3f(0.0f, 0.0f, 9.5f), 1.0f));
+}
+
+TEST(lod, selector_hysteresis)
+{
+    yae::lod_selector selector(3);
+    ASSERT_EQ(0u, selector.select(300.0f));
+    // within 10% of the 256 pixels threshold, no switch either way
+    ASSERT_EQ(0u, selector.select(240.0f));
+    ASSERT_EQ(1u, selector.select(200.0f));
+    ASSERT_EQ(1u, selector.select(270.0f));
+    ASSERT_EQ(0u, selector.select(290.0f));
+    ASSERT_EQ(2u, selector.select(10.0f));
+    ASSERT_EQ(2u, selector.select(135.0f));
+    ASSERT_EQ(1u, selector.select(145.0f));
+    selector.set_hysteresis(0.0f);
+    ASSERT_EQ(0u, selector.select(256.0f));
+}
+
+TEST(lod, more_thresholds_than_levels)
+{
+    vector<shared_ptr<yae::geometry<float>>> levels = {
+        make_shared<yae::geometry<float>>(3, 3, GL_TRIANGLES), make_shared<yae::geometry<float>>(3, 3, GL_TRIANGLES) };
+    yae::lod_node<float> node(levels, yae::vector3f(), 1.0f);
+    node.selector().set_thresholds({ 100.0f, 10.0f, 1.0f, 0.0f });
+    auto prog = make_shared<recording_program>();
+    yae::rendering_context ctx;
+    ctx.prog = prog;
+    ctx.vp = yae::viewport{ 0, 0, 200, 200 };
+    // far enough for the last threshold
+    ctx.push(yae::multm(yae::frustum(-1.0f, 1.0f, -1.0f, 1.0f, 1.0f, 10000.0f), yae::translation(0.0f, 0.0f, -5000.0f)));
+    node.render(ctx);
+    ASSERT_EQ(3u, node.selector().current());
+    ASSERT_EQ(1u, prog->drawn.size());
+    ASSERT_EQ(levels[1].get(), prog->drawn[0]);
+}
@@ -23,3 +23,67 @@ TEST(matrix, midpoint)
     ASSERT_FLOAT_EQ(2.5f, v3.y());
     ASSERT_FLOAT_EQ(3.5f, v3.z());
 }
+
+static yae::matrix44f make_test_matrix(float seed)
+{
+    yae::matrix44f m;
+    for (int i = 0; i < 16; i++) {
+        m.m[i] = seed * (i + 1) - 0.37f * i * i;
+    }
+    return m;
+}
+
+TEST(matrix, multm_matches_scalar)
+{
+    auto m1 = make_test_matrix(0.5f);
+    auto m2 = make_test_matrix(-1.25f);
+    auto m = yae::multm(m1, m2);
+    auto expected = yae::multm_scalar(m1, m2);
+    for (int i = 0; i < 16; i++) {
+        ASSERT_FLOAT_EQ(expected.m[i], m.m[i]);
+    }
+}
+
+TEST(matrix, multm_identity)
+{
+    auto m1 = make_test_matrix(2.0f);
+    auto m = yae::multm(yae::identity<float>(), m1, yae::identity<float>());
+    for (int i = 0; i < 16; i++) {
+        ASSERT_FLOAT_EQ(m1.m[i], m.m[i]);
+    }
+}
+
+TEST(matrix, transform_vector)
+{
+    auto m = yae::multm(yae::translation(1.0f, 2.0f, 3.0f), yae::rotation(90.0f, 0.0f, 0.0f, 1.0f));
+    auto v = m * yae::vector3f{ 1.0f, 0.0f, 0.0f };
+    ASSERT_NEAR(1.0f, v.x(), 1e-6f);
+    ASSERT_NEAR(3.0f, v.y(), 1e-6f);
+    ASSERT_NEAR(3.0f, v.z(), 1e-6f);
+}
+
+TEST(matrix, look_at_matches_translation_product)
+{
+    auto m = yae::look_at(1.0f, 2.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+    auto eye = m * yae::vector3f{ 1.0f, 2.0f, 5.0f };
+    ASSERT_NEAR(0.0f, eye.x(), 1e-5f);
+    ASSERT_NEAR(0.0f, eye.y(), 1e-5f);
+    ASSERT_NEAR(0.0f, eye.z(), 1e-5f);
+    auto center = m * yae::vector3f{ 0.0f, 0.0f, 0.0f };
+    ASSERT_NEAR(0.0f, center.x(), 1e-5f);
+    ASSERT_NEAR(0.0f, center.y(), 1e-5f);
+    ASSERT_NEAR(-sqrt(30.0f), center.z(), 1e-5f);
+}
+
+TEST(matrix, invert)
+{
+    auto m = yae::multm(yae::translation(1.0f, -2.0f, 3.0f), yae::rotation(30.0f, 1.0f, 2.0f, 0.5f), yae::scaling(2.0f, 0.5f, 4.0f));
+    yae::matrix44f inverse;
+    ASSERT_TRUE(yae::invert(m, inverse));
+    auto product = yae::multm(m, inverse);
+    auto identity = yae::identity<float>();
+    for (int i = 0; i < 16; i++) {
+        ASSERT_NEAR(identity.m[i], product.m[i], 1e-5f);
+    }
+    ASSERT_FALSE(yae::invert(yae::scaling(1.0f, 0.0f, 1.0f), inverse));
+}
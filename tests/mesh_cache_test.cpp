@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+
+#include <mesh_cache.hpp>
+
+using namespace std;
+
+// geometries without buffers, no GL context is needed to create or delete them
+static yae::mesh_cache::build_function counting_build(int& builds)
+{
+    return [&builds]() {
+        builds++;
+        return make_unique<yae::geometry<float>>(3, 3, GL_TRIANGLES);
+    };
+}
+
+TEST(mesh_cache, same_key_shares_geometry)
+{
+    yae::mesh_cache cache;
+    int builds = 0;
+    auto g1 = cache.get(yae::mesh_key{ "box", { 1, 2, 3 }, GL_QUADS }, counting_build(builds));
+    auto g2 = cache.get(yae::mesh_key{ "box", { 1, 2, 3 }, GL_QUADS }, counting_build(builds));
+    auto g3 = cache.get(yae::mesh_key{ "box", { 1, 2, 4 }, GL_QUADS }, counting_build(builds));
+    auto g4 = cache.get(yae::mesh_key{ "box", { 1, 2, 3 }, GL_TRIANGLES }, counting_build(builds));
+    ASSERT_EQ(g1, g2);
+    ASSERT_NE(g1, g3);
+    ASSERT_NE(g1, g4);
+    ASSERT_EQ(3, builds);
+    ASSERT_EQ(1u, cache.hits());
+    ASSERT_EQ(3u, cache.misses());
+    ASSERT_EQ(3u, cache.size());
+}
+
+TEST(mesh_cache, eviction)
+{
+    yae::mesh_cache cache;
+    int builds = 0;
+    cache.set_capacity(2);
+    auto a = cache.get(yae::mesh_key{ "a", {}, GL_TRIANGLES }, counting_build(builds));
+    cache.get(yae::mesh_key{ "b", {}, GL_TRIANGLES }, counting_build(builds));
+    cache.get(yae::mesh_key{ "a", {}, GL_TRIANGLES }, counting_build(builds));
+    // b is the least recently used
+    cache.get(yae::mesh_key{ "c", {}, GL_TRIANGLES }, counting_build(builds));
+    ASSERT_EQ(2u, cache.size());
+    ASSERT_EQ(1u, cache.evictions());
+    ASSERT_EQ(a, cache.get(yae::mesh_key{ "a", {}, GL_TRIANGLES }, counting_build(builds)));
+    ASSERT_EQ(3, builds);
+    // only a is still referred to outside of the cache
+    ASSERT_EQ(1u, cache.evict_unused());
+    ASSERT_EQ(1u, cache.size());
+}
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <mesh_file.hpp>
+
+using namespace std;
+
+static string temporary_path(const char* name)
+{
+    return string(::testing::TempDir()) + name;
+}
+
+TEST(mesh_file, saved_data_maps_back)
+{
+    auto geomb = yae::make_octahedron_sphere<float>(3);
+    geomb.set_normal_generation(yae::normal_generation::smooth).set_quantized(true).set_strips(true);
+    yae::geometry_data data = geomb.build_data(geomb.default_format());
+    ASSERT_EQ(GLenum(GL_TRIANGLE_STRIP), data.primitive_type);
+    ASSERT_EQ(GLenum(GL_UNSIGNED_SHORT), data.index_type);
+    ASSERT_EQ(data.indices.size(), data.count * sizeof(GLushort));
+
+    string path = temporary_path("sphere.yaem");
+    ASSERT_TRUE(yae::save_mesh_file(path, data));
+    yae::mapped_file file;
+    ASSERT_TRUE(file.open(path));
+    yae::mesh_file_view view;
+    ASSERT_TRUE(yae::read_mesh_file(file.data(), file.size(), view));
+    ASSERT_EQ(0u, (view.vertices - file.data()) % yae::mesh_file_alignment);
+    ASSERT_EQ(0u, (view.indices - file.data()) % yae::mesh_file_alignment);
+    ASSERT_EQ(data.count, view.header->count);
+    ASSERT_EQ(data.primitive_type, view.header->primitive_type);
+    ASSERT_EQ(1u, view.header->primitive_restart);
+    ASSERT_EQ(data.format.stride, view.format.stride);
+    ASSERT_EQ(data.format.elements.size(), view.format.elements.size());
+    for (size_t i = 0; i < view.format.elements.size(); i++) {
+        ASSERT_EQ(data.format.elements[i].type, view.format.elements[i].type);
+        ASSERT_EQ(data.format.elements[i].offset, view.format.elements[i].offset);
+    }
+    ASSERT_EQ(0, memcmp(data.vertices.data(), view.vertices, data.vertices.size()));
+    ASSERT_EQ(0, memcmp(data.indices.data(), view.indices, data.indices.size()));
+    ASSERT_EQ(0, memcmp(data.position_transform.m, view.header->position_transform, sizeof(float) * 16));
+    ASSERT_TRUE(view.model_bounds.known);
+    ASSERT_FLOAT_EQ(data.model_bounds.lo.x(), view.model_bounds.lo.x());
+    ASSERT_FLOAT_EQ(data.model_bounds.hi.z(), view.model_bounds.hi.z());
+    ASSERT_FLOAT_EQ(data.model_bounds.radius, view.model_bounds.radius);
+    file.close();
+    remove(path.c_str());
+}
+
+TEST(mesh_file, truncated_file_is_rejected)
+{
+    auto geomb = yae::make_box<float>(2, 2, 2);
+    yae::geometry_data data = geomb.build_data(geomb.default_format());
+    string path = temporary_path("box.yaem");
+    ASSERT_TRUE(yae::save_mesh_file(path, data));
+    yae::mapped_file file;
+    ASSERT_TRUE(file.open(path));
+    yae::mesh_file_view view;
+    ASSERT_TRUE(yae::read_mesh_file(file.data(), file.size(), view));
+    ASSERT_FALSE(yae::read_mesh_file(file.data(), file.size() - 1, view));
+    ASSERT_FALSE(yae::read_mesh_file(file.data(), sizeof(yae::mesh_file_header) - 1, view));
+    file.close();
+    remove(path.c_str());
+}
+
+TEST(mesh_file, corrupt_file_is_rejected)
+{
+    auto geomb = yae::make_box<float>(2, 2, 2);
+    yae::geometry_data data = geomb.build_data(geomb.default_format());
+    string path = temporary_path("corrupt.yaem");
+    ASSERT_TRUE(yae::save_mesh_file(path, data));
+    yae::mapped_file file;
+    ASSERT_TRUE(file.open(path));
+    vector<unsigned char> bytes(file.data(), file.data() + file.size());
+    file.close();
+    remove(path.c_str());
+    yae::mesh_file_view view;
+    ASSERT_TRUE(yae::read_mesh_file(bytes.data(), bytes.size(), view));
+    auto header = reinterpret_cast<yae::mesh_file_header*>(bytes.data());
+    auto element = reinterpret_cast<yae::mesh_file_element*>(bytes.data() + sizeof(yae::mesh_file_header));
+    // more indices drawn than stored
+    header->count++;
+    ASSERT_FALSE(yae::read_mesh_file(bytes.data(), bytes.size(), view));
+    header->count--;
+    // an attribute past the end of the vertex
+    element->offset = header->stride;
+    ASSERT_FALSE(yae::read_mesh_file(bytes.data(), bytes.size(), view));
+    element->offset = 0;
+    header->primitive_type = 0x1234;
+    ASSERT_FALSE(yae::read_mesh_file(bytes.data(), bytes.size(), view));
+    header->primitive_type = data.primitive_type;
+    ASSERT_TRUE(yae::read_mesh_file(bytes.data(), bytes.size(), view));
+    // an index past the vertices
+    ASSERT_EQ(GLenum(GL_UNSIGNED_SHORT), data.index_type);
+    GLushort index = static_cast<GLushort>(data.vertices.size() / data.format.stride);
+    memcpy(bytes.data() + header->indices_offset, &index, sizeof(index));
+    ASSERT_FALSE(yae::read_mesh_file(bytes.data(), bytes.size(), view));
+}
@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <mesh_import.hpp>
+
+using namespace std;
+
+static bool import_obj(const string& text, yae::imported_mesh& mesh)
+{
+    return yae::import_obj(text.data(), text.size(), mesh);
+}
+
+static bool import_ply(const string& bytes, yae::imported_mesh& mesh)
+{
+    return yae::import_ply(bytes.data(), bytes.size(), mesh);
+}
+
+TEST(mesh_import, obj_positions_only)
+{
+    yae::imported_mesh mesh;
+    ASSERT_TRUE(import_obj(
+        "# a quad and a triangle\n"
+        "v 0 0 0\n"
+        "v 1.5 0 0\r\n"
+        "v 1.5 2e1 -0.25\n"
+        "v 0 20 0\n"
+        "f 1 2 3 4\n"
+        "f -4 -2 -1\n", mesh));
+    ASSERT_EQ(vector<float>({ 0, 0, 0, 1.5f, 0, 0, 1.5f, 20, -0.25f, 0, 20, 0 }), mesh.positions);
+    ASSERT_EQ(vector<GLuint>({ 0, 1, 2, 0, 2, 3, 0, 2, 3 }), mesh.indices);
+    ASSERT_TRUE(mesh.normals.empty());
+    ASSERT_TRUE(mesh.tex_coords.empty());
+}
+
+TEST(mesh_import, obj_merges_corners)
+{
+    yae::imported_mesh mesh;
+    ASSERT_TRUE(import_obj(
+        "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+        "vt 0 0\nvt 1 1\n"
+        "vn 0 0 1\n"
+        "f 1/1/1 2/2/1 3/2/1\n"
+        "f 1/1/1 3/2/1 4//1\n", mesh));
+    ASSERT_EQ(4u, mesh.positions.size() / 3);
+    ASSERT_EQ(vector<GLuint>({ 0, 1, 2, 0, 2, 3 }), mesh.indices);
+    ASSERT_EQ(vector<float>({ 0, 0, 1, 1, 1, 1, 0, 0 }), mesh.tex_coords);
+    ASSERT_EQ(12u, mesh.normals.size());
+    ASSERT_EQ(1.0f, mesh.normals[11]);
+}
+
+TEST(mesh_import, obj_relative_indices_across_chunks)
+{
+    // large enough to be split between threads
+    string text;
+    size_t triangles = 0;
+    while (text.size() < 4 << 20) {
+        for (int i = 0; i < 3; i++) {
+            text += "v " + to_string(triangles) + " " + to_string(i) + " 0.125\n";
+        }
+        text += "f -3 -2 -1\n";
+        triangles++;
+    }
+    yae::imported_mesh mesh;
+    ASSERT_TRUE(import_obj(text, mesh));
+    ASSERT_EQ(triangles * 3, mesh.indices.size());
+    for (size_t i = 0; i < mesh.indices.size(); i++) {
+        ASSERT_EQ(i, mesh.indices[i]);
+        ASSERT_EQ(float(i / 3), mesh.positions[i * 3]);
+    }
+}
+
+TEST(mesh_import, obj_rejects_bad_indices)
+{
+    yae::imported_mesh mesh;
+    ASSERT_FALSE(import_obj("v 0 0 0\nv 1 0 0\nf 1 2 3\n", mesh));
+    ASSERT_FALSE(import_obj("v 0 0 0\nv 1 0 x\n", mesh));
+}
+
+static const char* ply_header(const char* format)
+{
+    static string header;
+    header = string("ply\nformat ") + format + " 1.0\n"
+        "comment made by hand\n"
+        "element vertex 4\n"
+        "property float x\nproperty float y\nproperty float z\n"
+        "property uchar red\n"
+        "property float nz\n"
+        "element face 2\n"
+        "property list uchar int vertex_indices\n"
+        "property int flags\n"
+        "end_header\n";
+    return header.c_str();
+}
+
+TEST(mesh_import, ply_ascii)
+{
+    string ply = string(ply_header("ascii")) +
+        "0 0 0 255 1\n1 0 0 255 1\n1 1 0 255 1\n0 1 0 255 1\n"
+        "4 0 1 2 3 7\n3 0 2 3 0\n";
+    yae::imported_mesh mesh;
+    ASSERT_TRUE(import_ply(ply, mesh));
+    ASSERT_EQ(vector<float>({ 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0 }), mesh.positions);
+    ASSERT_EQ(vector<float>({ 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1 }), mesh.normals);
+    ASSERT_EQ(vector<GLuint>({ 0, 1, 2, 0, 2, 3, 0, 2, 3 }), mesh.indices);
+}
+
+template<class V>
+static void append_value(string& bytes, V v, bool big_endian)
+{
+    char b[sizeof(V)];
+    memcpy(b, &v, sizeof(V));
+    if (big_endian) {
+        reverse(b, b + sizeof(V));
+    }
+    bytes.append(b, sizeof(V));
+}
+
+TEST(mesh_import, ply_binary)
+{
+    // the tests run on little endian machines
+    for (bool big_endian : { false, true }) {
+        string ply = ply_header(big_endian ? "binary_big_endian" : "binary_little_endian");
+        float positions[] = { 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0 };
+        for (int v = 0; v < 4; v++) {
+            for (int c = 0; c < 3; c++) {
+                append_value(ply, positions[v * 3 + c], big_endian);
+            }
+            append_value<unsigned char>(ply, 255, big_endian);
+            append_value(ply, 1.0f, big_endian);
+        }
+        append_value<unsigned char>(ply, 4, big_endian);
+        for (int i : { 0, 1, 2, 3, 7 }) {
+            append_value(ply, i, big_endian);
+        }
+        append_value<unsigned char>(ply, 3, big_endian);
+        for (int i : { 0, 2, 3, 0 }) {
+            append_value(ply, i, big_endian);
+        }
+        yae::imported_mesh mesh;
+        ASSERT_TRUE(import_ply(ply, mesh));
+        ASSERT_EQ(vector<float>(positions, positions + 12), mesh.positions);
+        ASSERT_EQ(vector<GLuint>({ 0, 1, 2, 0, 2, 3, 0, 2, 3 }), mesh.indices);
+        ASSERT_FALSE(import_ply(ply.substr(0, ply.size() - 1), mesh));
+    }
+}
+
+TEST(mesh_import, builder_keeps_indices)
+{
+    yae::imported_mesh mesh;
+    ASSERT_TRUE(import_obj("v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nf 1 2 3 4\n", mesh));
+    auto geomb = yae::make_builder(mesh);
+    geomb.set_normal_generation(yae::normal_generation::smooth);
+    yae::geometry_data data = geomb.build_data(geomb.default_format());
+    ASSERT_EQ(GLenum(GL_TRIANGLES), data.primitive_type);
+    ASSERT_EQ(6, data.count);
+    ASSERT_EQ(4 * 6 * sizeof(float), data.vertices.size());
+    const float* vertices = reinterpret_cast<const float*>(data.vertices.data());
+    for (int v = 0; v < 4; v++) {
+        ASSERT_NEAR(1.0f, vertices[v * 6 + 5], 1e-6f);
+    }
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <geometry.hpp>
+#include <mesh_optimizer.hpp>
+
+using namespace std;
+
+static void sphere_indices(vector<GLuint>& indices, vector<float>& positions)
+{
+    auto data = yae::make_octahedron_sphere<float>(4).data();
+    vector<GLuint> first;
+    yae::weld_vertices(data.data(), data.size() / 3, 3 * sizeof(float), indices, first);
+    positions.clear();
+    for (GLuint i : first) {
+        positions.insert(positions.end(), &data[i * 3], &data[i * 3 + 3]);
+    }
+}
+
+static vector<array<float, 9>> sorted_triangles(const vector<GLuint>& indices, const vector<float>& positions)
+{
+    vector<array<float, 9>> triangles(indices.size() / 3);
+    for (size_t i = 0; i < indices.size(); i++) {
+        for (int c = 0; c < 3; c++) {
+            triangles[i / 3][(i % 3) * 3 + c] = positions[indices[i] * 3 + c];
+        }
+    }
+    sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+TEST(mesh_optimizer, vertex_cache_lowers_acmr)
+{
+    vector<GLuint> indices;
+    vector<float> positions;
+    sphere_indices(indices, positions);
+    size_t count = positions.size() / 3;
+    auto before = yae::analyze_vertex_cache(indices, count);
+    auto optimized = indices;
+    yae::optimize_vertex_cache(optimized, count);
+    auto after = yae::analyze_vertex_cache(optimized, count);
+    ASSERT_EQ(indices.size(), optimized.size());
+    ASSERT_LT(after.acmr, before.acmr);
+    ASSERT_LT(after.acmr, 0.8f);
+    ASSERT_EQ(sorted_triangles(indices, positions), sorted_triangles(optimized, positions));
+}
+
+TEST(mesh_optimizer, overdraw_and_fetch_keep_triangles)
+{
+    vector<GLuint> indices;
+    vector<float> positions;
+    sphere_indices(indices, positions);
+    size_t count = positions.size() / 3;
+    auto optimized = indices;
+    yae::optimize_vertex_cache(optimized, count);
+    yae::optimize_overdraw(optimized, positions, count);
+    vector<GLuint> order;
+    yae::optimize_vertex_fetch(optimized, count, order);
+    ASSERT_EQ(count, order.size());
+    vector<float> reordered;
+    for (GLuint i : order) {
+        reordered.insert(reordered.end(), &positions[i * 3], &positions[i * 3 + 3]);
+    }
+    // vertices come in the order of their first use
+    GLuint next = 0;
+    for (GLuint i : optimized) {
+        ASSERT_LE(i, next);
+        next = max(next, i + 1);
+    }
+    ASSERT_EQ(sorted_triangles(indices, positions), sorted_triangles(optimized, reordered));
+}
+
+TEST(mesh_optimizer, stripify_keeps_triangles)
+{
+    vector<GLuint> indices;
+    vector<float> positions;
+    sphere_indices(indices, positions);
+    yae::optimize_vertex_cache(indices, positions.size() / 3);
+    const GLuint restart = ~0u;
+    vector<GLuint> strip;
+    yae::stripify(indices, restart, strip);
+    ASSERT_LT(strip.size(), indices.size());
+    // triangles of the strips, with the winding of the list
+    vector<GLuint> triangles;
+    size_t begin = 0;
+    for (size_t i = 0; i <= strip.size(); i++) {
+        if (i < strip.size() && strip[i] != restart) {
+            continue;
+        }
+        for (size_t k = begin; k + 2 < i; k++) {
+            bool odd = (k - begin) % 2 == 1;
+            triangles.insert(triangles.end(), { strip[odd ? k + 1 : k], strip[odd ? k : k + 1], strip[k + 2] });
+        }
+        begin = i + 1;
+    }
+    ASSERT_EQ(indices.size(), triangles.size());
+    // the same triangles, up to the rotation of their vertices
+    auto canonical = [](vector<GLuint> v) {
+        for (size_t t = 0; t < v.size(); t += 3) {
+            rotate(v.begin() + t, min_element(v.begin() + t, v.begin() + t + 3), v.begin() + t + 3);
+        }
+        return v;
+    };
+    ASSERT_EQ(canonical(indices), canonical(triangles));
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <geometry.hpp>
+#include <mesh_simplifier.hpp>
+
+using namespace std;
+
+static void welded(const vector<float>& data, vector<GLuint>& indices, vector<float>& positions)
+{
+    vector<GLuint> first;
+    yae::weld_vertices(data.data(), data.size() / 3, 3 * sizeof(float), indices, first);
+    positions.clear();
+    for (GLuint i : first) {
+        positions.insert(positions.end(), &data[i * 3], &data[i * 3 + 3]);
+    }
+}
+
+TEST(mesh_simplifier, closed_mesh_stays_closed)
+{
+    vector<GLuint> indices;
+    vector<float> positions;
+    welded(yae::make_octahedron_sphere<float>(4).data(), indices, positions);
+    size_t count = positions.size() / 3;
+    size_t target = indices.size() / 4 / 3 * 3;
+    yae::simplify(indices, positions, count, target);
+    ASSERT_LE(indices.size(), target);
+    ASSERT_GT(indices.size(), 0u);
+    // each edge still shared by exactly two triangles
+    map<pair<GLuint, GLuint>, int> edges;
+    for (size_t t = 0; t < indices.size(); t += 3) {
+        for (int k = 0; k < 3; k++) {
+            GLuint a = indices[t + k];
+            GLuint b = indices[t + (k + 1) % 3];
+            ASSERT_LT(a, count);
+            ASSERT_NE(a, b);
+            edges[make_pair(min(a, b), max(a, b))]++;
+        }
+    }
+    for (auto& e : edges) {
+        ASSERT_EQ(2, e.second);
+    }
+}
+
+TEST(mesh_simplifier, flat_grid_keeps_its_border)
+{
+    auto geomb = yae::make_grid<float>(16, 16);
+    vector<GLuint> quads;
+    vector<float> positions;
+    welded(geomb.data(), quads, positions);
+    vector<GLuint> indices;
+    for (size_t q = 0; q < quads.size(); q += 4) {
+        indices.insert(indices.end(), { quads[q], quads[q + 1], quads[q + 2], quads[q], quads[q + 2], quads[q + 3] });
+    }
+    size_t before = indices.size();
+    float error = yae::simplify(indices, positions, positions.size() / 3, 0, 1e-6f);
+    ASSERT_LT(indices.size(), before / 10);
+    ASSERT_LE(error, 1e-6f);
+    // collapses on the plane and along the straight borders cost nothing,
+    // the corners stay and the area is unchanged
+    float area = 0.0f;
+    for (size_t t = 0; t < indices.size(); t += 3) {
+        yae::vector3f p0(&positions[indices[t] * 3]);
+        yae::vector3f p1(&positions[indices[t + 1] * 3]);
+        yae::vector3f p2(&positions[indices[t + 2] * 3]);
+        yae::vector3f n = yae::cross_product(p1 - p0, p2 - p0);
+        ASSERT_GT(n.z(), 0.0f);
+        area += n.z() / 2;
+    }
+    ASSERT_NEAR(256.0f, area, 1e-3f);
+}
+
+TEST(mesh_simplifier, builder_levels_keep_attributes)
+{
+    auto geomb = yae::make_uv_sphere<float>(40, 20);
+    geomb.set_normal_generation(yae::normal_generation::smooth);
+    auto full = geomb.build_data(geomb.default_format());
+    auto level = geomb.simplified(0.25f);
+    auto format = level.default_format();
+    ASSERT_NE(nullptr, format.find(yae::vertex_attribute::NORMAL));
+    auto simplified = level.build_data(format);
+    ASSERT_EQ(GLenum(GL_TRIANGLES), simplified.primitive_type);
+    ASSERT_LT(simplified.count, full.count / 3);
+    ASSERT_LT(simplified.vertices.size(), full.vertices.size());
+    ASSERT_GT(simplified.count, 0);
+}
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <picking.hpp>
+
+using namespace std;
+
+namespace {
+
+struct empty_node : public yae::node {
+    virtual void render(yae::rendering_context& /* ctx */) {}
+};
+
+// the distance of the hit of a triangle, negative when missed
+float hit_distance(const yae::ray& r, const yae::vector3f& v0, const yae::vector3f& v1, const yae::vector3f& v2)
+{
+    yae::vector3f e1 = v1 - v0;
+    yae::vector3f e2 = v2 - v0;
+    yae::vector3f p = yae::cross_product(r.direction, e2);
+    float det = yae::dot_product(e1, p);
+    if (abs(det) < 1e-12f) {
+        return -1.0f;
+    }
+    yae::vector3f s = r.origin - v0;
+    float u = yae::dot_product(s, p) / det;
+    yae::vector3f q = yae::cross_product(s, e1);
+    float v = yae::dot_product(r.direction, q) / det;
+    float d = yae::dot_product(e2, q) / det;
+    return u >= 0.0f && v >= 0.0f && u + v <= 1.0f ? d : -1.0f;
+}
+
+// a unit square of 2 triangles facing z at depth z
+shared_ptr<yae::pickable_node> square(float x, float y, float z)
+{
+    yae::geometry_builder<float> geomb(3, GL_QUADS);
+    geomb.append(yae::vector3f(x, y, z)).append(yae::vector3f(x + 1.0f, y, z))
+        .append(yae::vector3f(x + 1.0f, y + 1.0f, z)).append(yae::vector3f(x, y + 1.0f, z));
+    return make_shared<yae::pickable_node>(make_shared<empty_node>(), yae::make_triangle_bvh(geomb));
+}
+
+}
+
+TEST(picking, triangle_bvh_matches_brute_force)
+{
+    mt19937 rng(3);
+    uniform_real_distribution<float> position(-10.0f, 10.0f);
+    uniform_real_distribution<float> offset(-0.5f, 0.5f);
+    vector<float> positions;
+    vector<GLuint> indices;
+    for (GLuint t = 0; t < 5000; t++) {
+        float c[3] = { position(rng), position(rng), position(rng) };
+        for (int k = 0; k < 3; k++) {
+            for (int i = 0; i < 3; i++) {
+                positions.push_back(c[i] + offset(rng));
+            }
+            indices.push_back(t * 3 + k);
+        }
+    }
+    yae::triangle_bvh triangles;
+    triangles.build(positions, indices);
+    ASSERT_EQ(5000u, triangles.size());
+    size_t hits = 0;
+    for (int i = 0; i < 500; i++) {
+        yae::vector3f target(position(rng), position(rng), position(rng));
+        yae::ray r{ yae::vector3f(position(rng), position(rng), 20.0f), yae::vector3f() };
+        r.direction = yae::normalize(target - r.origin);
+        float nearest = numeric_limits<float>::max();
+        for (size_t t = 0; t < 5000; t++) {
+            float d = hit_distance(r, yae::vector3f(&positions[t * 9]), yae::vector3f(&positions[t * 9 + 3]),
+                yae::vector3f(&positions[t * 9 + 6]));
+            if (d >= 0.0f && d < nearest) {
+                nearest = d;
+            }
+        }
+        size_t triangle;
+        float distance;
+        bool hit = triangles.intersect(r, numeric_limits<float>::max(), triangle, distance);
+        ASSERT_EQ(nearest < numeric_limits<float>::max(), hit);
+        if (hit) {
+            ASSERT_NEAR(nearest, distance, 1e-3f);
+            ASSERT_NEAR(distance, hit_distance(r, yae::vector3f(&positions[triangle * 9]),
+                yae::vector3f(&positions[triangle * 9 + 3]), yae::vector3f(&positions[triangle * 9 + 6])), 1e-3f);
+            hits++;
+        }
+    }
+    ASSERT_GT(hits, 50u);
+}
+
+TEST(picking, camera_ray_through_pixel)
+{
+    yae::clipping_volume cv{ -1.0f, 1.0f, -1.0f, 1.0f, 1.0f, 100.0f };
+    yae::viewport vp{ 10, 20, 200, 100 };
+    yae::perspective_camera perspective(cv);
+    perspective.move_backward(5.0f);
+    yae::ray center = perspective.ray_through(vp, 110.0f, 70.0f);
+    ASSERT_NEAR(5.0f, center.origin.z(), 1e-5f);
+    ASSERT_NEAR(-1.0f, center.direction.z(), 1e-5f);
+    // the top right corner of the near plane
+    yae::ray corner = perspective.ray_through(vp, 210.0f, 120.0f);
+    ASSERT_NEAR(1.0f / sqrt(3.0f), corner.direction.x(), 1e-5f);
+    ASSERT_NEAR(1.0f / sqrt(3.0f), corner.direction.y(), 1e-5f);
+    yae::parallel_camera parallel(cv);
+    yae::ray left = parallel.ray_through(vp, 10.0f, 70.0f);
+    ASSERT_NEAR(-1.0f, left.origin.x(), 1e-5f);
+    ASSERT_NEAR(-1.0f, left.origin.z(), 1e-5f);
+    ASSERT_NEAR(-1.0f, left.direction.z(), 1e-5f);
+}
+
+TEST(picking, pick_through_groups)
+{
+    auto root = make_shared<yae::group>();
+    auto near_square = square(0.0f, 0.0f, 0.0f);
+    auto moved = make_shared<yae::group>();
+    moved->set_transform(yae::translation(0.0f, 0.0f, -3.0f));
+    moved->add(near_square);
+    auto grid = make_shared<yae::bvh_group>();
+    vector<shared_ptr<yae::pickable_node>> squares;
+    for (int i = 0; i < 100; i++) {
+        squares.push_back(square(static_cast<float>(i % 10), static_cast<float>(i / 10), -10.0f));
+        grid->add(squares.back());
+    }
+    root->add(grid);
+    root->add(moved);
+    yae::ray r{ yae::vector3f(0.25f, 0.75f, 5.0f), yae::vector3f(0.0f, 0.0f, -1.0f) };
+    yae::ray_hit hit = yae::pick(root, r);
+    ASSERT_EQ(near_square, hit.hit_node);
+    ASSERT_NEAR(8.0f, hit.distance, 1e-5f);
+    // the second triangle of the quad, through its upper left half
+    ASSERT_EQ(1u, hit.triangle);
+    // the grid behind, in the second row
+    r.origin = yae::vector3f(4.5f, 1.5f, 5.0f);
+    hit = yae::pick(root, r);
+    ASSERT_EQ(squares[14], hit.hit_node);
+    ASSERT_NEAR(15.0f, hit.distance, 1e-5f);
+    // nothing before it
+    hit = yae::pick(root, r, 10.0f);
+    ASSERT_EQ(nullptr, hit.hit_node);
+    // groups transformed by a callback are not picked
+    moved->set_transform_callback([](yae::rendering_context&) { return yae::identity<float>(); });
+    r.origin = yae::vector3f(0.25f, 0.75f, 5.0f);
+    hit = yae::pick(root, r);
+    ASSERT_EQ(squares[0], hit.hit_node);
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <render_queue.hpp>
+#include <yae.hpp>
+
+using namespace std;
+
+namespace {
+
+// records the geometries it draws
+struct recording_program : public yae::program {
+    recording_program(vector<const yae::geometry<float>*>& drawn, bool transparent)
+        : drawn(drawn), transparent(transparent) {}
+    virtual void render(const yae::geometry<float>& geometry, yae::rendering_context& /* ctx */) {
+        drawn.push_back(&geometry);
+    }
+    virtual bool is_transparent() const { return transparent; }
+    vector<const yae::geometry<float>*>& drawn;
+    bool transparent;
+};
+
+}
+
+TEST(render_queue, radix_sort_matches_stable_sort)
+{
+    mt19937_64 rng(5);
+    vector<pair<uint64_t, uint32_t>> entries;
+    for (uint32_t i = 0; i < 10000; i++) {
+        // few distinct high bytes, like programs and textures
+        entries.push_back(make_pair((rng() & 0x0300ffff0000ffffull) | (static_cast<uint64_t>(i % 3) << 62), i));
+    }
+    vector<pair<uint64_t, uint32_t>> expected = entries;
+    stable_sort(expected.begin(), expected.end(),
+        [](const pair<uint64_t, uint32_t>& a, const pair<uint64_t, uint32_t>& b) { return a.first < b.first; });
+    vector<pair<uint64_t, uint32_t>> scratch;
+    yae::render_queue::sort(entries, scratch);
+    ASSERT_EQ(expected, entries);
+}
+
+TEST(render_queue, key_order)
+{
+    using yae::render_queue;
+    // opaque first, by program, texture then front to back
+    ASSERT_LT(render_queue::make_key(false, 5, 5, 100.0f), render_queue::make_key(true, 0, 0, 1.0f));
+    ASSERT_LT(render_queue::make_key(false, 0, 9, 100.0f), render_queue::make_key(false, 1, 0, 1.0f));
+    ASSERT_LT(render_queue::make_key(false, 1, 0, 100.0f), render_queue::make_key(false, 1, 1, 1.0f));
+    ASSERT_LT(render_queue::make_key(false, 1, 1, 0.5f), render_queue::make_key(false, 1, 1, 1.0f));
+    ASSERT_EQ(render_queue::make_key(false, 1, 1, -3.0f), render_queue::make_key(false, 1, 1, 0.0f));
+    // transparent back to front whatever the program
+    ASSERT_LT(render_queue::make_key(true, 7, 0, 10.0f), render_queue::make_key(true, 0, 0, 1.0f));
+    ASSERT_LT(render_queue::make_key(true, 0, 0, 1.0f), render_queue::make_key(true, 1, 0, 1.0f));
+}
+
+TEST(render_queue, submit_sorted_draws)
+{
+    vector<const yae::geometry<float>*> drawn;
+    recording_program a(drawn, false);
+    recording_program b(drawn, false);
+    recording_program glass(drawn, true);
+    vector<unique_ptr<yae::geometry<float>>> geoms;
+    for (int i = 0; i < 6; i++) {
+        geoms.emplace_back(new yae::geometry<float>(3, 3, GL_TRIANGLES));
+        yae::bounds bounds;
+        bounds.center = yae::vector3f(0.0f, 0.0f, -static_cast<float>(i));
+        bounds.known = true;
+        geoms.back()->set_bounds(bounds);
+    }
+    yae::rendering_context ctx;
+    yae::render_queue queue;
+    // programs alternating in the traversal, the nearest geometries last
+    yae::program* programs[6] = { &glass, &a, &b, &a, &glass, &b };
+    for (int i = 5; i >= 0; i--) {
+        queue.push(*geoms[i], *programs[i], yae::identity<float>(), yae::identity<float>());
+    }
+    ASSERT_EQ(6u, queue.size());
+    queue.submit(ctx);
+    ASSERT_EQ(0u, queue.size());
+    // b queued first, then a, front to back, then glass back to front
+    vector<const yae::geometry<float>*> expected = {
+        geoms[2].get(), geoms[5].get(), geoms[1].get(), geoms[3].get(), geoms[4].get(), geoms[0].get() };
+    ASSERT_EQ(expected, drawn);
+    ASSERT_EQ(6u, ctx.sorting.draws);
+    ASSERT_EQ(5u, ctx.sorting.unsorted_program_changes);
+    ASSERT_EQ(2u, ctx.sorting.program_changes);
+    ASSERT_EQ(0u, ctx.sorting.texture_changes);
+}
+
+TEST(render_queue, programs_forgotten_after_submit)
+{
+    vector<const yae::geometry<float>*> drawn;
+    recording_program a(drawn, false);
+    recording_program b(drawn, false);
+    yae::geometry<float> near_geom(3, 3, GL_TRIANGLES);
+    yae::geometry<float> far_geom(3, 3, GL_TRIANGLES);
+    yae::rendering_context ctx;
+    yae::render_queue queue;
+    queue.push(near_geom, b, yae::identity<float>(), yae::identity<float>());
+    queue.push(far_geom, a, yae::identity<float>(), yae::identity<float>());
+    queue.submit(ctx);
+    // the programs of the next frame ordered as first queued in that frame
+    drawn.clear();
+    queue.push(far_geom, a, yae::identity<float>(), yae::identity<float>());
+    queue.push(near_geom, b, yae::identity<float>(), yae::identity<float>());
+    queue.submit(ctx);
+    vector<const yae::geometry<float>*> expected = { &far_geom, &near_geom };
+    ASSERT_EQ(expected, drawn);
+}